@@ -24,7 +24,10 @@
 #include "dynamic/internal/lciv.hpp"
 #include "dynamic/internal/wt_string.hpp"
 #include "dynamic/internal/wm_string.hpp"
+#include "dynamic/internal/packed_sequence.hpp"
+#include "dynamic/internal/multiary_wt_string.hpp"
 #include "dynamic/internal/fm_index.hpp"
+#include "dynamic/internal/r_index.hpp"
 #include "dynamic/internal/bufferedbv.hpp"
 
 namespace dyn{
@@ -68,6 +71,13 @@ typedef wt_string<suc_bv> wt_str;
  */
 typedef wm_string<succinct_bitvector<spsi<packed_bit_vector,256,16>>> wm_str;
 
+/*
+ * succinct dynamic string implemented with a multiary wavelet tree: 4 or 2
+ * bits of the character per level (a byte alphabet takes 2 or 4 levels).
+ */
+typedef multiary_wt_string<packed_sequence<4>> wt16_str;
+typedef multiary_wt_string<packed_sequence<2>> wt4_str;
+
 /*
  * run-length encoded (RLE) string. This string uses 1 sparse bitvector
  * for all runs, one dynamic string for run heads, and sigma sparse bitvectors (one per character)
@@ -90,12 +100,17 @@ typedef wt_string<gap_bv> wtgap_str;
 /*
  * succinct/compressed BWT (see description of com_str)
  */
-typedef bwt<wt_str,rle_str> wt_bwt;
+typedef bwt<wt_str> wt_bwt;
 
 /*
  * run-length encoded BWT
  */
-typedef bwt<rle_str,rle_str> rle_bwt;
+typedef bwt<rle_str> rle_bwt;
+
+/*
+ * BWT on a multiary wavelet tree: fewer (but larger) nodes per LF step
+ */
+typedef bwt<wt16_str> wt16_bwt;
 
 /*
  * dynamic sparse vector: <= m*k + O(m log n/m) bits of space, where k is the maximum
@@ -122,6 +137,39 @@ typedef fm_index<wt_bwt, suc_bv, packed_spsi> wt_fmi;
  */
 typedef fm_index<rle_bwt, gap_bv, packed_spsi> rle_fmi;
 
+/*
+ * as wt_fmi and rle_fmi, with ISA samples: supports extract and adaptive
+ * sampling. (n/k)*log n more bits of space (see fm_index.hpp)
+ */
+typedef fm_index<wt_bwt, suc_bv, packed_spsi, wm_str> wt_extract_fmi;
+typedef fm_index<rle_bwt, gap_bv, packed_spsi, wm_str> rle_extract_fmi;
+
+/*
+ * as rle_fmi, without SA samples: count and LF only (no locate/extract).
+ * ( 2*R*log(n/R) + R*H0 )(1+o(1)) bits of space
+ */
+typedef fm_index<rle_bwt, no_sampling, no_sampling> rle_count_fmi;
+
+/*
+ * dynamic r-index: run-length encoded BWT with SA samples at the run
+ * boundaries only. Locate takes O(1) LF steps and predecessor queries per
+ * occurrence.
+ *
+ * ( 2*R*log(n/R) + R*H0 + 4*R*log n )(1+o(1)) bits of space
+ *
+ */
+typedef r_index<rle_bwt, gap_bv, packed_spsi> rle_rindex;
+
+/*
+ * as wt_fmi, with the BWT on a multiary wavelet tree (see wt16_bwt)
+ */
+typedef fm_index<wt16_bwt, suc_bv, packed_spsi> wt16_fmi;
+
+/*
+ * as wt16_fmi, with ISA samples (see wt_extract_fmi)
+ */
+typedef fm_index<wt16_bwt, suc_bv, packed_spsi, wm_str> wt16_extract_fmi;
+
 
 // ------------- STRUCTURES DESIGNED ONLY FOR DEBUGGING PURPOSES -------------
 
@@ -144,8 +192,8 @@ typedef rle_string<bv_check, str_check> rle_str_check;
  * build structure given as input the BWT in string format
  * and the terminator character.
  *
- * Efficient constructor: pushes back runs
- *
+ * Efficient constructor: runs are appended in bulk to L (see rle_string::append_runs),
+ * and the C array is built at the end from the character counts
  */
 template<>
 inline
@@ -154,39 +202,49 @@ void rle_bwt::build_from_string(string& bwt, char terminator, bool verbose){
 	const ulint step = 1000000;	//print status every step characters
 	ulint last_step = 0;
 
-	terminator_position = bwt.size();
+	assert(L.size() == 0);
 
-	char c = bwt[0];
-	ulint k=1;
+	terminator_position = bwt.size();
 
-	for(ulint i=1; i<bwt.size();++i){
+	//runs of the current chunk (the terminator is skipped)
+	const ulint chunk = 1<<20;
+	vector<pair<char_type,ulint> > R;
 
-		if(bwt[i] != c){
+	map<char_type,ulint> counts;
 
-			if(c == terminator){
+	ulint i = 0;
 
-				//there must be only one terminator in the string
-				assert(terminator_position == bwt.size());
-				assert(k==1);
+	while(i<bwt.size()){
 
-				terminator_position = i-1;
+		char c = bwt[i];
+		ulint k = 1;
 
-			}else{
+		while(i+k<bwt.size() and bwt[i+k]==c) k++;
 
-				insert_in_F(c,k);
-				L.insert(L.size(),c,k);
+		if(c == terminator){
 
-			}
+			//there must be only one terminator in the string
+			assert(terminator_position == bwt.size());
+			assert(k==1);
 
-			c = bwt[i];
-			k = 1;
+			terminator_position = i;
 
 		}else{
 
-			k++;
+			R.push_back({uchar(c),k});
+			counts[uchar(c)] += k;
+
+		}
+
+		if(R.size() == chunk){
+
+			L.append_runs(R.begin(),R.end());
+			R.clear();
 
 		}
 
+		i += k;
+
 		if(verbose){
 
 			if(i>last_step+(step-1)){
@@ -200,22 +258,9 @@ void rle_bwt::build_from_string(string& bwt, char terminator, bool verbose){
 
 	}
 
-	//last run
-	if(c == terminator){
-
-		//there must be only one terminator in the string
-		assert(terminator_position == bwt.size());
-		assert(k==1);
+	L.append_runs(R.begin(),R.end());
 
-		//terminator in last BWT position
-		terminator_position = bwt.size() - 1;
-
-	}else{
-
-		insert_in_F(c,k);
-		L.insert(L.size(),c,k);
-
-	}
+	for(auto e : counts) C.increment(e.first,e.second);
 
 	assert(size() == bwt.size());
 	assert(terminator_position != bwt.size());
@@ -13,8 +13,29 @@
  *  User can choose (at constructor time) between 3 types of encodings:
  *
  *  - fixed-size: number of bits of each char is fixed. Dynamic (but alphabet size is limited)
- *  - gamma encoding: alphabet is completely unknown at construction time. Dynamic (alphabet size < 2^64)
- *  - Huffman encoding: character probabilities are known at construction time. Static.
+ *  - gamma encoding: alphabet is completely unknown at construction time. Dynamic (alphabet size < 2^32)
+ *  - Huffman encoding: character probabilities are known at construction time. Static, or
+ *    open: an escape symbol is then added to the Huffman code, and each new character gets
+ *    the escape code followed by the gamma code of its rank among the new characters.
+ *
+ *  With fixed-size and Huffman encodings the alphabet is bounded: codes of characters
+ *  smaller than DENSE_SIGMA are then stored in a flat table indexed by character, and
+ *  fixed-size codes of at most DENSE_LOG_SIGMA bits are decoded through a flat table
+ *  indexed by code value. Hash maps are used only for the remaining characters/codes.
+ *  The flat encode table has DENSE_SIGMA entries of sizeof(code_t) = 16 bytes, i.e.
+ *  4 KB per bounded encoder whatever the alphabet size; the decode table has
+ *  2^log_sigma entries.
+ *
+ *  Codes are packed in a 64-bit integer (see code_t), so that encoding and decoding
+ *  never allocate. Code lengths are limited to MAX_CODE_LEN bits: gamma codes of
+ *  2*log2(sigma)+1 bits then limit gamma-coded alphabets to 2^32 - 1 characters, and
+ *  fixed-size codes to sigma <= 2^63. A std::length_error is thrown beyond these limits.
+ *
+ *  Huffman codes are canonical and length-limited to MAX_HUFFMAN_LEN bits: codes of
+ *  each length are consecutive integers, assigned by increasing character. Decoding
+ *  is then arithmetic on the code (no hashing), and only the code lengths are serialized.
+ *  The escape code is the all-ones code of its length, i.e. the code space left free by
+ *  the canonical codes; escaped characters are decoded through the hash map.
  *
  */
 
@@ -32,6 +53,48 @@ public:
 	//we allow any alphabet
 	typedef uint64_t char_type;
 
+	/*
+	 * code of a character: the len bits of bits, first bit of the code = most
+	 * significant (i.e. bit len-1 of bits). len == 0 means "no code"
+	 */
+	struct code_t{
+
+		uint64_t bits = 0;
+		uint8_t len = 0;
+
+		uint8_t size() const { return len; }
+
+		/*
+		 * j-th bit of the code, 0 <= j < len
+		 */
+		bool operator[](uint8_t j) const {
+
+			assert(j < len);
+			return (bits >> (len - 1 - j)) & uint64_t(1);
+
+		}
+
+		/*
+		 * code extended with bit b
+		 */
+		code_t append(bool b) const {
+
+			assert(len < MAX_CODE_LEN);
+			return {(bits << 1) | b, uint8_t(len + 1)};
+
+		}
+
+		bool operator==(const code_t& o) const { return bits == o.bits and len == o.len; }
+		bool operator!=(const code_t& o) const { return not (*this == o); }
+
+	};
+
+	//maximum code length
+	static constexpr uint8_t MAX_CODE_LEN = 63;
+
+	//maximum length of Huffman codes
+	static constexpr uint8_t MAX_HUFFMAN_LEN = 32;
+
 	/*
 	 * Constructor #1
 	 *
@@ -48,18 +111,26 @@ public:
 	/*
 	 * Constructor #2
 	 *
-	 * We know only alphabet size. Each character is assigned log2(sigma) bits.
-	 * Characters are assigned codes 0,1,2,... in order of appearance
+	 * We know only alphabet size. Each character is assigned log2(sigma) bits
+	 * (at least 1). Characters are assigned codes 0,1,2,... in order of appearance
 	 *
 	 */
 	alphabet_encoder(uint64_t sigma){
 
 		assert(sigma>0);
 
-		this->log_sigma = 64-__builtin_clzll(sigma-1);
+		this->log_sigma = sigma == 1 ? 1 : 64-__builtin_clzll(sigma-1);
 		this->sigma = 0;
 		enc_type = fixed;
 
+		if(log_sigma > MAX_CODE_LEN)
+			throw std::length_error("alphabet_encoder: fixed-size codes are limited to MAX_CODE_LEN bits");
+
+		dense_encode_ = vector<code_t>(DENSE_SIGMA);
+
+		if(log_sigma <= DENSE_LOG_SIGMA)
+			dense_decode_ = vector<char_type>(uint64_t(1)<<log_sigma, 0);
+
 	}
 
 	/*
@@ -69,21 +140,40 @@ public:
 	 *
 	 * Here the alphabet is Huffman encoded.
 	 *
-	 * Note: all characters that will appear in the text must be included
-	 * in P. If in doubt, assign probability 0 (such characters will get
-	 * the longest codes)
+	 * Note: if not open, all characters that will appear in the text must be
+	 * included in P. If in doubt, assign probability 0 (such characters will get
+	 * the longest codes). If open, characters not in P are escaped: the escape
+	 * symbol gets the smallest probability in P
 	 *
 	 */
-	alphabet_encoder(vector<pair<char_type,double> >& P){
+	alphabet_encoder(vector<pair<char_type,double> >& P, bool open = false){
 
 		sigma = P.size();
 		enc_type = huffman;
 
+		assert(sigma > 0);
+		assert(sigma + open <= uint64_t(1) << MAX_HUFFMAN_LEN);
+
+		dense_encode_ = vector<code_t>(DENSE_SIGMA);
+
+		//the Huffman code is built on the indices of P; index P.size() is the escape
+		vector<pair<char_type,double> > Q;
+		double min_prob = P[0].second;
+
+		for(uint64_t i = 0; i < P.size(); ++i){
+
+			Q.push_back({i,P[i].second});
+			min_prob = std::min(min_prob,P[i].second);
+
+		}
+
+		if(open) Q.push_back({P.size(),min_prob});
+
 		auto comp = [](node x, node y){ return x.second < y.second; };
 		multiset<node,decltype(comp)> s(comp);
 
 		//insert leaves
-		for(auto it = P.begin();it!=P.end();++it)
+		for(auto it = Q.begin();it!=Q.end();++it)
 			s.insert({{NULL,&it->first},it->second});
 
 		//Huffman algorithm
@@ -106,26 +196,49 @@ public:
 		}
 
 		node root = *s.begin();
-		extract_codes(&root,{});
+
+		//only the code lengths are kept: codes are then assigned canonically
+		vector<pair<uint64_t,char_type> > lengths;
+		extract_lengths(&root, lengths);
 
 		root.free_memory();
 
+		limit_lengths(lengths);
+
+		//back from indices to characters. The escape takes no canonical code
+		for(uint64_t i = 0; i < lengths.size(); ++i){
+
+			if(lengths[i].second == P.size()){
+
+				escape_len_ = lengths[i].first;
+				lengths.erase(lengths.begin()+i--);
+
+			}else{
+
+				lengths[i].second = P[lengths[i].second].first;
+
+			}
+
+		}
+
+		build_canonical(lengths);
+
 	}
 
 	/*
 	 * input: a character
 	 * output: its code
 	 *
-	 * with constructors #1 and #2, alphabet is not pre-determined: new codes are created for
-	 * new coming characters
+	 * with constructors #1, #2 and #3 (open), alphabet is not pre-determined: new codes are
+	 * created for new coming characters
 	 *
 	 */
-	const vector<bool>& encode(char_type c) {
+	code_t encode(char_type c) {
 
-		auto code = encode_[c];
+		auto& code = code_of(c);
 
-		//if c does not have a code, then encoding must not be Huffman (which is static)
-		assert(code.size() > 0 or enc_type != huffman);
+		//if c does not have a code, then encoding must not be static Huffman
+		assert(code.size() > 0 or is_dynamic());
 
 		/*
 		 * if character is not present in dictionary, then
@@ -135,45 +248,83 @@ public:
 
 			if(enc_type==gamma){
 
-				encode_[c] = get_new_gamma();
+				code = get_new_gamma();
 
 			}else if(enc_type==fixed){
 
-				encode_[c] = get_new_fixed();
+				code = get_new_fixed();
+
+			}else{
+
+				code = get_new_escaped();
 
 			}
 
-			//0 is reserved
-			decode_[ encode_[c] ] = c+1;
+			set_decode(code, c);
 
 		}
 
-		return encode_[c];
+		return code;
 
 	}
 
-    const vector<bool>& encode_existing(char_type c) const {
-        return encode_.at(c);
-    }
+	code_t encode_existing(char_type c) const {
+
+		if(c < dense_encode_.size()){
 
-	char_type decode(const vector<bool>& code) const {
+			assert(dense_encode_[c].size() > 0);
+			return dense_encode_[c];
+
+		}
+
+		return encode_.at(c);
+
+	}
+
+	char_type decode(code_t code) const {
 
 		//code must be present in dictionary!
-		assert(decode_.at(code)!=0);
+		assert(code_exists(code));
 
-		return decode_.at(code)-1;
+		//canonical Huffman: rank of the code among the codes of its length
+		if(canonical() and not escaped(code))
+			return canon_chars_[canon_offset_[code.len] + code.bits - canon_first_[code.len]];
+
+		if(code.size() == dense_decode_bits()) return dense_decode_[code.bits]-1;
+
+		return decode_.at(key(code))-1;
 
 	}
 
-	bool code_exists(const vector<bool>& code) const {
+	bool code_exists(code_t code) const {
+
+		if(canonical() and not escaped(code))
+			return	code.len > 0 and code.len <= MAX_HUFFMAN_LEN and
+					code.bits >= canon_first_[code.len] and
+					code.bits - canon_first_[code.len] < canon_offset_[code.len+1] - canon_offset_[code.len];
 
-		return decode_.at(code)!=0;
+		if(code.size() == dense_decode_bits()) return dense_decode_[code.bits]!=0;
+
+		auto it = decode_.find(key(code));
+		return it != decode_.end() && it->second!=0;
 
 	}
 
 	bool char_exists(char_type c) const {
 
-		return encode_.find(c) != encode_.end() && encode_.at(c).size()>0;
+		if(c < dense_encode_.size()) return dense_encode_[c].size()>0;
+
+		auto it = encode_.find(c);
+		return it != encode_.end() && it->second.size()>0;
+
+	}
+
+	/*
+	 * true iif characters without a code can be encoded (i.e. not static Huffman)
+	 */
+	bool is_dynamic() const {
+
+		return enc_type != huffman or escape_len_ > 0;
 
 	}
 
@@ -184,12 +335,19 @@ public:
            return enc_type==fixed ? 1ull<<log_sigma : sigma;
 	}
 
+	/*
+	 * characters that have been assigned a code
+	 */
         set<char_type> keys() const {
            set<char_type> keys;
-           for(char_type c = 0; c < size(); ++c) {
-              if (char_exists(c) || enc_type==fixed)
+           for(char_type c = 0; c < dense_encode_.size(); ++c) {
+              if (dense_encode_[c].size() > 0)
                  keys.insert(c);
            }
+           for(auto& e : encode_) {
+              if (e.second.size() > 0)
+                 keys.insert(e.first);
+           }
            return keys;
         }
 
@@ -206,17 +364,14 @@ public:
 
 		ulint size = 0;
 
-		for(auto e : encode_){
-
-			size += (sizeof(e.first) + sizeof(e.second))*8 + e.second.capacity();
+		size += encode_.size()*(sizeof(char_type) + sizeof(code_t))*8;
+		size += decode_.size()*(sizeof(uint64_t) + sizeof(char_type))*8;
 
-		}
-
-		for(auto e : decode_){
+		size += dense_encode_.capacity()*sizeof(code_t)*8;
+		size += dense_decode_.capacity()*sizeof(char_type)*8;
 
-			size += (sizeof(e.first) + sizeof(e.second))*8 + e.first.capacity();
-
-		}
+		size += canon_chars_.capacity()*sizeof(char_type)*8;
+		size += (canon_first_.capacity() + canon_offset_.capacity())*sizeof(uint64_t)*8;
 
 		return sizeof(alphabet_encoder)*8 + size;
 
@@ -225,8 +380,50 @@ public:
 	ulint serialize(ostream &out) const {
 
 		ulint w_bytes=0;
-		ulint encode_size = encode_.size();
-		ulint decode_size = decode_.size();
+
+		/*
+		 * canonical Huffman: number of characters, 0 (no explicit decode pairs,
+		 * which identifies this format) and the (character,length) pairs
+		 */
+		if(canonical()){
+
+			ulint encode_size = canon_chars_.size();
+			ulint decode_size = 0;
+
+			out.write((char*)&encode_size,sizeof(encode_size));
+			w_bytes += sizeof(encode_size);
+
+			out.write((char*)&decode_size,sizeof(decode_size));
+			w_bytes += sizeof(decode_size);
+
+			for(uint64_t len = 1; len <= MAX_HUFFMAN_LEN; ++len){
+
+				uint8_t l = len;
+
+				for(uint64_t i = canon_offset_[len]; i < canon_offset_[len+1]; ++i){
+
+					out.write((char*)&canon_chars_[i],sizeof(char_type));
+					out.write((char*)&l,sizeof(l));
+					w_bytes += sizeof(char_type) + sizeof(l);
+
+				}
+
+			}
+
+		}else{
+
+		//dense tables are written as (character,code) and (code,character) pairs
+		//as well, so that the format does not depend on the representation.
+		//The dense decode table holds all the codes of its length, also those
+		//of characters >= DENSE_SIGMA
+		ulint dense_size = 0;
+		for(auto& e : dense_encode_) dense_size += e.size() > 0;
+
+		ulint dense_decode_size = 0;
+		for(auto d : dense_decode_) dense_decode_size += d != 0;
+
+		ulint encode_size = encode_.size() + dense_size;
+		ulint decode_size = decode_.size() + dense_decode_size;
 
 
 		out.write((char*)&encode_size,sizeof(encode_size));
@@ -235,35 +432,85 @@ public:
 		out.write((char*)&decode_size,sizeof(decode_size));
 		w_bytes += sizeof(decode_size);
 
+		for(char_type c = 0; c < dense_encode_.size(); ++c){
+
+			if(dense_encode_[c].size() == 0) continue;
+
+			out.write((char*)&c,sizeof(c));
+			w_bytes += sizeof(c);
+
+			w_bytes += serialize_code(out, dense_encode_[c]);
+
+		}
+
 		for(const auto& e : encode_){
 
 			out.write((char*)&e.first,sizeof(e.first));
 			w_bytes += sizeof(e.first);
 
-			auto B = e.second;
-			w_bytes += serialize_vec_bool(out, B);
+			w_bytes += serialize_code(out, e.second);
+
+		}
+
+		for(uint64_t b = 0; b < dense_decode_.size(); ++b){
+
+			if(dense_decode_[b] == 0) continue;
+
+			//characters are stored shifted by one (0 is reserved)
+			w_bytes += serialize_code(out, {b, uint8_t(log_sigma)});
+
+			out.write((char*)&dense_decode_[b],sizeof(char_type));
+			w_bytes += sizeof(char_type);
 
 		}
 
 		for(const auto& d : decode_){
 
-			auto B = d.first;
-			w_bytes += serialize_vec_bool(out, B);
+			w_bytes += serialize_code(out, from_key(d.first));
 
 			out.write((char*)&d.second,sizeof(d.second));
 			w_bytes += sizeof(d.second);
 
 		}
 
+		}
+
 		out.write((char*)&sigma,sizeof(sigma));
 		w_bytes += sizeof(sigma);
 
-		out.write((char*)&log_sigma,sizeof(log_sigma));
-		w_bytes += sizeof(log_sigma);
+		//with Huffman, this field holds the length of the escape code (0 if static)
+		uint64_t l = enc_type == huffman ? escape_len_ : log_sigma;
+
+		out.write((char*)&l,sizeof(l));
+		w_bytes += sizeof(l);
 
 		out.write((char*)&enc_type,sizeof(enc_type));
 		w_bytes += sizeof(enc_type);
 
+		//open Huffman: the escaped characters, by increasing code
+		if(enc_type == huffman and escape_len_ > 0){
+
+			vector<pair<uint64_t,char_type> > esc;
+
+			for(char_type c : keys()){
+
+				code_t code = encode_existing(c);
+
+				if(escaped(code)) esc.push_back({key(code),c});
+
+			}
+
+			std::sort(esc.begin(), esc.end());
+
+			for(auto& e : esc){
+
+				out.write((char*)&e.second,sizeof(char_type));
+				w_bytes += sizeof(char_type);
+
+			}
+
+		}
+
 		return w_bytes;
 
 	}
@@ -276,27 +523,44 @@ public:
 		in.read((char*)&encode_size,sizeof(encode_size));
 		in.read((char*)&decode_size,sizeof(decode_size));
 
-		for(ulint i=0;i<encode_size;++i){
+		//canonical Huffman (see serialize)
+		if(decode_size == 0 and encode_size > 0){
+
+			dense_encode_ = vector<code_t>(DENSE_SIGMA);
+
+			vector<pair<uint64_t,char_type> > lengths(encode_size);
+
+			for(auto& e : lengths){
+
+				uint8_t l;
+				in.read((char*)&e.second,sizeof(char_type));
+				in.read((char*)&l,sizeof(l));
+				e.first = l;
+
+			}
+
+			build_canonical(lengths);
+
+		}
+
+		for(ulint i=0;i<encode_size and decode_size>0;++i){
 
 			char_type c;
 			in.read((char*)&c,sizeof(c));
 
-			vector<bool> B;
-			load_vec_bool(in,B);
-
-			encode_.insert({c,B});
+			code_of(c) = load_code(in);
 
 		}
 
 		for(ulint i=0;i<decode_size;++i){
 
-			vector<bool> B;
-			load_vec_bool(in,B);
+			code_t code = load_code(in);
 
 			char_type c;
 			in.read((char*)&c,sizeof(c));
 
-			decode_.insert({B,c});
+			//c is stored shifted by one (0 is reserved)
+			set_decode(code, c-1);
 
 		}
 
@@ -306,59 +570,118 @@ public:
 
 		in.read((char*)&enc_type,sizeof(enc_type));
 
+		if(enc_type == huffman){
+
+			escape_len_ = log_sigma;
+			log_sigma = 0;
+
+			//escaped characters get their codes back in the same order
+			ulint n_esc = sigma - canon_chars_.size();
+			sigma = canon_chars_.size();
+
+			for(ulint i = 0; i < n_esc; ++i){
+
+				char_type c;
+				in.read((char*)&c,sizeof(c));
+
+				encode(c);
+
+			}
+
+		}
+
 	}
 
 private:
 
-	ulint serialize_vec_bool(ostream &out, const vector<bool>& vb) const {
+	static constexpr char_type DENSE_SIGMA = 256;
+	static constexpr uint64_t DENSE_LOG_SIGMA = 16;
 
-		ulint size = vb.size();
-		ulint n_words = (size/64) + (size%64 != 0);
+	bool canonical() const { return not canon_first_.empty(); }
 
-		out.write((char*)&size,sizeof(size));
+	/*
+	 * true iif code starts with the escape code (open Huffman only)
+	 */
+	bool escaped(code_t code) const {
 
-		vector<uint64_t> w(n_words);
+		return	escape_len_ > 0 and code.len > escape_len_ and
+				(code.bits >> (code.len - escape_len_)) == (uint64_t(1) << escape_len_) - 1;
 
-		ulint i=0;
-		for(auto b : vb){
+	}
 
-			w[i/64] = (w[i/64]<<1) + b;
+	/*
+	 * reference to the code of c (empty code if c has no code yet)
+	 */
+	code_t& code_of(char_type c){
 
-		}
+		if(c < dense_encode_.size()) return dense_encode_[c];
 
-		//shift last word
-		if(size%64 != 0){
+		return encode_[c];
 
-			w[size/64] = w[size/64] << (64 - size%64);
+	}
 
-		}
+	/*
+	 * length of the codes stored in dense_decode_ (0 if there is no dense decode table)
+	 */
+	uint64_t dense_decode_bits() const {
+
+		return dense_decode_.size() == 0 ? 0 : log_sigma;
+
+	}
 
-		out.write((char*)w.data(),n_words*sizeof(uint64_t));
+	/*
+	 * hash key of a code: its bits preceded by a 1 (codes of different
+	 * lengths get different keys)
+	 */
+	static uint64_t key(code_t code){
 
-		return n_words*sizeof(uint64_t) + sizeof(size);
+		assert(code.len <= MAX_CODE_LEN);
+		return (uint64_t(1) << code.len) | code.bits;
 
 	}
 
-	void load_vec_bool(istream &in, vector<bool>& vb){
+	static code_t from_key(uint64_t k){
 
-		ulint size;
-		in.read((char*)&size,sizeof(size));
+		uint8_t len = 63 - __builtin_clzll(k);
+		return {k ^ (uint64_t(1) << len), len};
+
+	}
 
-		vb = vector<bool>(size);
+	void set_decode(code_t code, char_type c){
 
-		ulint n_words = (size/64) + (size%64 != 0);
+		//0 is reserved
+		if(code.size() == dense_decode_bits()) dense_decode_[code.bits] = c+1;
+		else decode_[key(code)] = c+1;
 
-		vector<uint64_t> w(n_words);
-		in.read((char*)w.data(),n_words*sizeof(uint64_t));
+	}
 
-		for(ulint i = 0; i<size;++i){
+	/*
+	 * codes are written as their length followed by one word holding
+	 * the code left-aligned (first bit = most significant bit)
+	 */
+	ulint serialize_code(ostream &out, code_t code) const {
 
-			bool b = (w[i/64]>>63)&ulint(1);
-			w[i/64] = w[i/64]<<1;
+		ulint size = code.len;
+		out.write((char*)&size,sizeof(size));
 
-			vb[i] = b;
+		uint64_t w = code.bits << (64 - size);
+		out.write((char*)&w,sizeof(w));
 
-		}
+		return sizeof(w) + sizeof(size);
+
+	}
+
+	code_t load_code(istream &in){
+
+		ulint size;
+		in.read((char*)&size,sizeof(size));
+
+		assert(size > 0 and size <= MAX_CODE_LEN);
+
+		uint64_t w;
+		in.read((char*)&w,sizeof(w));
+
+		return {w >> (64 - size), uint8_t(size)};
 
 	}
 
@@ -397,30 +720,116 @@ private:
 
 	};
 
-	void extract_codes(node* n, const vector<bool>& C){
+	/*
+	 * depth of each leaf of the Huffman tree, as pairs <length,character>.
+	 * A single character gets length 1
+	 */
+	void extract_lengths(node* root, vector<pair<uint64_t,char_type> >& lengths){
 
-		if(is_leaf(n)){
+		vector<pair<node*,uint64_t> > stack = {{root,0}};
 
-			assert(C.size()>0);
+		while(not stack.empty()){
 
-			encode_[label(n)] = C;
-			decode_[C] = label(n)+1;
+			auto n = stack.back();
+			stack.pop_back();
 
-		}else{
+			if(is_leaf(n.first)){
 
-			vector<bool> l = C;
-			vector<bool> r = C;
+				lengths.push_back({std::max<uint64_t>(n.second,1), label(n.first)});
 
-			l.push_back(false);
-			r.push_back(true);
+			}else{
+
+				stack.push_back({left(n.first),n.second+1});
+				stack.push_back({right(n.first),n.second+1});
 
-			extract_codes(left(n),l);
-			extract_codes(right(n),r);
+			}
 
 		}
 
 	}
 
+	/*
+	 * limit code lengths to MAX_HUFFMAN_LEN: longer codes are cut, then the
+	 * Kraft inequality is restored by lengthening the longest codes that are
+	 * still shorter than the limit (the least probable ones)
+	 */
+	static void limit_lengths(vector<pair<uint64_t,char_type> >& lengths){
+
+		const uint64_t L = MAX_HUFFMAN_LEN;
+
+		std::sort(lengths.begin(), lengths.end());
+
+		//Kraft sum, in units of 2^-L
+		uint64_t kraft = 0;
+
+		for(auto& e : lengths){
+
+			e.first = std::min(e.first, L);
+			kraft += uint64_t(1) << (L - e.first);
+
+		}
+
+		//lengths are sorted: j is the last code shorter than L
+		int64_t j = lengths.size()-1;
+		while(j >= 0 and lengths[j].first == L) --j;
+
+		while(kraft > uint64_t(1) << L){
+
+			assert(j >= 0);
+
+			kraft -= uint64_t(1) << (L - lengths[j].first - 1);
+			lengths[j].first++;
+
+			if(lengths[j].first == L) --j;
+
+		}
+
+	}
+
+	/*
+	 * assign canonical codes, given the pairs <length,character>: codes are
+	 * assigned by increasing (length,character), each one being the previous
+	 * code plus one, shifted to the new length
+	 */
+	void build_canonical(vector<pair<uint64_t,char_type> > lengths){
+
+		std::sort(lengths.begin(), lengths.end());
+
+		canon_chars_.resize(lengths.size());
+		canon_first_ = vector<uint64_t>(MAX_HUFFMAN_LEN+2, 0);
+		canon_offset_ = vector<uint64_t>(MAX_HUFFMAN_LEN+2, lengths.size());
+
+		uint64_t code = 0;
+		uint64_t len = 0;
+
+		for(uint64_t i = 0; i < lengths.size(); ++i){
+
+			assert(lengths[i].first > 0 and lengths[i].first <= MAX_HUFFMAN_LEN);
+
+			if(i > 0) code++;
+
+			//first code of each length between len and the new one
+			while(len < lengths[i].first){
+
+				if(len > 0) code <<= 1;
+				len++;
+
+				canon_first_[len] = code;
+				canon_offset_[len] = i;
+
+			}
+
+			canon_chars_[i] = lengths[i].second;
+
+			code_of(lengths[i].second) = {code, uint8_t(len)};
+
+		}
+
+		//the Kraft inequality holds: the last code fits in its length
+		assert(len == 0 or (code >> len) == 0);
+
+	}
+
 	bool is_leaf(node* n){
 
 		return n->first.first==NULL;
@@ -452,45 +861,51 @@ private:
 	/*
 	 * increment sigma and return gamma code of sigma
 	 */
-	vector<bool> get_new_gamma(){
-
-		vector<bool> C;
-
-		sigma++;
+	code_t get_new_gamma(){
 
-		//bit length of sigma
-		uint8_t len = 64-__builtin_clzll(sigma);
+		//bit length of sigma+1
+		uint8_t len = 64-__builtin_clzll(sigma+1);
 
-		for(uint8_t i =0;i<len-1;++i) C.push_back(false);
+		if(2*len-1 > MAX_CODE_LEN)
+			throw std::length_error("alphabet_encoder: gamma codes are limited to MAX_CODE_LEN bits");
 
-		for(uint8_t i =0;i<len;++i) C.push_back( (sigma >> (len-i-1)) & uint64_t(1) );
+		sigma++;
 
-		return C;
+		//len-1 zeros followed by sigma
+		return {sigma, uint8_t(2*len-1)};
 
 	}
 
 	/*
-	 * increment sigma and return fixed-length code of sigma
+	 * increment sigma and return the escape code followed by the gamma code
+	 * of the number of escaped characters
 	 */
-	vector<bool> get_new_fixed(){
+	code_t get_new_escaped(){
 
-		assert(sigma < uint64_t(1)<<log_sigma);
+		assert(escape_len_ > 0);
 
-		vector<bool> C;
+		uint64_t k = sigma - canon_chars_.size() + 1;
+		uint8_t len = 64-__builtin_clzll(k);
 
-		if(sigma==0){
+		if(escape_len_ + 2*len-1 > MAX_CODE_LEN)
+			throw std::length_error("alphabet_encoder: escaped codes are limited to MAX_CODE_LEN bits");
 
-			for(uint8_t i =0;i<log_sigma;++i) C.push_back( false );
+		sigma++;
 
-		}else{
+		uint64_t escape = (uint64_t(1) << escape_len_) - 1;
 
-			for(uint8_t i =0;i<log_sigma;++i) C.push_back( (sigma >> (log_sigma-i-1)) & uint64_t(1) );
+		return {(escape << (2*len-1)) | k, uint8_t(escape_len_ + 2*len-1)};
 
-		}
+	}
 
-		sigma++;
+	/*
+	 * increment sigma and return fixed-length code of sigma
+	 */
+	code_t get_new_fixed(){
 
-		return C;
+		assert(sigma < uint64_t(1)<<log_sigma);
+
+		return {sigma++, uint8_t(log_sigma)};
 
 	}
 
@@ -498,15 +913,31 @@ private:
 
 
 
-    tsl::hopscotch_map<char_type,vector<bool> > encode_;
+    tsl::hopscotch_map<char_type,code_t> encode_;
+
+	//codes are hashed through key(). char_type value 0 is reserved
+    tsl::hopscotch_map<uint64_t, char_type> decode_;
 
-	//char_type value 0 is reserved
-    tsl::hopscotch_map<vector<bool>, char_type> decode_;
+	//codes of characters < DENSE_SIGMA (bounded alphabets only)
+	vector<code_t> dense_encode_;
+
+	//fixed-size codes of at most DENSE_LOG_SIGMA bits: character+1 indexed by code value
+	vector<char_type> dense_decode_;
+
+	/*
+	 * canonical Huffman decoding: the codes of length l are canon_first_[l], +1, ...
+	 * and belong to characters canon_chars_[canon_offset_[l] ... canon_offset_[l+1]-1]
+	 */
+	vector<char_type> canon_chars_;
+	vector<uint64_t> canon_first_;
+	vector<uint64_t> canon_offset_;
 
 	uint64_t sigma;
 
 	uint64_t log_sigma = 0;//used only with fixed size
 
+	uint64_t escape_len_ = 0;//open Huffman only: length of the escape code
+
 	type enc_type;
 
 };
@@ -106,6 +106,63 @@ class buffered_packed_bit_vector {
         return rank(i + 1);
     }
 
+    /*
+     * the n <= 64 bits starting at position i, packed in the n least
+     * significant bits of the result
+     */
+    uint64_t get_bits(uint64_t i, uint8_t n) const {
+        assert(n <= 64 and i + n <= size_);
+
+        if (n == 0) return 0;
+
+        uint64_t x = 0;
+
+        if (buffer_count == 0) {
+            uint64_t s = fast_mod(i);
+            x = words[fast_div(i)] >> s;
+
+            if (s + n > 64) x |= words[fast_div(i) + 1] << (64 - s);
+
+            return n == 64 ? x : x & ((MASK << n) - 1);
+        }
+
+        for (uint8_t k = 0; k < n; ++k) x |= uint64_t(at(i + k)) << k;
+
+        return x;
+    }
+
+    /*
+     * smallest index j >= i such that the j-th bit is set, or size() if
+     * there is none. Trailing-zeros scan of the words if the buffer is empty
+     */
+    uint64_t next1(uint64_t i) const { return next<true>(i); }
+
+    /*
+     * smallest index j >= i such that the j-th bit is not set, or size()
+     * if there is none
+     */
+    uint64_t next0(uint64_t i) const { return next<false>(i); }
+
+    /*
+     * largest index j <= i such that the j-th bit is set, or size() if
+     * there is none
+     */
+    uint64_t prev1(uint64_t i) const {
+        assert(i < size_);
+
+        if (buffer_count == 0) {
+            uint64_t w = fast_div(i);
+            uint64_t x = words[w] & (~uint64_t(0) >> (63 - fast_mod(i)));
+
+            while (x == 0 and w > 0) x = words[--w];
+
+            return x == 0 ? size_ : fast_mul(w) + 63 - __builtin_clzll(x);
+        }
+
+        uint64_t r = rank(i + 1);
+        return r == 0 ? size_ : search(r);
+    }
+
     /*
      * smallest index j such that psum(j)>=x
      */
@@ -169,9 +226,8 @@ class buffered_packed_bit_vector {
         uint8_t current_buffer = 0;
         int8_t a_pos_offset = 0;
 
-        auto div = fast_div(size_);
-        for (uint64_t j = 0; j < div; ++j) {
-            pop = 64 - __builtin_popcountll(words[j]);
+        for (uint64_t j = 0; j < words.size(); ++j) {
+            pop += 64 - __builtin_popcountll(words[j]);
             pos += 64;
             if constexpr (buffer_size != 0) {
                 for (uint8_t b = current_buffer; b < buffer_count; b++) {
@@ -198,8 +254,11 @@ class buffered_packed_bit_vector {
             if (pop >= x) break;
         }
 
-
-        pos = size_ < pos ? size_ : pos;
+        // the unused bits past the end are 0: they are not zeros of the vector
+        if (pos > size_) {
+            pop -= pos - size_;
+            pos = size_;
+        }
 
         while (pop >= x && pos > 0) {
             pop -= at(--pos) ? 0 : 1;
@@ -340,6 +399,16 @@ class buffered_packed_bit_vector {
         }
     }
 
+    /*
+     * remove the n bits in positions [i, i+n), from the back: each removal
+     * is buffered like a single remove
+     */
+    void remove_range(uint64_t i, uint64_t n) {
+        assert(i + n <= size_);
+
+        for (uint64_t j = i + n; j > i; --j) remove(j - 1);
+    }
+
     void insert(uint64_t i, uint64_t x) {
         if (i == size_) {
             push_back(x);
@@ -582,6 +651,31 @@ class buffered_packed_bit_vector {
     uint64_t select(uint64_t n) { return search(n + 1); }
 
    private:
+    template <bool b>
+    uint64_t next(uint64_t i) const {
+        if (i >= size_) return size_;
+
+        if (buffer_count == 0) {
+            uint64_t w = fast_div(i);
+            uint64_t nr_words = fast_div(size_) + (fast_mod(size_) != 0);
+            uint64_t x = (b ? words[w] : ~words[w]) & (~uint64_t(0) << fast_mod(i));
+
+            while (x == 0 and ++w < nr_words) x = b ? words[w] : ~words[w];
+
+            if (x == 0) return size_;
+
+            uint64_t j = fast_mul(w) + __builtin_ctzll(x);
+            return j < size_ ? j : size_;
+        }
+
+        // pending buffered operations: fall back to rank/select
+        uint64_t r = b ? rank(i) : i - rank(i);
+
+        if (r == (b ? psum_ : size_ - psum_)) return size_;
+
+        return b ? search(r + 1) : search_0(r + 1);
+    }
+
     static uint64_t fast_mod(uint64_t const num) { return num & 63; }
 
     static uint64_t fast_div(uint64_t const num) { return num >> 6; }
@@ -8,13 +8,19 @@
 // Description : Dynamic (only append) compressed BWT.
 
 /*
- * dynamic BWT, template on a dynamic string type (for the BWT) and on a RLE string type (for
- * the first column of the BWT matrix)
+ * dynamic BWT, template on a dynamic string type (for the BWT) and on a dynamic C array type
+ * (replacing the first column F of the BWT matrix: see c_array.hpp)
  * This class permits to extend the BWT by left-extending the text and do backward search.
  * Note that this class does not store a suffix array sampling: locate is not supported.
  *
  * Note: alphabet character 2^64-1 is reserved for the BWT terminator
  *
+ * Note: the second template parameter used to be the string type of column F
+ * (bwt<dynamic_string_type, rle_string_type>). It is now the C array type, and
+ * bwt<X, rle_str> is rejected at compile time. The serialized format changed
+ * with it: terminator position, C array (see c_array.hpp), L. BWTs serialized
+ * with a column F cannot be loaded.
+ *
  */
 //============================================================================
 
@@ -26,18 +32,75 @@
 #include "dynamic/internal/gap_bitvector.hpp"
 #include "dynamic/internal/rle_string.hpp"
 #include "dynamic/internal/wt_string.hpp"
+#include "dynamic/internal/c_array.hpp"
+#include "dynamic/internal/kmer_table.hpp"
+#include "dynamic/internal/spsi.hpp"
+#include "dynamic/internal/packed_vector.hpp"
 
 namespace dyn {
 
 template <	class dynamic_string_type,	//to encode BWT
-			class rle_string_type		//to encode column F
+			class c_array_type = c_array<spsi<packed_vector,256,16> >	//character counts (column F)
 			>
 class bwt {
+
+	static_assert(is_c_array<c_array_type>::value,
+		"bwt<string, F_string> is no longer supported: the second template parameter "
+		"is now the C array type (e.g. bwt<wt_str> or bwt<wt_str, c_array<spsi_type> >)");
+
 public:
 
 	//we allow any alphabet
 	typedef uint64_t char_type;
 
+	/*
+	 * statistics of a batch of queries (see count_many)
+	 */
+	struct query_stats{
+
+		ulint queries = 0;
+
+		//backward search steps performed (patterns with a common suffix
+		//share them) and total length of the patterns (steps without sharing)
+		ulint LF_steps = 0;
+		ulint pattern_length = 0;
+
+		//wall time of the batch, in seconds
+		double seconds = 0;
+
+		//per query: seconds from the start of the batch to the answer
+		vector<double> latency;
+
+		//p-th percentile of the latencies, 0 <= p <= 100
+		double percentile(double p) const {
+
+			assert(latency.size()>0);
+			assert(p>=0 and p<=100);
+
+			vector<double> L(latency);
+			ulint k = std::min(ulint(L.size()*p/100), ulint(L.size()-1));
+
+			std::nth_element(L.begin(), L.begin()+k, L.end());
+
+			return L[k];
+
+		}
+
+	};
+
+	/*
+	 * an approximate occurrence (see count_approximate)
+	 */
+	struct approximate_match{
+
+		//BWT interval of the matched string of the text
+		pair<ulint,ulint> range;
+
+		//mismatches (or edits) between the pattern and the matched string
+		ulint errors;
+
+	};
+
 	/*
 	 * Constructor #1
 	 *
@@ -59,7 +122,6 @@ public:
 
 		assert(sigma>0);
 
-		F = rle_string_type(sigma);
 		L = dynamic_string_type(sigma);
 
 	}
@@ -81,7 +143,6 @@ public:
 
 		}
 
-		F = rle_string_type(P);
 		L = dynamic_string_type(P);
 
 	}
@@ -122,33 +183,51 @@ public:
 	void extend(char_type c){
 
 		assert(c!=TERMINATOR);
-		//position in F where c has to be inserted
-		ulint pos_in_F;
-
-		//are we inserting a new character?
-		if(alphabet.find(c)==alphabet.end()){
-			//iterator to character immediately after c (in lex order)
-			//or alphabet.end() if c is bigger than all a in alphabet
-			auto upit = alphabet.upper_bound(c);
-
-			pos_in_F = 	upit==alphabet.end() ?
-								F.size() :
-								F.select(0,*upit);
 
-			alphabet.insert(c);
+		//position in F where c has to be inserted: after all characters
+		//smaller than c and all cs before the terminator in L
+		ulint pos_in_F = C.C(c);
 
-		}else{
-			//number of cs before terminator in L
-			ulint c_before = L.rank(terminator_position,c);
-			pos_in_F = 	F.select(0,c) + c_before;
+		if(C.contains(c)) pos_in_F += L.rank(terminator_position,c);
 
-		}
-		F.insert(pos_in_F,c);
+		C.increment(c);
 		L.insert(terminator_position,c);
 
 		//add 1 to take into account terminator in F
 		terminator_position = pos_in_F+1;
 
+		extend_kmer_table(c);
+
+	}
+
+	/*
+	 * build BWT(sW) from BWT(W), where s = s[0,...,len-1]. Same as
+	 * extend(s[len-1]), extend(s[len-2]), ..., extend(s[0]).
+	 */
+	void extend(const char_type* s, size_t len){
+
+		extend(s, len, [](ulint){});
+
+	}
+
+	/*
+	 * merge: given the BWT of V (other) and this BWT of W, this becomes the
+	 * BWT of V sep W, i.e. the text of other is prepended to this text,
+	 * followed by the separator sep. sep must be smaller than all characters
+	 * of V (it can occur in W).
+	 *
+	 * With sep, the suffixes of V sep W starting in V are sorted as the
+	 * suffixes of V in other (sep plays the role of other's terminator), and
+	 * those starting in W as in this BWT: the merged BWT is an interleaving
+	 * of the two BWTs (see merge_positions), with this terminator replaced by
+	 * sep. L is rebuilt from scratch with bulk appends (alphabet unknown, see
+	 * Constructor #1), so the character encoding chosen at construction
+	 * time is not kept.
+	 */
+	void merge(const bwt& other, char_type sep){
+
+		merge_with(other, sep, merge_positions(other, sep));
+
 	}
 
 	/*
@@ -167,7 +246,7 @@ public:
 		/*
 		 * if c is not in the alphabet or empty interval, return empty interval
 		 */
-		if(alphabet.find(c) == alphabet.end() or interval.first >= interval.second)
+		if(not C.contains(c) or interval.first >= interval.second)
 			return {0,0};
 
 		/*
@@ -183,10 +262,10 @@ public:
 					interval.second-1;
 
 		//position in F of the first c
-		//Add 1 because in F.select(0,c) we are
+		//Add 1 because in C[c] we are
 		//not taking into account the terminator (which is in
 		//position 0 but not explicitly stored in F)
-		ulint F_pos = F.select(0,c) + 1;
+		ulint F_pos = C.C(c) + 1;
 
 		return {	F_pos+L.rank(l,c),
 					F_pos+L.rank(r,c)
@@ -194,6 +273,44 @@ public:
 
 	}
 
+	/*
+	 * LF(interval,c) for all characters c at once. Input: interval of a
+	 * string W. Output: pairs <c, interval of cW>, for the characters c such
+	 * that cW occurs, in increasing order of c.
+	 *
+	 * The ranks of all characters are computed in one traversal of L when
+	 * the string supports it (see wt_string::rank_all), instead of one rank
+	 * query (i.e. one descent of the wavelet tree) per character
+	 */
+	vector<pair<char_type, pair<ulint,ulint> > > LF_all(pair<ulint,ulint> interval) const {
+
+		assert(interval.first <= bwt_length() and interval.second <= bwt_length());
+
+		vector<pair<char_type, pair<ulint,ulint> > > res;
+
+		if(interval.first >= interval.second) return res;
+
+		ulint l = 	interval.first <= terminator_position ?
+					interval.first :
+					interval.first-1;
+
+		ulint r = 	interval.second <= terminator_position ?
+					interval.second :
+					interval.second-1;
+
+		for(auto t : rank_all(L,l,r)){
+
+			char_type c = std::get<0>(t);
+			ulint F_pos = C.C(c) + 1;
+
+			res.push_back({c, {F_pos + std::get<1>(t), F_pos + std::get<2>(t)}});
+
+		}
+
+		return res;
+
+	}
+
 	/*
 	 * count number of occurrences of pattern P
 	 * returns range [l,r) (right-exclusive) on BWT of P
@@ -201,13 +318,231 @@ public:
 	pair<ulint,ulint> count(vector<char_type> P) const {
 
 		pair<ulint,ulint> rn = {0,size()};
+		ulint i = 0;
+
+		//the last k characters of P with the k-mer table, if any
+		if(K.enabled() and P.size() > 0){
+
+			i = std::min(ulint(P.size()), K.length());
+			rn = kmer_interval(P.data() + P.size() - i, i);
+
+		}
 
-		for(ulint i=0;i<P.size();++i) rn = LF(rn, P.at(P.size()-i-1));
+		for(;i<P.size();++i) rn = LF(rn, P.at(P.size()-i-1));
 
 		return rn;
 
 	}
 
+	/*
+	 * approximate pattern matching: the strings of the text at Hamming
+	 * distance (edits = false) or edit distance (edits = true) at most k
+	 * from P, with their BWT intervals. Intervals are distinct; with edits
+	 * they can be nested (a string and its left extensions), and each has
+	 * the smallest distance found. The empty string is never matched.
+	 *
+	 * Backtracking backward search: the next character of the text is
+	 * either P's next character, or (with an error) any other character;
+	 * with edits, a character of P can also be deleted or one of the text
+	 * inserted. Insertions are not tried before the first text character,
+	 * as they never reduce the distance. The children of a search node
+	 * are computed at once with LF_all.
+	 *
+	 * Pruning: D[j] is a lower bound on the errors of P[0,...,j-1]. If
+	 * P[a,...,j-1] does not occur, then any occurrence of P[0,...,j-1] has
+	 * an error in it, so D[j] = 1 + D[a] where P[a+1,...,j-1] is the
+	 * longest suffix that occurs (found by backward search). A node that
+	 * has j characters of P left and less than D[j] errors left is cut.
+	 */
+	vector<approximate_match> count_approximate(const vector<char_type>& P, ulint k, bool edits = false) const {
+
+		vector<approximate_match> res;
+
+		auto D = error_lower_bounds(P);
+
+		approximate_search(P, P.size(), get_full_interval(), 0, k, edits, false, D, res);
+
+		std::sort(res.begin(),res.end(),[](const approximate_match& a, const approximate_match& b){
+
+			return a.range < b.range or (a.range == b.range and a.errors < b.errors);
+
+		});
+
+		//with edits, the same string can be found with different alignments
+		res.erase(std::unique(res.begin(),res.end(),[](const approximate_match& a, const approximate_match& b){
+
+			return a.range == b.range;
+
+		}),res.end());
+
+		return res;
+
+	}
+
+	/*
+	 * build the k-mer table (see kmer_table.hpp): count skips the first k
+	 * steps of backward search, i.e. about k rank queries per pattern. The
+	 * table has sigma^k counters, where sigma is the size of its alphabet:
+	 * the text alphabet plus the given characters (e.g. {'A','C','G','T'}
+	 * to build the table on an empty index). It is patched by extend, and
+	 * dropped if the text is extended with a character outside its
+	 * alphabet; merge rebuilds it. The table is not serialized: it must be
+	 * built again after load and build_from_string. k = 0 drops the table.
+	 *
+	 * The table is built with one LF step per text character
+	 */
+	void build_kmer_table(ulint k, vector<char_type> alphabet = {}){
+
+		if(k == 0){
+
+			K = kmer_table();
+			return;
+
+		}
+
+		alphabet.insert(alphabet.end(), C.alphabet().begin(), C.alphabet().end());
+
+		K = kmer_table(alphabet, k);
+
+		//row 0 is the terminator suffix: LF reads the text right to left,
+		//i.e. in the order of extend
+		ulint r = 0;
+
+		for(ulint j=0;j<text_length();++j){
+
+			K.extend(at(r));
+			r = LF(r);
+
+		}
+
+	}
+
+	/*
+	 * length k of the k-mer table, 0 if there is no table
+	 */
+	ulint kmer_table_length() const {
+
+		return K.length();
+
+	}
+
+	/*
+	 * count(P) for each pattern P of a batch. If stats is not NULL, it is filled
+	 * with the statistics of the batch.
+	 *
+	 * Backward search reads patterns right to left, so patterns with a common
+	 * suffix share the intervals of that suffix: the reversed patterns are
+	 * put in a trie, and the interval of each trie node is computed once, with
+	 * one LF step from the interval of its parent. Nodes of the same depth are
+	 * independent: each level is processed in parallel (OpenMP, see
+	 * XXSDS_DYN_MULTI_THREADED), with concurrent const queries on the index.
+	 * A pattern is answered when the level of its length is done.
+	 */
+	vector<pair<ulint,ulint> > count_many(const vector<vector<char_type> >& patterns, query_stats* stats = NULL) const {
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		//sort the patterns by reversed pattern: a pattern shares with the previous
+		//one the trie nodes of their longest common suffix
+		vector<ulint> order(patterns.size());
+		for(ulint i=0;i<order.size();++i) order[i] = i;
+
+		std::sort(order.begin(),order.end(),[&](ulint a, ulint b){
+
+			return std::lexicographical_compare(patterns[a].rbegin(),patterns[a].rend(),
+												patterns[b].rbegin(),patterns[b].rend());
+
+		});
+
+		//node k at depth d: parent[d][k] at depth d-1, labeled label[d][k].
+		//Depth 0 has only the root
+		vector<vector<ulint> > parent(1,vector<ulint>(1,0));
+		vector<vector<char_type> > label(1,vector<char_type>(1,0));
+
+		vector<ulint> node_of(patterns.size(),0);
+		vector<ulint> path(1,0);	//trie path of the previous pattern
+
+		ulint pattern_length = 0;
+
+		for(ulint i=0;i<order.size();++i){
+
+			auto& P = patterns[order[i]];
+			pattern_length += P.size();
+
+			//longest common suffix with the previous pattern
+			ulint l = 0;
+
+			if(i>0){
+
+				auto& Q = patterns[order[i-1]];
+
+				while(l<P.size() and l<Q.size() and P[P.size()-1-l] == Q[Q.size()-1-l]) ++l;
+
+			}
+
+			if(path.size() <= P.size()) path.resize(P.size()+1);
+			if(parent.size() <= P.size()){
+
+				parent.resize(P.size()+1);
+				label.resize(P.size()+1);
+
+			}
+
+			for(ulint d=l+1;d<=P.size();++d){
+
+				parent[d].push_back(path[d-1]);
+				label[d].push_back(P[P.size()-d]);
+
+				path[d] = parent[d].size()-1;
+
+			}
+
+			node_of[order[i]] = path[P.size()];
+
+		}
+
+		//intervals, level by level
+		vector<vector<pair<ulint,ulint> > > I(parent.size());
+		I[0] = {{0,size()}};
+
+		//seconds from start to the end of each level
+		vector<double> level_done(parent.size(),0);
+
+		ulint LF_steps = 0;
+
+		for(ulint d=1;d<parent.size();++d){
+
+			I[d] = vector<pair<ulint,ulint> >(parent[d].size());
+
+			#pragma omp parallel for schedule(dynamic,64)
+			for(ulint k=0;k<parent[d].size();++k)
+				I[d][k] = LF(I[d-1][parent[d][k]], label[d][k]);
+
+			LF_steps += parent[d].size();
+			level_done[d] = std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+
+		}
+
+		vector<pair<ulint,ulint> > res(patterns.size());
+
+		for(ulint i=0;i<patterns.size();++i) res[i] = I[patterns[i].size()][node_of[i]];
+
+		if(stats != NULL){
+
+			stats->queries = patterns.size();
+			stats->LF_steps = LF_steps;
+			stats->pattern_length = pattern_length;
+			stats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+
+			stats->latency = vector<double>(patterns.size());
+			for(ulint i=0;i<patterns.size();++i) stats->latency[i] = level_done[patterns[i].size()];
+
+		}
+
+		return res;
+
+	}
+
 	/*
 	 * LF function
 	 */
@@ -220,7 +555,7 @@ public:
 		ulint j = i <= terminator_position ? i : i-1;
 		//add 1 because terminator is not explicitly stored in F
 		return 	c == TERMINATOR ? 0 :
-				F.select(0,c) + L.rank(j,c) + 1;
+				C.C(c) + L.rank(j,c) + 1;
 
 	}
 
@@ -235,7 +570,7 @@ public:
 
 		//add 1 because terminator is not explicitly stored in F
 		return 	c == TERMINATOR ? 0 :
-				F.select(0,c) + L.rank(j,c) + 1;
+				C.C(c) + L.rank(j,c) + 1;
 
 	}
 
@@ -246,10 +581,10 @@ public:
 
 		assert(i<bwt_length());
 
-		char_type c = i==0 ? TERMINATOR : F[i-1];
+		char_type c = F(i);
 
 		//number of c before position i in F
-		ulint j = i==0 ? 0 : F.rank(i-1,c);
+		ulint j = i==0 ? 0 : (i-1) - C.C(c);
 
 		//position on L
 		ulint k = 	c == TERMINATOR ? 0 :
@@ -260,6 +595,17 @@ public:
 
 	}
 
+	/*
+	 * i-th character of the first BWT column. F[0] is the terminator
+	 */
+	char_type F(ulint i) const {
+
+		assert(i<bwt_length());
+
+		return i==0 ? TERMINATOR : C[i-1];
+
+	}
+
 	pair<ulint, ulint> get_full_interval() const {
 
 		return {0,bwt_length()};
@@ -292,14 +638,14 @@ public:
 	//alphabet of the text
 	ulint text_alphabet_size() const {
 
-		return alphabet.size();
+		return C.sigma();
 
 	}
 
 	//alphabet of the text + terminator character
 	ulint bwt_alphabet_size() const {
 
-		return alphabet.size()+1;
+		return C.sigma()+1;
 
 	}
 
@@ -349,7 +695,7 @@ public:
 	 */
 	set<char_type> get_alphabet() const {
 
-		set<char_type> A(alphabet);
+		set<char_type> A(C.alphabet().begin(), C.alphabet().end());
 
 		A.insert(ulint(TERMINATOR));
 
@@ -359,20 +705,14 @@ public:
 
 	/*
 	 * Total number of bits allocated in RAM for this structure
-	 *
-	 * WARNING: this measure is good only for relatively small alphabets (e.g. ASCII)
-	 * as we use STL containers such as set and map which do not give direct info on
-	 * the total memory allocated. The sizes of these containers are proportional
-	 * to the alphabet size (but the constants involved are high since internally
-	 * they can use heavy structures as RBT)
 	 */
 	ulint bit_size() const {
 
-		ulint size = sizeof(bwt<dynamic_string_type,rle_string_type>)*8;
+		ulint size = sizeof(bwt<dynamic_string_type,c_array_type>)*8;
 
-		size += F.bit_size();
+		size += C.bit_size();
 		size += L.bit_size();
-		size += alphabet.size()*sizeof(char_type*)*8;
+		size += K.bit_size();
 
 		return size;
 
@@ -382,18 +722,10 @@ public:
 
 		ulint w_bytes=0;
 
-		ulint a_size = alphabet.size();
-
-		out.write((char*)&a_size,sizeof(a_size));
-		w_bytes += sizeof(a_size);
-
 		out.write((char*)&terminator_position,sizeof(terminator_position));
 		w_bytes += sizeof(terminator_position);
 
-		for(auto a:alphabet) out.write((char*)&a,sizeof(a));
-		w_bytes += a_size*sizeof(char_type);
-
-		w_bytes += F.serialize(out);
+		w_bytes += C.serialize(out);
 		w_bytes += L.serialize(out);
 
 		return w_bytes;
@@ -402,76 +734,448 @@ public:
 
 	void load(istream &in){
 
-		ulint a_size;
-
-		in.read((char*)&a_size,sizeof(a_size));
 		in.read((char*)&terminator_position,sizeof(terminator_position));
 
-		for(ulint i=0;i<a_size;++i){
+		C.load(in);
+		L.load(in);
+
+		K = kmer_table();
+
+	}
+
+protected:
+
+	/*
+	 * extend(s,len), calling step(p) after each character with the new
+	 * terminator position p (used by fm_index to mark the new suffix)
+	 *
+	 * The terminator position is kept in a local variable between steps,
+	 * and the C array is updated only at the end, once per distinct
+	 * character. In between, the C value of a character c is its C value
+	 * before the batch plus the number of characters smaller than c
+	 * already extended, kept in a Fenwick tree over the alphabet of s
+	 */
+	template<class step_type>
+	void extend(const char_type* s, size_t len, step_type step){
+
+		//alphabet of s
+		vector<char_type> A(s, s+len);
+		std::sort(A.begin(),A.end());
+		A.erase(std::unique(A.begin(),A.end()),A.end());
+
+		//C values before the batch, characters in L, Fenwick tree of
+		//the characters extended in the batch, and their counts
+		vector<ulint> C0(A.size());
+		vector<bool> in_L(A.size());
+		vector<ulint> added(A.size()+1,0);
+		vector<ulint> counts(A.size(),0);
 
-			char_type a;
-			in.read((char*)&a,sizeof(a));
+		for(ulint k=0;k<A.size();++k){
 
-			alphabet.insert(a);
+			assert(A[k]!=TERMINATOR);
+
+			C0[k] = C.C(A[k]);
+			in_L[k] = C.contains(A[k]);
 
 		}
 
-		F.load(in);
-		L.load(in);
+		ulint tp = terminator_position;
+
+		for(size_t j=len;j>0;--j){
+
+			char_type c = s[j-1];
+			ulint k = std::lower_bound(A.begin(),A.end(),c) - A.begin();
+
+			//C value of c: add the batch characters smaller than c
+			ulint pos_in_F = C0[k];
+
+			for(ulint x=k;x>0;x -= x & (~x+1)) pos_in_F += added[x];
+
+			if(in_L[k]) pos_in_F += L.rank(tp,c);
+
+			L.insert(tp,c);
+
+			in_L[k] = true;
+			counts[k]++;
+			for(ulint x=k+1;x<=A.size();x += x & (~x+1)) added[x]++;
+
+			tp = pos_in_F+1;
+
+			extend_kmer_table(c);
+
+			step(tp);
+
+		}
+
+		terminator_position = tp;
+
+		for(ulint k=0;k<A.size();++k) C.increment(A[k],counts[k]);
+
+	}
+
+	/*
+	 * interleaving of merge(other,sep): P[j] = number of rows of this BWT
+	 * that precede row j of other in the merged BWT (non-decreasing in j).
+	 *
+	 * Row 0 of other (suffix sep W) precedes the rows of this BWT whose
+	 * suffixes are smaller than sep W, i.e. LF(terminator_position, sep).
+	 * The other rows are visited in text order with LF on other: if P[j]
+	 * rows precede suffix X, then LF(P[j], c) rows precede cX, c in V.
+	 * Only rank queries on this BWT: nothing is modified.
+	 */
+	vector<ulint> merge_positions(const bwt& other, char_type sep) const {
+
+		assert(sep != TERMINATOR);
+		assert(other.C.sigma()==0 or sep < other.C.alphabet()[0]);
+
+		vector<ulint> P(other.bwt_length());
+
+		//rows preceding sep W (this terminator is sep in the merged BWT)
+		ulint p = C.C(sep) + 1;
+		if(C.contains(sep)) p += L.rank(terminator_position,sep);
+
+		ulint j = 0;
+		P[0] = p;
+
+		while(j != other.terminator_position){
+
+			ulint jL = j < other.terminator_position ? j : j-1;
+			char_type c = other.L.at(jL);
+
+			//LF on this BWT (c is not sep)
+			ulint pL = p <= terminator_position ? p : p-1;
+			p = C.C(c) + 1 + (C.contains(c) ? L.rank(pL,c) : 0);
+
+			//LF on other
+			j = other.C.C(c) + other.L.rank(jL,c) + 1;
+
+			P[j] = p;
+
+		}
+
+		return P;
 
 	}
 
+	/*
+	 * second half of merge: rebuild L, C and the terminator position, given
+	 * the interleaving P (see merge_positions)
+	 */
+	void merge_with(const bwt& other, char_type sep, const vector<ulint>& P){
+
+		assert(P.size() == other.bwt_length());
+
+		dynamic_string_type merged;
+		ulint merged_tp = 0;
+
+		string_reader this_L(L);
+		string_reader other_L(other.L);
+
+		vector<char_type> buf;
+
+		auto emit = [&](char_type c){
+
+			buf.push_back(c);
+
+			if(buf.size() == MERGE_CHUNK){
+
+				append(merged,buf);
+				buf.clear();
+
+			}
+
+		};
+
+		//row r of this BWT, and row j of other
+		ulint r = 0;
+
+		for(ulint j=0;j<=P.size();++j){
+
+			ulint end = j < P.size() ? P[j] : bwt_length();
+
+			for(;r<end;++r) emit(r == terminator_position ? sep : this_L.next());
+
+			if(j == P.size()) break;
+
+			if(j == other.terminator_position) merged_tp = r + j;
+			else emit(other_L.next());
+
+		}
+
+		append(merged,buf);
+
+		L = std::move(merged);
+		terminator_position = merged_tp;
+
+		for(auto c : other.C.alphabet()) C.increment(c,other.C.count(c));
+		C.increment(sep);
+
+		assert(L.size() + 1 == bwt_length());
+
+		if(K.enabled()) build_kmer_table(K.length(), K.alphabet());
+
+	}
 
 private:
 
-	void insert_in_F(char_type c, ulint k=1){
+	/*
+	 * D[j], j = 0, ..., |P|: lower bound on the errors of an occurrence of
+	 * P[0,...,j-1] (see count_approximate)
+	 */
+	vector<ulint> error_lower_bounds(const vector<char_type>& P) const {
 
-		//position in F where c has to be inserted
-		ulint pos_in_F;
+		vector<ulint> D(P.size()+1,0);
 
-		//are we inserting a new character?
-		if(alphabet.find(c)==alphabet.end()){
+		for(ulint j=1;j<=P.size();++j){
 
-			//iterator to character immediately after c (in lex order)
-			//or alphabet.end() if c is bigger than all a in alphabet
-			auto upit = alphabet.upper_bound(c);
+			//longest suffix of P[0,...,j-1] that occurs
+			pair<ulint,ulint> rn = get_full_interval();
+			ulint len = 0;
 
-			pos_in_F = 	upit==alphabet.end() ?
-								F.size() :
-								F.select(0,*upit);
+			while(len < j){
 
-			alphabet.insert(c);
+				auto next = LF(rn, P[j-1-len]);
 
-		}else{
+				if(next.first >= next.second) break;
 
-			//number of cs before terminator in L
-			pos_in_F = 	F.select(0,c);
+				rn = next;
+				++len;
+
+			}
+
+			D[j] = len == j ? 0 : 1 + D[j-1-len];
 
 		}
 
-		F.insert(pos_in_F,c,k);
+		return D;
 
 	}
 
 	/*
-	 * First and last BWT matrix columns (L=BWT). Note that these strings
-	 * contain all but the terminator characters
+	 * the search node: P[0,...,j-1] is left, rn is the interval of the text
+	 * string matched so far (started: not empty), with e errors
 	 */
-	rle_string_type F;
+	void approximate_search(	const vector<char_type>& P, ulint j, pair<ulint,ulint> rn, ulint e, ulint k,
+								bool edits, bool started, const vector<ulint>& D, vector<approximate_match>& res) const {
+
+		if(e + D[j] > k) return;
+
+		if(j == 0 and started) res.push_back({rn,e});
+
+		if(j == 0 and not (edits and started and e < k)) return;
+
+		//deletion of P[j-1]
+		if(edits and j > 0 and e < k) approximate_search(P, j-1, rn, e+1, k, edits, started, D, res);
+
+		for(auto child : LF_all(rn)){
+
+			if(j > 0){
+
+				bool match = child.first == P[j-1];
+
+				if(match or e < k) approximate_search(P, j-1, child.second, match ? e : e+1, k, edits, true, D, res);
+
+			}
+
+			//insertion of the text character
+			if(edits and started and e < k) approximate_search(P, j, child.second, e+1, k, edits, true, D, res);
+
+		}
+
+	}
+
+	/*
+	 * rank(l,c) and rank(r,c) of all characters c in s[l,...,r-1] (see
+	 * LF_all). Generic version: one rank query per character of the alphabet
+	 */
+	template<class string_type>
+	vector<std::tuple<char_type,ulint,ulint> > rank_all(const string_type& s, ulint l, ulint r) const {
+
+		vector<std::tuple<char_type,ulint,ulint> > res;
+
+		for(auto c : C.alphabet()){
+
+			ulint rl = s.rank(l,c);
+			ulint rr = s.rank(r,c);
+
+			if(rr > rl) res.push_back(std::make_tuple(c,rl,rr));
+
+		}
+
+		return res;
+
+	}
+
+	template<class bv_type>
+	vector<std::tuple<char_type,ulint,ulint> > rank_all(const wt_string<bv_type>& s, ulint l, ulint r) const {
+
+		return s.rank_all(l,r);
+
+	}
+
+	template<class bv_type, class string_type>
+	vector<std::tuple<char_type,ulint,ulint> > rank_all(const rle_string<bv_type,string_type>& s, ulint l, ulint r) const {
+
+		return s.rank_all(l,r);
+
+	}
+
+	/*
+	 * interval of X = X[0,...,j-1] with the k-mer table, as returned by
+	 * backward search: {0,0} if the interval of X[1,...,j-1] is empty or
+	 * X[0] is not in the text (see LF(interval,c))
+	 */
+	pair<ulint,ulint> kmer_interval(const char_type* X, ulint j) const {
+
+		if(not C.contains(X[0])) return {0,0};
+
+		auto rn = K.lookup(X, j);
+
+		if(rn.first == rn.second and j > 1){
+
+			auto tail = K.lookup(X+1, j-1);
+
+			if(tail.first == tail.second) return {0,0};
+
+		}
+
+		return rn;
+
+	}
+
+	/*
+	 * patch the k-mer table with the new suffix cW. The table is dropped
+	 * if c is not in its alphabet
+	 */
+	void extend_kmer_table(char_type c){
+
+		if(K.enabled() and not K.extend(c)) K = kmer_table();
+
+	}
+
+	//characters read/appended at a time by merge
+	static constexpr ulint MERGE_CHUNK = 1<<16;
+
+	/*
+	 * sequential reads of a string, MERGE_CHUNK characters at a time
+	 */
+	class string_reader{
+
+	public:
+
+		string_reader(const dynamic_string_type& s) : s(s) {}
+
+		char_type next(){
+
+			if(pos == buf.size()){
+
+				buf.clear();
+				pos = 0;
+
+				ulint len = std::min(MERGE_CHUNK, s.size()-i);
+				read(s,i,len,buf);
+				i += len;
+
+			}
+
+			return buf[pos++];
+
+		}
+
+	private:
+
+		const dynamic_string_type& s;
+		ulint i = 0;
+
+		vector<char_type> buf;
+		ulint pos = 0;
+
+	};
+
+	/*
+	 * append s[i,...,i+len-1] to out. Generic version: one access per character
+	 */
+	template<class string_type>
+	static void read(const string_type& s, ulint i, ulint len, vector<char_type>& out){
+
+		for(ulint k=i;k<i+len;++k) out.push_back(s.at(k));
+
+	}
+
+	template<class bv_type>
+	static void read(const wt_string<bv_type>& s, ulint i, ulint len, vector<char_type>& out){
+
+		s.extract(i,len,std::back_inserter(out));
+
+	}
+
+	//one access per run
+	template<class bv_type, class string_type>
+	static void read(const rle_string<bv_type,string_type>& s, ulint i, ulint len, vector<char_type>& out){
+
+		while(len>0){
+
+			ulint k = std::min(s.locate_run(i).second - i, len);
+
+			out.insert(out.end(), k, s.at(i));
+
+			i += k;
+			len -= k;
+
+		}
+
+	}
+
+	/*
+	 * append the characters of buf at the end of s. Generic version: one insert per character
+	 */
+	template<class string_type>
+	static void append(string_type& s, const vector<char_type>& buf){
+
+		for(auto c : buf) s.push_back(c);
+
+	}
+
+	template<class bv_type>
+	static void append(wt_string<bv_type>& s, const vector<char_type>& buf){
+
+		s.insert_range(s.size(), buf.begin(), buf.end());
+
+	}
+
+	template<class bv_type, class string_type>
+	static void append(rle_string<bv_type,string_type>& s, const vector<char_type>& buf){
+
+		vector<pair<char_type,ulint> > R;
+
+		for(auto c : buf){
+
+			if(R.size() > 0 and R.back().first == c) R.back().second++;
+			else R.push_back({c,1});
+
+		}
+
+		s.append_runs(R.begin(),R.end());
+
+	}
+
+	/*
+	 * C array (first BWT matrix column) and last column (L=BWT). Note that
+	 * these contain all but the terminator characters
+	 */
+	c_array_type C;
 	dynamic_string_type L;
 
 	//TERMINATOR character: we reserve the integer 2^64-1
 	static const char_type TERMINATOR = ~ulint(0);
 
-	//stores the alphabet. Useful to infer lexicographic order
-	//of new incoming characters in log sigma time. TERMINATOR is not
-	//here.
-	set<char_type> alphabet;
-
 	//terminator is not actually stored in the BWT: we just remember
 	//its position
 	ulint terminator_position=0;
 
+	//optional k-mer table (see build_kmer_table)
+	kmer_table K;
+
 };
 
 
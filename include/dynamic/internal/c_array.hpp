@@ -0,0 +1,209 @@
+// Copyright (c) 2017, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * c_array.hpp
+ *
+ *  Dynamic C array of a BWT: for each character c, the number of characters
+ *  smaller than c in the text. This replaces the first BWT column F, which
+ *  is just the text characters sorted.
+ *
+ *  The alphabet is kept sorted in a vector, so that the dense rank of a
+ *  character (its index in the alphabet) is found by binary search. The
+ *  number of occurrences of each character is stored, by dense rank, in a
+ *  searchable partial sum (spsi): C[c] is a prefix sum, F[i] a search.
+ *  New characters are inserted at their rank in both.
+ *
+ *  Serialized format: alphabet size s, then s pairs <character, count> by
+ *  increasing character (64 bits each).
+ *
+ */
+
+#ifndef INTERNAL_C_ARRAY_HPP_
+#define INTERNAL_C_ARRAY_HPP_
+
+#include "dynamic/internal/includes.hpp"
+
+namespace dyn {
+
+/*
+ * true iff T has the interface of a C array (see bwt)
+ */
+template <class T, class = void>
+struct is_c_array : std::false_type {};
+
+template <class T>
+struct is_c_array<T, std::void_t<decltype(std::declval<const T&>().C(0)),
+		decltype(std::declval<T&>().increment(0))> > : std::true_type {};
+
+template <class spsi_type>
+class c_array {
+
+public:
+
+	typedef uint64_t char_type;
+
+	/*
+	 * number of characters (with multiplicity)
+	 */
+	ulint size() const {
+
+		return counts.psum();
+
+	}
+
+	/*
+	 * number of distinct characters
+	 */
+	ulint sigma() const {
+
+		return chars.size();
+
+	}
+
+	bool contains(char_type c) const {
+
+		auto it = std::lower_bound(chars.begin(), chars.end(), c);
+
+		return it != chars.end() and *it == c;
+
+	}
+
+	/*
+	 * number of characters smaller than c (c need not be in the alphabet)
+	 */
+	ulint C(char_type c) const {
+
+		ulint r = rank(c);
+
+		return r == 0 ? 0 : counts.psum(r - 1);
+
+	}
+
+	/*
+	 * number of occurrences of c
+	 */
+	ulint count(char_type c) const {
+
+		return contains(c) ? counts.at(rank(c)) : 0;
+
+	}
+
+	/*
+	 * i-th character of the sorted text (i.e. F[i])
+	 */
+	char_type at(ulint i) const {
+
+		assert(i < size());
+
+		return chars[counts.search(i + 1)];
+
+	}
+
+	char_type operator[](ulint i) const {
+
+		return at(i);
+
+	}
+
+	/*
+	 * add k occurrences of c. New characters are inserted in the alphabet
+	 */
+	void increment(char_type c, ulint k = 1) {
+
+		ulint r = rank(c);
+
+		if(r < chars.size() and chars[r] == c){
+
+			counts.increment(r, k);
+
+		}else{
+
+			chars.insert(chars.begin() + r, c);
+			counts.insert(r, k);
+
+		}
+
+	}
+
+	/*
+	 * sorted alphabet
+	 */
+	const vector<char_type>& alphabet() const {
+
+		return chars;
+
+	}
+
+	ulint bit_size() const {
+
+		return sizeof(c_array<spsi_type>) * 8 + chars.capacity() * sizeof(char_type) * 8 + counts.bit_size();
+
+	}
+
+	ulint serialize(ostream &out) const {
+
+		ulint w_bytes = 0;
+		ulint s = chars.size();
+
+		out.write((char*)&s, sizeof(s));
+		w_bytes += sizeof(s);
+
+		for(ulint r = 0; r < s; ++r){
+
+			ulint k = counts.at(r);
+
+			out.write((char*)&chars[r], sizeof(char_type));
+			out.write((char*)&k, sizeof(k));
+			w_bytes += sizeof(char_type) + sizeof(k);
+
+		}
+
+		return w_bytes;
+
+	}
+
+	void load(istream &in){
+
+		ulint s;
+		in.read((char*)&s, sizeof(s));
+
+		chars = vector<char_type>(s);
+		counts = spsi_type();
+
+		for(ulint r = 0; r < s; ++r){
+
+			ulint k;
+
+			in.read((char*)&chars[r], sizeof(char_type));
+			in.read((char*)&k, sizeof(k));
+
+			counts.push_back(k);
+
+		}
+
+	}
+
+private:
+
+	/*
+	 * dense rank of c: number of alphabet characters smaller than c
+	 */
+	ulint rank(char_type c) const {
+
+		return std::lower_bound(chars.begin(), chars.end(), c) - chars.begin();
+
+	}
+
+	//sorted alphabet
+	vector<char_type> chars;
+
+	//counts[r] = number of occurrences of chars[r]
+	spsi_type counts;
+
+};
+
+}
+
+#endif /* INTERNAL_C_ARRAY_HPP_ */
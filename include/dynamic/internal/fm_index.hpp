@@ -8,12 +8,24 @@
  *  Created on: Jan 15, 2016
  *      Author: nico
  *
- *  Dynamic FM-index. Supports LF mapping, backward search, locate, left-extend text
+ *  Dynamic FM-index. Supports LF mapping, backward search, locate, extract, left-extend text
  *
  *  Note that positions are enumerated from the end, where BWT terminator has
  *  position 0. e.g. in T = "abcd#", T[0] = # (where # is the BWT terminator)
  *  Note: alphabet character 2^64-1 is reserved for the BWT terminator
  *
+ *  ISA samples (optional, see dyn_isa) are the SA sample values again, in the
+ *  order of the marked rows, in a string supporting range queries on values.
+ *  Rows shift at each extend while values do not, so the rows of the samples
+ *  are found with select instead of being stored. The copy doubles the sample
+ *  space and adds one insert per sampled extend. With 10^6 extends (sigma = 4):
+ *
+ *    rle_fmi, repetitive text, rate 256:  82 KB ->  128 KB, ingest +1%
+ *    rle_fmi, repetitive text, rate 32:  216 KB ->  508 KB, ingest +4%
+ *    wt_fmi, random text, rate 256:      415 KB ->  461 KB, ingest within noise
+ *    wt_fmi, random text, rate 32:       496 KB ->  788 KB, ingest +4%
+ *
+ *  so they are kept only by the *_extract_fmi types (see dynamic.hpp).
  *
  */
 
@@ -22,9 +34,21 @@
 
 #include "dynamic/internal/includes.hpp"
 
-template <	class dyn_bwt,	//dynamic BWT
-			class dyn_bv,	//dynamic bitvector
-			class dyn_vec	//dynamic vector
+/*
+ * sampling policy tag: fm_index<dyn_bwt, no_sampling, no_sampling> keeps no
+ * SA samples. It supports count and LF (and extend/merge), but not locate
+ * and extract.
+ *
+ * The ISA samples (dyn_isa) are optional as well: the default no_sampling
+ * keeps the index and its serialized format as without extract. They are
+ * needed by extract and by adaptive sampling.
+ */
+struct no_sampling {};
+
+template <	class dyn_bwt,					//dynamic BWT
+			class dyn_bv,					//dynamic bitvector
+			class dyn_vec,					//dynamic vector
+			class dyn_isa = no_sampling		//dynamic string with range_count/range_quantile (e.g. wm_string)
 		>
 class fm_index : public dyn_bwt{
 
@@ -33,6 +57,15 @@ public:
 	//we allow any alphabet
 	using char_type = ulint;
 
+	//false if the index keeps no samples (see no_sampling)
+	static constexpr bool sampled = not std::is_same<dyn_bv,no_sampling>::value;
+
+	//true if the index keeps ISA samples (extract, adaptive sampling)
+	static constexpr bool has_isa = not std::is_same<dyn_isa,no_sampling>::value;
+
+	static_assert(	sampled or (std::is_same<dyn_vec,no_sampling>::value and not has_isa),
+					"no_sampling must be used for all samples");
+
 	/*
 	 * Constructor #1
 	 *
@@ -42,8 +75,15 @@ public:
 	 */
 	fm_index(){
 
-		marked.insert(0,true);
-		SA.insert(0,0);
+		if constexpr (sampled){
+
+			marked.insert(0,true);
+			SA.insert(0,0);
+
+		}
+
+		if constexpr (has_isa) ISA.insert(0,0);
+
 		this->sample_rate = DEFAULT_SA_RATE;
 
 	}
@@ -58,8 +98,15 @@ public:
 	 */
 	fm_index(uint64_t sigma, ulint sample_rate = DEFAULT_SA_RATE) : dyn_bwt(sigma){
 
-		marked.insert(0,true);
-		SA.insert(0,0);
+		if constexpr (sampled){
+
+			marked.insert(0,true);
+			SA.insert(0,0);
+
+		}
+
+		if constexpr (has_isa) ISA.insert(0,0);
+
 		this->sample_rate = sample_rate;
 
 	}
@@ -75,8 +122,15 @@ public:
 	 */
 	fm_index(vector<pair<char_type,double> >& P, ulint sample_rate = DEFAULT_SA_RATE) : dyn_bwt(P){
 
-		marked.insert(0,true);
-		SA.insert(0,0);
+		if constexpr (sampled){
+
+			marked.insert(0,true);
+			SA.insert(0,0);
+
+		}
+
+		if constexpr (has_isa) ISA.insert(0,0);
+
 		this->sample_rate = sample_rate;
 
 	}
@@ -120,6 +174,272 @@ public:
 
 	}
 
+	/*
+	 * approximate occurrences of P: pairs <text position, errors> of the
+	 * strings of the text at Hamming distance (edits = false) or edit
+	 * distance (edits = true) at most k from P (see bwt::count_approximate),
+	 * by increasing position. With edits, strings of different lengths can
+	 * start at the same position: the smallest distance is reported.
+	 */
+	vector<pair<ulint,ulint> > locate_approximate(const vector<char_type>& P, ulint k, bool edits = false) const {
+
+		vector<pair<ulint,ulint> > res;
+
+		for(auto m : dyn_bwt::count_approximate(P, k, edits))
+			for(auto i : locate(m.range)) res.push_back({i,m.errors});
+
+		std::sort(res.begin(),res.end());
+
+		res.erase(std::unique(res.begin(),res.end(),[](const pair<ulint,ulint>& a, const pair<ulint,ulint>& b){
+
+			return a.first == b.first;
+
+		}),res.end());
+
+		return res;
+
+	}
+
+	/*
+	 * locate(P) for each pattern P of a batch. If stats is not NULL, it is
+	 * filled with the statistics of the batch (see bwt::count_many).
+	 *
+	 * The intervals are computed with count_many; patterns with the same
+	 * interval (e.g. duplicates) are located once. Distinct intervals are
+	 * located in parallel (OpenMP). A pattern is answered when its interval
+	 * is located.
+	 */
+	vector<vector<ulint> > locate_many(const vector<vector<char_type> >& patterns, typename dyn_bwt::query_stats* stats = NULL) const {
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		auto ranges = dyn_bwt::count_many(patterns, stats);
+
+		//patterns sorted by interval: the first of each group is located
+		vector<ulint> order(patterns.size());
+		for(ulint i=0;i<order.size();++i) order[i] = i;
+
+		std::sort(order.begin(),order.end(),[&](ulint a, ulint b){ return ranges[a] < ranges[b]; });
+
+		vector<ulint> first;	//positions in order where a new interval starts
+
+		for(ulint i=0;i<order.size();++i)
+			if(i==0 or ranges[order[i]] != ranges[order[i-1]]) first.push_back(i);
+
+		vector<vector<ulint> > res(patterns.size());
+		vector<double> done(first.size());
+
+		#pragma omp parallel for schedule(dynamic,1)
+		for(ulint g=0;g<first.size();++g){
+
+			res[order[first[g]]] = locate(ranges[order[first[g]]]);
+			done[g] = std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+
+		}
+
+		for(ulint g=0;g<first.size();++g){
+
+			ulint end = g+1 < first.size() ? first[g+1] : order.size();
+
+			for(ulint i=first[g];i<end;++i){
+
+				if(i > first[g]) res[order[i]] = res[order[first[g]]];
+				if(stats != NULL) stats->latency[order[i]] = done[g];
+
+			}
+
+		}
+
+		if(stats != NULL)
+			stats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+
+		return res;
+
+	}
+
+	/*
+	 * adaptive sampling. locate_adaptive is locate that learns where locates
+	 * are hot: when the LF walk from row i to a sample takes at least min_walk
+	 * steps, an extra SA sample is added at row i, so the next locate of i
+	 * (e.g. an occurrence of a frequent pattern) takes no step. At most budget
+	 * extra samples are kept: the least recently used one (a sample is used
+	 * when a walk ends on it) is evicted. Each extra sample takes about
+	 * 2 log n bits in SA/ISA and one entry in the LRU maps.
+	 *
+	 * Extra samples are ordinary samples: they shift with extend and merge
+	 * and are used by locate and extract. budget = 0 (default) disables
+	 * adaptive sampling; lowering the budget evicts samples. locate_adaptive
+	 * modifies the index: unlike locate, it must not be called concurrently.
+	 *
+	 * Adaptive sampling is not serialized: serialize writes the regular
+	 * samples only (the extra ones are dropped from a copy of the samples),
+	 * and a loaded index has adaptive sampling disabled until
+	 * set_adaptive_sampling is called again.
+	 */
+	void set_adaptive_sampling(ulint budget, ulint min_walk = HOT_MIN_WALK){
+
+		static_assert(has_isa, "adaptive sampling needs ISA samples, to find the rows of evicted samples");
+
+		assert(min_walk > 0);
+
+		hot_budget = budget;
+		hot_min_walk = min_walk;
+
+		while(hot_tick.size() > hot_budget) evict_hot();
+
+	}
+
+	/*
+	 * number of extra samples currently kept by adaptive sampling
+	 */
+	ulint number_of_hot_samples() const {
+
+		return hot_tick.size();
+
+	}
+
+	/*
+	 * number of SA samples, extra samples included
+	 */
+	ulint number_of_samples() const {
+
+		static_assert(sampled, "no SA samples (no_sampling)");
+
+		return SA.size();
+
+	}
+
+	/*
+	 * as locate(i), with adaptive sampling (see set_adaptive_sampling)
+	 */
+	ulint locate_adaptive(ulint i){
+
+		static_assert(has_isa, "adaptive sampling needs ISA samples, to find the rows of evicted samples");
+
+		ulint r = i;
+		ulint d = 0;	//LF steps: SA[i] = SA[r] + d
+
+		while(not marked.at(r)){
+
+			r = this->FL(r);
+			++d;
+
+		}
+
+		ulint v = SA.at(marked.rank1(r)) + d;
+
+		touch_hot(v-d);
+
+		if(d >= hot_min_walk and hot_budget > 0) add_hot_sample(i,v);
+
+		return v;
+
+	}
+
+	vector<ulint> locate_adaptive(pair<ulint,ulint> range){
+
+		auto res = vector<ulint>();
+
+		for(ulint i=range.first;i<range.second;++i) res.push_back(locate_adaptive(i));
+
+		return res;
+
+	}
+
+	vector<ulint> locate_adaptive(vector<char_type> P){
+
+		return locate_adaptive(dyn_bwt::count(P));
+
+	}
+
+	/*
+	 * input: text position i and a length len <= i
+	 * output: the len characters at text positions i, i-1, ..., i-len+1, i.e.
+	 * the substring of the text ending at position i-len+1, in text order.
+	 *
+	 * We jump to the nearest ISA sample: either the largest sample p <= i-len,
+	 * from which LF walks forward in the text (L[r] is the character at
+	 * position SA[r]+1), or the smallest sample s >= i, from which FL walks
+	 * backward (F[r] is the character at position SA[r]).
+	 */
+	vector<char_type> extract(ulint i, ulint len) const {
+
+		static_assert(has_isa, "extract needs ISA samples (dyn_isa)");
+
+		assert(i <= this->text_length());
+		assert(len <= i);
+
+		vector<char_type> res;
+		res.reserve(len);
+
+		if(len == 0) return res;
+
+		ulint u = i-len;
+		ulint S = ISA.size();
+
+		//samples <= u (the sample 0 is always there) and samples < i
+		ulint k = ISA.range_count(0,S,0,u);
+		ulint h = ISA.range_count(0,S,0,i-1);
+
+		ulint p = ISA.range_quantile(0,S,k-1);
+		ulint s = h < S ? ISA.range_quantile(0,S,h) : p;
+
+		if(h < S and s - i < u - p){
+
+			ulint r = sample_row(s);
+
+			for(ulint j=s;j>i;--j) r = this->FL(r);
+
+			for(ulint j=0;j<len;++j){
+
+				res.push_back(this->F(r));
+				r = this->FL(r);
+
+			}
+
+			return res;
+
+		}
+
+		ulint r = sample_row(p);
+
+		for(ulint j=p;j<u;++j) r = this->LF(r);
+
+		for(ulint j=0;j<len;++j){
+
+			res.push_back(this->at(r));
+			r = this->LF(r);
+
+		}
+
+		std::reverse(res.begin(),res.end());
+
+		return res;
+
+	}
+
+	/*
+	 * stream the whole text (without terminator) in text order: out(c) is
+	 * called for each character. The text is inverted in blocks of
+	 * EXTRACT_BLOCK characters with extract, so only one block is kept in memory.
+	 */
+	template<class out_type>
+	void extract_all(out_type out) const {
+
+		ulint i = this->text_length();
+
+		while(i > 0){
+
+			ulint len = std::min(i, EXTRACT_BLOCK);
+
+			for(auto c : extract(i,len)) out(c);
+
+			i -= len;
+
+		}
+
+	}
+
 	/*
 	 * build FM index of cW from FM index of W
 	 */
@@ -127,20 +447,149 @@ public:
 
 		dyn_bwt::extend(c);	//extend BWT
 
-		/*
-		 * position of new suffix in the BWT
-		 * matrix (row number)
-		 */
-		auto tp = this->get_terminator_position();
+		if constexpr (sampled){
+
+			/*
+			 * position of new suffix in the BWT
+			 * matrix (row number)
+			 */
+			auto tp = this->get_terminator_position();
 
-		if(this->text_length() % sample_rate == 0){
+			if(this->text_length() % sample_rate == 0){
 
-			marked.insert(tp,true);					//mark position with 1
-			SA.insert(marked.rank1(tp),this->text_length());	//insert SA sample
+				marked.insert(tp,true);					//mark position with 1
+				ulint r = marked.rank1(tp);
+				SA.insert(r,this->text_length());	//insert SA sample
+
+				if constexpr (has_isa) ISA.insert(r,this->text_length());	//and its ISA sample
+
+			}else{
+
+				marked.insert(tp,false);				//mark position with 0
+
+			}
+
+		}
+
+	}
+
+	/*
+	 * build FM index of sW from FM index of W, where s = s[0,...,len-1].
+	 * Same as extend(s[len-1]), extend(s[len-2]), ..., extend(s[0]).
+	 *
+	 * The BWT is extended in batch (see bwt::extend). New SA samples are
+	 * kept aside together with their rank among the marked positions, which
+	 * is shifted by the samples inserted before them; they are inserted in
+	 * SA sorted by rank when there are SA_BATCH of them and at the end
+	 */
+	void extend(const char_type* s, size_t len){
+
+		if constexpr (not sampled){
+
+			dyn_bwt::extend(s, len);
+
+		}else{
+
+			vector<pair<ulint,ulint> > samples;	//<rank in marked, SA value>
+
+			dyn_bwt::extend(s, len, [&](ulint tp){
+
+				if(this->text_length() % sample_rate == 0){
+
+					marked.insert(tp,true);
+
+					ulint r = marked.rank1(tp);
+
+					for(auto& p : samples) if(p.first >= r) p.first++;
+
+					samples.push_back({r,this->text_length()});
+
+					if(samples.size() == SA_BATCH) insert_samples(samples);
+
+				}else{
+
+					marked.insert(tp,false);
+
+				}
+
+			});
+
+			insert_samples(samples);
+
+		}
+
+	}
+
+	/*
+	 * merge: given the FM index of V (other) and this FM index of W, this
+	 * becomes the FM index of V sep W. sep must be smaller than all characters
+	 * of V (see bwt::merge).
+	 *
+	 * The rows of other are inserted in marked at their merged positions, by
+	 * increasing position, and its SA samples in SA at their rank: samples of
+	 * other are shifted by |W|+1 (text positions are enumerated from the end),
+	 * samples of this index do not change. The sample rate and the adaptive
+	 * sampling budget of this index are kept.
+	 */
+	void merge(const fm_index& other, char_type sep){
+
+		assert(&other != this);
+
+		if constexpr (not sampled){
+
+			dyn_bwt::merge(other, sep);
 
 		}else{
 
-			marked.insert(tp,false);				//mark position with 0
+			auto P = dyn_bwt::merge_positions(other, sep);
+
+			ulint shift = this->text_length()+1;
+
+			//marked rows of other are found with select
+			ulint other_samples = other.SA.size();
+			ulint k = 0;
+			ulint next_marked = other.marked.select1(0);
+
+			for(ulint j=0;j<P.size();++j){
+
+				ulint row = j + P[j];
+
+				if(j == next_marked){
+
+					marked.insert(row,true);
+					ulint r = marked.rank1(row);
+
+					SA.insert(r,other.SA.at(k) + shift);
+
+					if constexpr (has_isa) ISA.insert(r,other.SA.at(k) + shift);
+
+					++k;
+					next_marked = k < other_samples ? other.marked.select1(k) : P.size();
+
+				}else{
+
+					marked.insert(row,false);
+
+				}
+
+			}
+
+			dyn_bwt::merge_with(other, sep, P);
+
+			if constexpr (has_isa){
+
+				//extra samples of other stay extra samples, less recent than ours
+				auto ours = hot_by_tick;
+
+				hot_by_tick.clear();
+				hot_tick.clear();
+
+				for(auto e : other.hot_by_tick) add_hot_value(e.second + shift);
+				for(auto e : ours) add_hot_value(e.second);
+
+				while(hot_tick.size() > hot_budget) evict_hot();
+
+			}
 
 		}
 
@@ -157,11 +606,25 @@ public:
 	 */
 	ulint bit_size() const {
 
-		ulint size = sizeof(fm_index<dyn_bwt,dyn_bv,dyn_vec>)*8;
+		ulint size = sizeof(fm_index<dyn_bwt,dyn_bv,dyn_vec,dyn_isa>)*8;
 
 		size += dyn_bwt::bit_size();
-		size += marked.bit_size();
-		size += SA.bit_size();
+
+		if constexpr (sampled){
+
+			size += marked.bit_size();
+			size += SA.bit_size();
+
+		}
+
+		if constexpr (has_isa){
+
+			size += ISA.bit_size();
+
+			//LRU of the extra samples: about 3 words per sample in each map
+			size += hot_tick.size()*6*sizeof(ulint)*8;
+
+		}
 
 		return size;
 
@@ -176,8 +639,35 @@ public:
 		out.write((char*)&sample_rate,sizeof(sample_rate));
 		w_bytes += sizeof(sample_rate);
 
-		w_bytes += marked.serialize(out);
-		w_bytes += SA.serialize(out);
+		//the extra samples of adaptive sampling are not serialized (see set_adaptive_sampling)
+		if constexpr (has_isa){
+
+			if(not hot_tick.empty()){
+
+				dyn_bv m(marked);
+				dyn_vec sa(SA);
+				dyn_isa isa(ISA);
+
+				for(auto e : hot_tick) remove_sample(m,sa,isa,e.first);
+
+				w_bytes += m.serialize(out);
+				w_bytes += sa.serialize(out);
+				w_bytes += isa.serialize(out);
+
+				return w_bytes;
+
+			}
+
+		}
+
+		if constexpr (sampled){
+
+			w_bytes += marked.serialize(out);
+			w_bytes += SA.serialize(out);
+
+		}
+
+		if constexpr (has_isa) w_bytes += ISA.serialize(out);
 
 		return w_bytes;
 
@@ -189,8 +679,23 @@ public:
 
 		in.read((char*)&sample_rate,sizeof(sample_rate));
 
-		marked.load(in);
-		SA.load(in);
+		if constexpr (sampled){
+
+			marked.load(in);
+			SA.load(in);
+
+		}
+
+		if constexpr (has_isa){
+
+			ISA.load(in);
+
+			hot_budget = 0;
+			hot_min_walk = HOT_MIN_WALK;
+			hot_by_tick.clear();
+			hot_tick.clear();
+
+		}
 
 	}
 
@@ -201,19 +706,155 @@ private:
 	 */
 	ulint locate(ulint i, ulint j) const{
 
+		static_assert(sampled, "locate needs SA samples");
+
 		return 	marked.at(i) ?
             SA.at(marked.rank1(i)) + j :
             locate( this->FL(i), j+1 );
 
 	}
 
+	/*
+	 * BWT row of the SA sample with value v (v must be sampled)
+	 */
+	ulint sample_row(ulint v) const {
+
+		return marked.select1(ISA.select(1,v)-1);
+
+	}
+
+	/*
+	 * insert the SA samples <rank, value>. Ranks are final (i.e. they count
+	 * all the samples), so inserting by increasing rank puts each sample
+	 * at its rank. Empties the vector
+	 */
+	void insert_samples(vector<pair<ulint,ulint> >& samples){
+
+		std::sort(samples.begin(),samples.end());
+
+		for(auto p : samples){
+
+			SA.insert(p.first,p.second);
+
+			if constexpr (has_isa) ISA.insert(p.first,p.second);
+
+		}
+
+		samples.clear();
+
+	}
+
+	/*
+	 * add an extra SA sample with value v at row i (not marked), as the most
+	 * recently used. Evicts the least recently used one if over budget
+	 */
+	void add_hot_sample(ulint i, ulint v){
+
+		marked.remove(i);
+		marked.insert(i,true);
+
+		ulint r = marked.rank1(i);
+
+		SA.insert(r,v);
+		ISA.insert(r,v);
+
+		add_hot_value(v);
+
+		while(hot_tick.size() > hot_budget) evict_hot();
+
+	}
+
+	/*
+	 * record v as an extra sample, the most recently used
+	 */
+	void add_hot_value(ulint v){
+
+		hot_tick[v] = ++hot_clock;
+		hot_by_tick[hot_clock] = v;
+
+	}
+
+	/*
+	 * a walk ended on the sample v: if it is an extra sample, it becomes the
+	 * most recently used
+	 */
+	void touch_hot(ulint v){
+
+		auto it = hot_tick.find(v);
+
+		if(it == hot_tick.end()) return;
+
+		hot_by_tick.erase(it->second);
+		add_hot_value(v);
+
+	}
+
+	/*
+	 * remove the least recently used extra sample from marked, SA and ISA
+	 */
+	void evict_hot(){
+
+		assert(not hot_by_tick.empty());
+
+		ulint v = hot_by_tick.begin()->second;
+
+		hot_by_tick.erase(hot_by_tick.begin());
+		hot_tick.erase(v);
+
+		remove_sample(marked,SA,ISA,v);
+
+	}
+
+	/*
+	 * remove the SA sample with value v from marked, SA and ISA
+	 */
+	static void remove_sample(dyn_bv& marked, dyn_vec& SA, dyn_isa& ISA, ulint v){
+
+		ulint r = ISA.select(1,v)-1;
+		ulint i = marked.select1(r);
+
+		SA.remove(r);
+		ISA.remove(r);
+
+		marked.remove(i);
+		marked.insert(i,false);
+
+	}
+
 	dyn_bv marked;	//is position i marked with a SA sample?
 	dyn_vec SA;		//suffix array sampling
 
+	/*
+	 * inverse suffix array sampling: the SA samples again, in the same order,
+	 * in a string supporting range queries on values. The sample of value v
+	 * is the (ISA.select(1,v)-1)-th marked row; rows shift when the text is
+	 * extended, so rows are not stored.
+	 */
+	dyn_isa ISA;
+
 	ulint sample_rate;	//one SA sample out of sample_rate positions
 
+	/*
+	 * adaptive sampling (see set_adaptive_sampling): the extra SA samples, by
+	 * value, with the tick of their last use, and by tick
+	 */
+	ulint hot_budget = 0;
+	ulint hot_min_walk = HOT_MIN_WALK;
+	ulint hot_clock = 0;
+	tsl::hopscotch_map<ulint,ulint> hot_tick;
+	map<ulint,ulint> hot_by_tick;
+
 	static const ulint DEFAULT_SA_RATE = 256;
 
+	//default min number of LF steps of a walk to add an extra sample
+	static const ulint HOT_MIN_WALK = 16;
+
+	//max number of SA samples kept aside by extend(s,len)
+	static const ulint SA_BATCH = 256;
+
+	//characters per block of extract_all
+	static constexpr ulint EXTRACT_BLOCK = 1<<16;
+
 };
 
 
@@ -167,12 +167,183 @@ namespace dyn{
 
       }
 
+      /*
+       * position of the first bit set at position >= i, or size() if there is none
+       */
+      uint64_t next1(uint64_t i) const {
+
+	 if(i >= size()) return size();
+
+	 uint64_t r = rank1(i);
+	 return r == rank1() ? size() : select1(r);
+
+      }
+
+      /*
+       * position of the last bit set at position <= i, or size() if there is none
+       */
+      uint64_t prev1(uint64_t i) const {
+
+	 assert(i<size());
+
+	 uint64_t r = rank1(i+1);
+	 return r == 0 ? size() : select1(r-1);
+
+      }
+
+      /*
+       * position of the first bit not set at position >= i, or size() if there is none
+       */
+      uint64_t next0(uint64_t i) const {
+
+	 if(i >= size()) return size();
+
+	 uint64_t r = rank1(i);
+
+	 //i is not the r-th bit set
+	 if(r == rank1() or select1(r) != i) return i;
+
+	 //the run of ones starting in i ends before the first nonzero gap after the r-th one
+	 uint64_t k = spsi_.next1(r+1);
+
+	 return k == spsi_.size() ? size() : select1(k-1)+1;
+
+      }
+
+      /*
+       * call f(j) for each bit set at position l <= j < r, by increasing j.
+       * O(log n) plus amortized O(1) per bit set (see ones_iterator)
+       */
+      template<class F>
+      void for_each_one(uint64_t l, uint64_t r, F f) const {
+
+	 assert(r<=size());
+
+	 if(l >= r) return;
+
+	 auto end = ones_end();
+
+	 for(auto it = ones_from(rank1(l)); it != end and *it < r; ++it) f(*it);
+
+      }
+
       void push_back(bool b){
 
 	 insert(size(),b);
 
       }
 
+      /*
+       * append the runs 0^(k-1)1, for each run length k>0 in [first,last).
+       * Counters are appended in bulk to the underlying spsi (see spsi::push_many).
+       * Iterator must be a forward iterator
+       */
+      template<class Iterator>
+      void append_runs(Iterator first, Iterator last){
+
+	 if(first==last) return;
+
+	 //the first run extends the trailing zeros
+	 assert(*first>0);
+	 uint64_t k = *first++;
+
+	 if(k>1) spsi_.increment(spsi_.size()-1, k-1);
+
+	 size_ += k;
+	 bits_set_++;
+
+	 //next runs: one counter each, plus the (empty) trailing zeros
+	 uint64_t nr = std::distance(first, last);
+
+	 gap_iterator<Iterator> begin = {first};
+	 gap_iterator<Iterator> end = {last};
+
+	 spsi_.push_many(begin, end);
+	 spsi_.push_back(0);
+
+	 for(;first != last; ++first){
+	    assert(*first>0);
+	    size_ += *first;
+	 }
+
+	 bits_set_ += nr;
+
+      }
+
+      /*
+       * forward iterator over the positions of the bits set, in increasing
+       * order. Amortized O(1) per bit (see spsi::const_iterator).
+       * Invalidated by any modification of the bitvector
+       */
+      class ones_iterator{
+
+      public:
+
+	 typedef std::forward_iterator_tag iterator_category;
+	 typedef uint64_t value_type;
+	 typedef std::ptrdiff_t difference_type;
+	 typedef const uint64_t* pointer;
+	 typedef uint64_t reference;
+
+	 uint64_t operator*() const { return pos_; }
+
+	 ones_iterator& operator++(){
+
+	    assert(rank_ < end_);
+
+	    //the gap before the next bit set
+	    if(++rank_ < end_) pos_ += *(++it_) + 1;
+
+	    return *this;
+
+	 }
+
+	 ones_iterator operator++(int){ auto tmp = *this; ++*this; return tmp; }
+
+	 bool operator==(const ones_iterator& o) const { return rank_ == o.rank_; }
+	 bool operator!=(const ones_iterator& o) const { return rank_ != o.rank_; }
+
+	 /*
+	  * number of bits set before the current one
+	  */
+	 uint64_t rank() const { return rank_; }
+
+      private:
+
+	 friend class gap_bitvector;
+
+	 typename spsi_type::const_iterator it_;
+	 uint64_t pos_ = 0;
+	 uint64_t rank_ = 0;
+	 uint64_t end_ = 0;
+
+      };
+
+      /*
+       * iterator pointing to the j-th bit set (j = rank1() gives ones_end())
+       */
+      ones_iterator ones_from(uint64_t j) const {
+
+	 assert(j <= rank1());
+
+	 ones_iterator it;
+	 it.rank_ = j;
+	 it.end_ = rank1();
+
+	 if(j < it.end_){
+
+	    it.it_ = spsi_.iterator_at(j);
+	    it.pos_ = select1(j);
+
+	 }
+
+	 return it;
+
+      }
+
+      ones_iterator ones_begin() const { return ones_from(0); }
+      ones_iterator ones_end() const { return ones_from(rank1()); }
+
       void push_front(bool b){
 
 	 insert(0,b);
@@ -352,6 +523,28 @@ namespace dyn{
 
    private:
 
+      /*
+       * iterates over run lengths k and returns the gaps k-1
+       */
+      template<class Iterator>
+      struct gap_iterator{
+
+	 typedef std::forward_iterator_tag iterator_category;
+	 typedef uint64_t value_type;
+	 typedef std::ptrdiff_t difference_type;
+	 typedef const uint64_t* pointer;
+	 typedef uint64_t reference;
+
+	 uint64_t operator*() const { return *it - 1; }
+	 gap_iterator& operator++(){ ++it; return *this; }
+	 gap_iterator operator++(int){ auto tmp = *this; ++it; return tmp; }
+	 bool operator==(const gap_iterator& o) const { return it == o.it; }
+	 bool operator!=(const gap_iterator& o) const { return it != o.it; }
+
+	 Iterator it;
+
+      };
+
       /*
        * underlying SPSI
        *
@@ -19,11 +19,18 @@
 #include <set>
 #include <map>
 #include <vector>
+#include <tuple>
+#include <queue>
 #include <fstream>
 #include <sstream>
 #include <cassert>
 #include <cmath>
 #include <algorithm>
+#include <iterator>
+#include <chrono>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <tsl/hopscotch_map.h>
 
 #define WORD_SIZE 64;
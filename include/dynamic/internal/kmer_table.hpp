@@ -0,0 +1,237 @@
+// Copyright (c) 2017, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * kmer_table.hpp
+ *
+ *  BWT interval of every string of length <= k over a small alphabet (e.g.
+ *  DNA), to skip the first k steps of backward search.
+ *
+ *  A k-mer X is coded in base sigma by the dense ranks of its characters,
+ *  so codes are in lexicographic order. The rows of the BWT are: the
+ *  terminator suffix (row 0), the suffixes of length >= k, sorted by their
+ *  k-mer, and the k-1 shortest suffixes (of length < k), which are the end
+ *  of the text. The number of suffixes starting with each k-mer is stored
+ *  in a Fenwick tree, so the interval of X is a prefix sum plus the number
+ *  of short suffixes smaller than X, which are stored explicitly.
+ *
+ *  Left-extending the text adds one suffix: the table is patched with one
+ *  Fenwick update, i.e. all the intervals after the new suffix are
+ *  shifted at once.
+ *
+ */
+
+#ifndef INTERNAL_KMER_TABLE_HPP_
+#define INTERNAL_KMER_TABLE_HPP_
+
+#include "dynamic/internal/includes.hpp"
+
+namespace dyn {
+
+class kmer_table {
+
+public:
+
+	typedef uint64_t char_type;
+
+	/*
+	 * empty table (disabled)
+	 */
+	kmer_table(){}
+
+	/*
+	 * table of k-mers over the given alphabet, for the empty text. The text
+	 * must have less than 2^32 characters.
+	 */
+	kmer_table(vector<char_type> alphabet, ulint k) : chars(alphabet), k(k) {
+
+		assert(k > 0);
+
+		std::sort(chars.begin(), chars.end());
+		chars.erase(std::unique(chars.begin(), chars.end()), chars.end());
+
+		assert(chars.size() > 0);
+
+		ulint size = 1;
+		ulint sigma = chars.size();
+
+		for(ulint j = 0; j < k; ++j){
+
+			assert(size <= MAX_SIZE / sigma);
+			size *= sigma;
+
+		}
+
+		fenwick = vector<uint32_t>(size + 1, 0);
+
+	}
+
+	bool enabled() const {
+
+		return k > 0;
+
+	}
+
+	ulint length() const {
+
+		return k;
+
+	}
+
+	const vector<char_type>& alphabet() const {
+
+		return chars;
+
+	}
+
+	/*
+	 * add the suffix cW, where W is the current text. Returns false if c is
+	 * not in the alphabet: the table cannot be patched and must be dropped
+	 */
+	bool extend(char_type c){
+
+		ulint d = digit(c);
+
+		if(d == chars.size()) return false;
+
+		ulint sigma = chars.size();
+
+		if(head_len == k-1){
+
+			//head: the first k-1 characters of W
+			ulint x = d * power(k-1) + head;
+
+			for(ulint i = x+1; i < fenwick.size(); i += i & (~i+1)){
+
+				assert(fenwick[i] < UINT32_MAX);
+				fenwick[i]++;
+
+			}
+
+			head = k == 1 ? 0 : d * power(k-2) + head / sigma;
+
+		}else{
+
+			//cW is shorter than k
+			head = d * power(head_len) + head;
+			head_len++;
+
+			shorts.push_back({head * power(k-head_len), head_len});
+			std::sort(shorts.begin(), shorts.end());
+
+		}
+
+		return true;
+
+	}
+
+	/*
+	 * interval [l,r) of the rows prefixed by X = X[0,...,j-1], 0 < j <= k.
+	 * If some character of X is not in the alphabet, X does not occur
+	 * and {0,0} is returned
+	 */
+	pair<ulint,ulint> lookup(const char_type* X, ulint j) const {
+
+		assert(j > 0 and j <= k);
+
+		ulint lo = 0;
+
+		for(ulint i = 0; i < j; ++i){
+
+			ulint d = digit(X[i]);
+
+			if(d == chars.size()) return {0,0};
+
+			lo = lo * chars.size() + d;
+
+		}
+
+		//the k-mers prefixed by X are [lo,hi)
+		lo *= power(k-j);
+		ulint hi = lo + power(k-j);
+
+		/*
+		 * short suffixes before X: smaller code, or same code and shorter than
+		 * X (a prefix of X). Short suffixes with code in [lo,hi) and length
+		 * >= j are prefixed by X
+		 */
+		ulint l = 1 + prefix(lo);
+		ulint r = 1 + prefix(hi);
+
+		for(auto s : shorts){
+
+			if(s.first < lo or (s.first == lo and s.second < j)) ++l;
+			if(s.first < hi) ++r;
+
+		}
+
+		return {l,r};
+
+	}
+
+	ulint bit_size() const {
+
+		return	sizeof(kmer_table) * 8 +
+				fenwick.capacity() * sizeof(uint32_t) * 8 +
+				chars.capacity() * sizeof(char_type) * 8 +
+				shorts.capacity() * sizeof(pair<ulint,ulint>) * 8;
+
+	}
+
+private:
+
+	//dense rank of c, chars.size() if c is not in the alphabet
+	ulint digit(char_type c) const {
+
+		auto it = std::lower_bound(chars.begin(), chars.end(), c);
+
+		return it != chars.end() and *it == c ? it - chars.begin() : chars.size();
+
+	}
+
+	//sigma^e, e <= k
+	ulint power(ulint e) const {
+
+		ulint p = 1;
+
+		for(ulint j = 0; j < e; ++j) p *= chars.size();
+
+		return p;
+
+	}
+
+	//number of suffixes whose k-mer has code < x
+	ulint prefix(ulint x) const {
+
+		ulint s = 0;
+
+		for(ulint i = x; i > 0; i -= i & (~i+1)) s += fenwick[i];
+
+		return s;
+
+	}
+
+	//max number of k-mers
+	static const ulint MAX_SIZE = ulint(1) << 30;
+
+	//sorted alphabet
+	vector<char_type> chars;
+
+	ulint k = 0;
+
+	//Fenwick tree of the number of suffixes per k-mer code (1-based)
+	vector<uint32_t> fenwick;
+
+	//first min(k-1, n) characters of the text, coded, and their number
+	ulint head = 0;
+	ulint head_len = 0;
+
+	//suffixes shorter than k: <code padded with the smallest character, length>
+	vector<pair<ulint,ulint> > shorts;
+
+};
+
+}
+
+#endif /* INTERNAL_KMER_TABLE_HPP_ */
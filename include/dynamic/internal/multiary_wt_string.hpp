@@ -0,0 +1,265 @@
+// Copyright (c) 2017, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * multiary_wt_string.hpp
+ *
+ *  Dynamic string supporting rank, select, access, insert, remove.
+ *
+ *  The string uses a multiary wavelet tree: characters are written in base
+ *  2^W (W = sequence_type::width), and each node stores the sequence of the
+ *  digits of its characters at its level in a packed_sequence. With W = 4 a
+ *  byte alphabet takes 2 levels instead of the 8 of a binary wavelet tree.
+ *
+ *  Characters have fixed-length codes (their own digits): the tree height
+ *  is the number of base-2^W digits of the largest character. Inserting a
+ *  larger character adds digits on top, i.e. a new root with the old root as
+ *  its child 0 and all digits 0, so any alphabet can be used.
+ *
+ *  As in wt_string, nodes live in a pool and refer to each other through
+ *  32-bit indices; the root is nodes[0] and index 0 means "no child".
+ *
+ */
+
+#ifndef INCLUDE_INTERNAL_MULTIARY_WT_STRING_HPP_
+#define INCLUDE_INTERNAL_MULTIARY_WT_STRING_HPP_
+
+#include "dynamic/internal/includes.hpp"
+
+namespace dyn {
+
+template <class sequence_type>  // dynamic sequence over the digits {0, ..., 2^W - 1}
+class multiary_wt_string {
+ public:
+  typedef uint64_t char_type;
+  typedef char_type value_type;
+
+  static constexpr uint8_t W = sequence_type::width;
+  static constexpr uint64_t ARITY = uint64_t(1) << W;
+
+  /*
+   * Constructor #1
+   *
+   * Alphabet is unknown: the tree grows with the characters
+   *
+   */
+  multiary_wt_string() {}
+
+  /*
+   * Constructor #2
+   *
+   * We know the alphabet size: characters are 0, ..., sigma-1
+   *
+   */
+  explicit multiary_wt_string(uint64_t sigma) {
+    assert(sigma > 0);
+    grow(sigma - 1);
+  }
+
+  /*
+   * Constructor #3
+   *
+   * pairs <character, probability>. Codes have fixed length here, so only
+   * the characters are used (to size the tree)
+   *
+   */
+  explicit multiary_wt_string(vector<pair<char_type, double>>& P) {
+    for (auto& p : P) grow(p.first);
+  }
+
+  uint64_t size() const { return n; }
+
+  char_type at(uint64_t i) const {
+    assert(i < size());
+
+    char_type c = 0;
+    uint32_t x = 0;
+
+    for (uint8_t l = 0; l < height; ++l) {
+      auto dr = nodes[x].seq.at_rank(i);
+
+      c = (c << W) | dr.first;
+      i = dr.second;
+      x = nodes[x].child[dr.first];
+    }
+
+    return c;
+  }
+
+  char_type operator[](uint64_t i) const { return at(i); }
+
+  // number of cs in positions [0, i)
+  uint64_t rank(uint64_t i, char_type c) const {
+    assert(i <= size());
+
+    if (not fits(c)) return 0;
+
+    uint32_t x = 0;
+
+    for (uint8_t l = 0; l < height; ++l) {
+      uint64_t d = digit(c, l);
+      i = nodes[x].seq.rank(i, d);
+
+      if (i == 0) return 0;
+      if (l + 1 < height and (x = nodes[x].child[d]) == NO_NODE) return 0;
+    }
+
+    return i;
+  }
+
+  // position of the i-th (0-based) c. There must be one
+  uint64_t select(uint64_t i, char_type c) const {
+    assert(fits(c));
+    assert(i < rank(size(), c));
+
+    // the path of c, then climb back with selects
+    vector<uint32_t> path;
+    uint32_t x = 0;
+
+    for (uint8_t l = 0; l < height; ++l) {
+      path.push_back(x);
+      if (l + 1 < height) x = nodes[x].child[digit(c, l)];
+    }
+
+    for (uint8_t l = height; l > 0; --l) i = nodes[path[l - 1]].seq.select(i, digit(c, l - 1));
+
+    return i;
+  }
+
+  // insert c at position i
+  void insert(uint64_t i, char_type c) {
+    assert(i <= size());
+
+    grow(c);
+
+    uint32_t x = 0;
+
+    for (uint8_t l = 0; l < height; ++l) {
+      uint64_t d = digit(c, l);
+
+      nodes[x].seq.insert(i, d);
+      i = nodes[x].seq.rank(i, d);
+
+      if (l + 1 < height) {
+        if (nodes[x].child[d] == NO_NODE) {
+          uint32_t y = nodes.size();
+          nodes.push_back(node());
+          nodes[x].child[d] = y;
+        }
+
+        x = nodes[x].child[d];
+      }
+    }
+
+    ++n;
+  }
+
+  void push_back(char_type c) { insert(size(), c); }
+
+  void push_front(char_type c) { insert(0, c); }
+
+  // remove the character at position i
+  void remove(uint64_t i) {
+    assert(i < size());
+
+    uint32_t x = 0;
+
+    for (uint8_t l = 0; l < height; ++l) {
+      auto dr = nodes[x].seq.at_rank(i);
+
+      nodes[x].seq.remove(i);
+      i = dr.second;
+      x = nodes[x].child[dr.first];
+    }
+
+    --n;
+  }
+
+  uint64_t bit_size() const {
+    uint64_t size = sizeof(multiary_wt_string) * 8;
+
+    for (auto& N : nodes) size += N.bit_size();
+
+    return size;
+  }
+
+  uint64_t serialize(ostream& out) const {
+    uint64_t w_bytes = 0;
+
+    out.write((char*)&n, sizeof(n));
+    out.write((char*)&height, sizeof(height));
+    w_bytes += sizeof(n) + sizeof(height);
+
+    uint64_t nr_nodes = nodes.size();
+    out.write((char*)&nr_nodes, sizeof(nr_nodes));
+    w_bytes += sizeof(nr_nodes);
+
+    for (auto& N : nodes) {
+      w_bytes += N.seq.serialize(out);
+      out.write((char*)N.child, sizeof(N.child));
+      w_bytes += sizeof(N.child);
+    }
+
+    return w_bytes;
+  }
+
+  void load(istream& in) {
+    in.read((char*)&n, sizeof(n));
+    in.read((char*)&height, sizeof(height));
+
+    uint64_t nr_nodes;
+    in.read((char*)&nr_nodes, sizeof(nr_nodes));
+
+    nodes = vector<node>(nr_nodes);
+
+    for (auto& N : nodes) {
+      N.seq.load(in);
+      in.read((char*)N.child, sizeof(N.child));
+    }
+  }
+
+ private:
+  static constexpr uint32_t NO_NODE = 0;
+
+  struct node {
+    sequence_type seq;
+    uint32_t child[ARITY] = {0};
+
+    uint64_t bit_size() const { return sizeof(node) * 8 + seq.bit_size() - sizeof(sequence_type) * 8; }
+  };
+
+  // number of characters representable with the current height
+  bool fits(char_type c) const { return height * W >= 64 or (c >> (height * W)) == 0; }
+
+  // l-th base-2^W digit of c, from the most significant
+  uint64_t digit(char_type c, uint8_t l) const { return (c >> (W * (height - 1 - l))) & (ARITY - 1); }
+
+  /*
+   * add levels on top until c fits. All characters have digit 0 on the new
+   * level, so the new root's sequence is all 0s and its child 0 the old root
+   */
+  void grow(char_type c) {
+    while (not fits(c)) {
+      node root;
+      for (uint64_t i = 0; i < n; ++i) root.seq.push_back(0);
+
+      nodes.push_back(std::move(nodes[0]));
+      root.child[0] = nodes.size() - 1;
+      nodes[0] = std::move(root);
+
+      ++height;
+    }
+  }
+
+  vector<node> nodes = vector<node>(1);
+
+  // digits per character
+  uint8_t height = 1;
+
+  uint64_t n = 0;
+};
+
+}  // namespace dyn
+
+#endif /* INCLUDE_INTERNAL_MULTIARY_WT_STRING_HPP_ */
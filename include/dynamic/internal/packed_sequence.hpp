@@ -0,0 +1,627 @@
+// Copyright (c) 2017, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * packed_sequence.hpp
+ *
+ *  Dynamic sequence over a small alphabet {0, ..., 2^W - 1} (W = 1, 2, 4 or 8
+ *  bits per symbol) supporting access, rank, select, insert and remove.
+ *
+ *  Symbols are packed 64/W per word in the leaves of a B-tree. Rank inside
+ *  a leaf counts the fields equal to a symbol with a few word operations and
+ *  a popcount per word; internal nodes store, for each child, its size and
+ *  the number of occurrences of each symbol.
+ *
+ *  This is the node sequence of multiary wavelet trees (see
+ *  multiary_wt_string.hpp).
+ *
+ */
+
+#ifndef INTERNAL_PACKED_SEQUENCE_HPP_
+#define INTERNAL_PACKED_SEQUENCE_HPP_
+
+#include "dynamic/internal/includes.hpp"
+
+namespace dyn {
+
+/*
+ * leaf: a plain vector of W-bit symbols with word-parallel rank
+ */
+template <uint8_t W>
+class packed_symbol_vector {
+ public:
+  static_assert(W == 1 or W == 2 or W == 4 or W == 8, "W must divide 64");
+
+  static constexpr uint64_t SIGMA = uint64_t(1) << W;
+
+  // symbols per word
+  static constexpr uint64_t F = 64 / W;
+
+  uint64_t size() const { return size_; }
+
+  uint64_t at(uint64_t i) const {
+    assert(i < size_);
+    return (words[i / F] >> ((i % F) * W)) & (SIGMA - 1);
+  }
+
+  // number of occurrences of c in positions [0, i)
+  uint64_t rank(uint64_t i, uint64_t c) const {
+    assert(i <= size_);
+    assert(c < SIGMA);
+
+    uint64_t r = 0;
+    uint64_t w = 0;
+
+    for (; w < i / F; ++w) r += __builtin_popcountll(matches(words[w], c));
+
+    if (i % F) r += __builtin_popcountll(matches(words[w], c) & ((uint64_t(1) << ((i % F) * W)) - 1));
+
+    return r;
+  }
+
+  // position of the j-th (0-based) occurrence of c. There must be one
+  uint64_t select(uint64_t j, uint64_t c) const {
+    assert(c < SIGMA);
+
+    for (uint64_t w = 0; w < words.size(); ++w) {
+      uint64_t m = matches(words[w], c);
+
+      // fields past the end are 0: do not count them as matches
+      if ((w + 1) * F > size_) m &= size_ % F ? (uint64_t(1) << ((size_ % F) * W)) - 1 : ~uint64_t(0);
+
+      uint64_t p = __builtin_popcountll(m);
+
+      if (j < p) {
+        for (; j > 0; --j) m &= m - 1;
+        return w * F + __builtin_ctzll(m) / W;
+      }
+
+      j -= p;
+    }
+
+    assert(false && "select: not enough occurrences");
+    return size_;
+  }
+
+  void insert(uint64_t i, uint64_t c) {
+    assert(i <= size_);
+    assert(c < SIGMA);
+
+    if (size_ % F == 0) words.push_back(0);
+
+    const uint64_t w = i / F;
+    const uint64_t o = (i % F) * W;
+
+    // shift by one field the words after w, from the top
+    for (uint64_t k = words.size() - 1; k > w; --k) words[k] = (words[k] << W) | (words[k - 1] >> (64 - W));
+
+    const uint64_t low_mask = (uint64_t(1) << o) - 1;
+    const uint64_t low = words[w] & low_mask;
+    const uint64_t high = (words[w] & ~low_mask) << W;
+
+    words[w] = low | (c << o) | high;
+
+    ++size_;
+  }
+
+  void push_back(uint64_t c) { insert(size_, c); }
+
+  // remove the symbol at position i and return it
+  uint64_t remove(uint64_t i) {
+    assert(i < size_);
+
+    const uint64_t c = at(i);
+    const uint64_t w = i / F;
+    const uint64_t o = (i % F) * W;
+
+    const uint64_t low_mask = (uint64_t(1) << o) - 1;
+    const uint64_t low = words[w] & low_mask;
+    const uint64_t high = (words[w] >> W) & ~low_mask;
+
+    words[w] = low | high;
+
+    for (uint64_t k = w + 1; k < words.size(); ++k) {
+      words[k - 1] |= words[k] << (64 - W);
+      words[k] >>= W;
+    }
+
+    --size_;
+
+    if (size_ % F == 0) words.pop_back();
+
+    return c;
+  }
+
+  /*
+   * move the second half (at a word boundary) to a new leaf, and return it
+   */
+  packed_symbol_vector* split() {
+    assert(words.size() >= 2);
+
+    const uint64_t left_words = words.size() / 2;
+
+    auto right = new packed_symbol_vector();
+    right->words.assign(words.begin() + left_words, words.end());
+    right->size_ = size_ - left_words * F;
+
+    words.resize(left_words);
+    words.shrink_to_fit();
+    size_ = left_words * F;
+
+    return right;
+  }
+
+  // append the symbols of leaf l
+  void append(const packed_symbol_vector& l) {
+    for (uint64_t i = 0; i < l.size(); ++i) push_back(l.at(i));
+  }
+
+  uint64_t bit_size() const { return sizeof(packed_symbol_vector) * 8 + words.capacity() * 64; }
+
+ private:
+  /*
+   * word with the top bit of each field equal to c set, and all other bits
+   * 0. Fields past the end of the sequence hold 0
+   */
+  static uint64_t matches(uint64_t x, uint64_t c) {
+    const uint64_t ones = ~uint64_t(0) / (SIGMA - 1);  // 1 in the lowest bit of each field
+    const uint64_t high = ones << (W - 1);
+    const uint64_t low = ~high;
+
+    // fields of y are 0 where x has c; then set the top bit of nonzero fields
+    const uint64_t y = x ^ (c * ones);
+    const uint64_t nonzero = (((y & low) + low) | y) & high;
+
+    return ~nonzero & high;
+  }
+
+  vector<uint64_t> words;
+  uint64_t size_ = 0;
+};
+
+template <uint8_t W,            // bits per symbol
+          uint32_t B_LEAF = 1024,  // leaves hold at most 2*B_LEAF symbols
+          uint32_t B = 16          // internal nodes have at most 2*B children
+          >
+class packed_sequence {
+ public:
+  typedef packed_symbol_vector<W> leaf_type;
+
+  static constexpr uint64_t SIGMA = leaf_type::SIGMA;
+
+  // bits per symbol
+  static constexpr uint8_t width = W;
+
+  packed_sequence() { root = new node(); }
+
+  packed_sequence(const packed_sequence& s) { root = new node(*s.root); }
+
+  packed_sequence(packed_sequence&& s) noexcept : root(s.root) { s.root = NULL; }
+
+  packed_sequence& operator=(const packed_sequence& s) {
+    if (this != &s) {
+      delete root;
+      root = new node(*s.root);
+    }
+    return *this;
+  }
+
+  packed_sequence& operator=(packed_sequence&& s) noexcept {
+    std::swap(root, s.root);
+    return *this;
+  }
+
+  ~packed_sequence() { delete root; }
+
+  uint64_t size() const { return root->size(); }
+
+  uint64_t at(uint64_t i) const { return at_rank(i).first; }
+
+  uint64_t operator[](uint64_t i) const { return at(i); }
+
+  /*
+   * the symbol c at position i, and the number of cs before i: the two
+   * steps of a wavelet tree descent, with one descent of this tree
+   */
+  pair<uint64_t, uint64_t> at_rank(uint64_t i) const {
+    assert(i < size());
+
+    // the path, to add up the counts of c once it is known
+    pair<const node*, uint32_t> path[64];
+    uint32_t h = 0;
+    const node* x = root;
+
+    while (true) {
+      uint32_t k = 0;
+      while (i >= x->sizes[k]) i -= x->sizes[k++];
+
+      assert(h < 64);
+      path[h++] = {x, k};
+
+      if (x->has_leaves()) break;
+
+      x = x->children[k];
+    }
+
+    const leaf_type* l = x->leaves[path[h - 1].second];
+    uint64_t c = l->at(i);
+    uint64_t r = l->rank(i, c);
+
+    for (uint32_t d = 0; d < h; ++d) {
+      for (uint32_t k = 0; k < path[d].second; ++k) r += path[d].first->count(k, c);
+    }
+
+    return {c, r};
+  }
+
+  // number of cs in positions [0, i)
+  uint64_t rank(uint64_t i, uint64_t c) const {
+    assert(i <= size());
+    assert(c < SIGMA);
+
+    const node* x = root;
+    uint64_t r = 0;
+
+    while (true) {
+      uint32_t k = 0;
+
+      while (k + 1 < x->nr_children() and i > x->sizes[k]) {
+        i -= x->sizes[k];
+        r += x->count(k, c);
+        ++k;
+      }
+
+      if (x->has_leaves()) return r + x->leaves[k]->rank(i, c);
+
+      x = x->children[k];
+    }
+  }
+
+  // position of the j-th (0-based) c
+  uint64_t select(uint64_t j, uint64_t c) const {
+    assert(c < SIGMA);
+    assert(j < rank(size(), c));
+
+    const node* x = root;
+    uint64_t p = 0;
+
+    while (true) {
+      uint32_t k = 0;
+
+      while (j >= x->count(k, c)) {
+        j -= x->count(k, c);
+        p += x->sizes[k];
+        ++k;
+      }
+
+      if (x->has_leaves()) return p + x->leaves[k]->select(j, c);
+
+      x = x->children[k];
+    }
+  }
+
+  void insert(uint64_t i, uint64_t c) {
+    assert(i <= size());
+    assert(c < SIGMA);
+
+    node* right = root->insert(i, c);
+
+    if (right != NULL) {
+      node* new_root = new node(false);
+      new_root->add_child(0, root);
+      new_root->add_child(1, right);
+      root = new_root;
+    }
+  }
+
+  void push_back(uint64_t c) { insert(size(), c); }
+
+  // remove the symbol at position i and return it
+  uint64_t remove(uint64_t i) {
+    assert(i < size());
+
+    uint64_t c = root->remove(i);
+
+    // drop roots with only one (non-leaf) child
+    while (not root->has_leaves() and root->nr_children() == 1) {
+      node* child = root->children[0];
+      root->children.clear();
+      delete root;
+      root = child;
+    }
+
+    return c;
+  }
+
+  uint64_t bit_size() const { return sizeof(packed_sequence) * 8 + root->bit_size(); }
+
+  /*
+   * the size, then the symbols packed 64/W per word
+   */
+  uint64_t serialize(ostream& out) const {
+    uint64_t n = size();
+    out.write((char*)&n, sizeof(n));
+
+    uint64_t w_bytes = sizeof(n);
+    uint64_t word = 0;
+    uint64_t i = 0;
+
+    root->for_each_leaf([&](const leaf_type* l) {
+      for (uint64_t j = 0; j < l->size(); ++j, ++i) {
+        word |= l->at(j) << ((i % leaf_type::F) * W);
+
+        if (i % leaf_type::F == leaf_type::F - 1) {
+          out.write((char*)&word, sizeof(word));
+          w_bytes += sizeof(word);
+          word = 0;
+        }
+      }
+    });
+
+    if (n % leaf_type::F) {
+      out.write((char*)&word, sizeof(word));
+      w_bytes += sizeof(word);
+    }
+
+    return w_bytes;
+  }
+
+  void load(istream& in) {
+    uint64_t n;
+    in.read((char*)&n, sizeof(n));
+
+    // leaves filled to 3/2 B_LEAF, then the levels above
+    vector<leaf_type*> leaves{new leaf_type()};
+    uint64_t word = 0;
+
+    for (uint64_t i = 0; i < n; ++i) {
+      if (i % leaf_type::F == 0) in.read((char*)&word, sizeof(word));
+
+      if (leaves.back()->size() == 3 * B_LEAF / 2) leaves.push_back(new leaf_type());
+      leaves.back()->push_back((word >> ((i % leaf_type::F) * W)) & (SIGMA - 1));
+    }
+
+    delete root;
+
+    vector<node*> level;
+    for (uint64_t k = 0; k < leaves.size(); k += B) {
+      node* x = new node(true);
+      for (uint64_t h = k; h < std::min<uint64_t>(leaves.size(), k + B); ++h) x->add_leaf(h - k, leaves[h]);
+      level.push_back(x);
+    }
+
+    while (level.size() > 1) {
+      vector<node*> up;
+      for (uint64_t k = 0; k < level.size(); k += B) {
+        node* x = new node(false);
+        for (uint64_t h = k; h < std::min<uint64_t>(level.size(), k + B); ++h) x->add_child(h - k, level[h]);
+        up.push_back(x);
+      }
+      level.swap(up);
+    }
+
+    root = level[0];
+  }
+
+ private:
+  class node {
+   public:
+    // a root with one empty leaf
+    node() : node(true) { add_leaf(0, new leaf_type()); }
+
+    explicit node(bool has_leaves) : has_leaves_(has_leaves) {}
+
+    node(const node& x) : sizes(x.sizes), counts(x.counts), has_leaves_(x.has_leaves_) {
+      for (auto l : x.leaves) leaves.push_back(new leaf_type(*l));
+      for (auto c : x.children) children.push_back(new node(*c));
+    }
+
+    ~node() {
+      for (auto l : leaves) delete l;
+      for (auto c : children) delete c;
+    }
+
+    bool has_leaves() const { return has_leaves_; }
+
+    uint32_t nr_children() const { return sizes.size(); }
+
+    uint64_t size() const {
+      uint64_t s = 0;
+      for (auto x : sizes) s += x;
+      return s;
+    }
+
+    uint64_t count(uint32_t k, uint64_t c) const { return counts[k * SIGMA + c]; }
+
+    /*
+     * insert c at position i of this subtree. If this node has to be split,
+     * return the new right sibling
+     */
+    node* insert(uint64_t i, uint64_t c) {
+      // i == sizes[k] appends to child k
+      uint32_t k = 0;
+      while (k + 1 < nr_children() and i > sizes[k]) i -= sizes[k++];
+
+      sizes[k]++;
+      counts[k * SIGMA + c]++;
+
+      if (has_leaves()) {
+        leaf_type* l = leaves[k];
+        l->insert(i, c);
+
+        if (l->size() > 2 * B_LEAF) {
+          leaf_type* r = l->split();
+          remove_stats(k, leaf_stats(r));
+          add_leaf(k + 1, r);
+        }
+
+      } else {
+        node* r = children[k]->insert(i, c);
+
+        if (r != NULL) {
+          remove_stats(k, r->stats());
+          add_child(k + 1, r);
+        }
+      }
+
+      return nr_children() > 2 * B ? split() : NULL;
+    }
+
+    // remove the symbol at position i of this subtree and return it
+    uint64_t remove(uint64_t i) {
+      uint32_t k = 0;
+      while (i >= sizes[k]) i -= sizes[k++];
+
+      uint64_t c;
+
+      if (has_leaves()) {
+        c = leaves[k]->remove(i);
+
+      } else {
+        c = children[k]->remove(i);
+      }
+
+      sizes[k]--;
+      counts[k * SIGMA + c]--;
+
+      if (sizes[k] == 0 and nr_children() > 1) {
+        erase(k);
+
+      } else if (has_leaves()) {
+        // merge small adjacent leaves
+        if (k + 1 < nr_children() and sizes[k] + sizes[k + 1] <= B_LEAF) {
+          merge_leaves(k);
+        } else if (k > 0 and sizes[k - 1] + sizes[k] <= B_LEAF) {
+          merge_leaves(k - 1);
+        }
+      }
+
+      return c;
+    }
+
+    template <class Fun>
+    void for_each_leaf(Fun f) const {
+      for (auto l : leaves) f(l);
+      for (auto c : children) c->for_each_leaf(f);
+    }
+
+    uint64_t bit_size() const {
+      uint64_t bs = sizeof(node) * 8;
+      bs += (sizes.capacity() + counts.capacity()) * 64;
+      bs += (leaves.capacity() + children.capacity()) * sizeof(void*) * 8;
+
+      for (auto l : leaves) bs += l->bit_size();
+      for (auto c : children) bs += c->bit_size();
+
+      return bs;
+    }
+
+    // size, then symbol counts, of the whole subtree
+    vector<uint64_t> stats() const {
+      vector<uint64_t> s(SIGMA + 1, 0);
+
+      for (uint32_t k = 0; k < nr_children(); ++k) {
+        s[0] += sizes[k];
+        for (uint64_t c = 0; c < SIGMA; ++c) s[c + 1] += count(k, c);
+      }
+
+      return s;
+    }
+
+    void add_leaf(uint32_t k, leaf_type* l) {
+      assert(has_leaves());
+      leaves.insert(leaves.begin() + k, l);
+      add_stats(k, leaf_stats(l));
+    }
+
+    void add_child(uint32_t k, node* x) {
+      assert(not has_leaves());
+      children.insert(children.begin() + k, x);
+      add_stats(k, x->stats());
+    }
+
+    vector<leaf_type*> leaves;
+    vector<node*> children;
+    vector<uint64_t> sizes;   // size of each child
+    vector<uint64_t> counts;  // counts[k*SIGMA + c]: number of cs in child k
+
+   private:
+    static vector<uint64_t> leaf_stats(const leaf_type* l) {
+      vector<uint64_t> s(SIGMA + 1);
+      s[0] = l->size();
+      for (uint64_t c = 0; c < SIGMA; ++c) s[c + 1] = l->rank(l->size(), c);
+      return s;
+    }
+
+    void add_stats(uint32_t k, const vector<uint64_t>& s) {
+      sizes.insert(sizes.begin() + k, s[0]);
+      counts.insert(counts.begin() + k * SIGMA, s.begin() + 1, s.end());
+    }
+
+    void remove_stats(uint32_t k, const vector<uint64_t>& s) {
+      sizes[k] -= s[0];
+      for (uint64_t c = 0; c < SIGMA; ++c) counts[k * SIGMA + c] -= s[c + 1];
+    }
+
+    // remove child k (with its subtree) and its stats
+    void erase(uint32_t k) {
+      if (has_leaves()) {
+        delete leaves[k];
+        leaves.erase(leaves.begin() + k);
+      } else {
+        delete children[k];
+        children.erase(children.begin() + k);
+      }
+
+      sizes.erase(sizes.begin() + k);
+      counts.erase(counts.begin() + k * SIGMA, counts.begin() + (k + 1) * SIGMA);
+    }
+
+    // append leaf k+1 to leaf k
+    void merge_leaves(uint32_t k) {
+      leaves[k]->append(*leaves[k + 1]);
+
+      sizes[k] += sizes[k + 1];
+      for (uint64_t c = 0; c < SIGMA; ++c) counts[k * SIGMA + c] += count(k + 1, c);
+
+      erase(k + 1);
+    }
+
+    // move the second half of the children to a new node, and return it
+    node* split() {
+      node* right = new node(has_leaves());
+      uint32_t half = nr_children() / 2;
+
+      for (uint32_t k = half; k < nr_children(); ++k) {
+        if (has_leaves()) {
+          right->leaves.push_back(leaves[k]);
+        } else {
+          right->children.push_back(children[k]);
+        }
+      }
+
+      right->sizes.assign(sizes.begin() + half, sizes.end());
+      right->counts.assign(counts.begin() + half * SIGMA, counts.end());
+
+      if (has_leaves()) {
+        leaves.resize(half);
+      } else {
+        children.resize(half);
+      }
+
+      sizes.resize(half);
+      counts.resize(half * SIGMA);
+
+      return right;
+    }
+
+    bool has_leaves_;
+  };
+
+  node* root = NULL;
+};
+
+}  // namespace dyn
+
+#endif /* INTERNAL_PACKED_SEQUENCE_HPP_ */
@@ -186,6 +186,43 @@ class packed_vector {
         return s;
     }
 
+    /*
+     * smallest index j >= i such that the j-th integer is > 0, or size() if
+     * there is none. Nonzero fields are located with a trailing-zeros count
+     * on whole words
+     */
+    uint64_t next1(uint64_t i) const {
+        if (i >= size_) return size_;
+
+        uint64_t w = i / int_per_word_;
+        uint64_t nr_words = size_ / int_per_word_ + (size_ % int_per_word_ != 0);
+        uint64_t x = words[w] & (~uint64_t(0) << ((i % int_per_word_) * width_));
+
+        while (x == 0 and ++w < nr_words) x = words[w];
+
+        if (x == 0) return size_;
+
+        return w * int_per_word_ + __builtin_ctzll(x) / width_;
+    }
+
+    /*
+     * largest index j <= i such that the j-th integer is > 0, or size() if
+     * there is none
+     */
+    uint64_t prev1(uint64_t i) const {
+        assert(i < size_);
+
+        uint64_t w = i / int_per_word_;
+        uint64_t x = words[w] &
+                     (~uint64_t(0) >> (63 - ((i % int_per_word_) * width_ + width_ - 1)));
+
+        while (x == 0 and w > 0) x = words[--w];
+
+        if (x == 0) return size_;
+
+        return w * int_per_word_ + (63 - __builtin_clzll(x)) / width_;
+    }
+
     /*
      * smallest index j such that psum(j)>=x
      */
@@ -417,6 +454,82 @@ class packed_vector {
                "uninitialized non-zero values in the end of the vector");
     }
 
+    /*
+     * remove the n integers in positions [i, i+n): the integers after them
+     * are moved back with one pass over the words. As in remove, the vector
+     * is rebuilt with a smaller width if the removed integers were the only
+     * ones needing the current width
+     */
+    void remove_range(uint64_t i, uint64_t n) {
+        assert(i + n <= size_);
+
+        if (n == 0) return;
+
+        uint8_t removed_width = 0;
+        for (uint64_t j = i; j < i + n; ++j)
+            removed_width = std::max(removed_width, bitsize(at(j)));
+
+        if (width_ > 1 && removed_width == width_ && n < size_) {
+            uint8_t max_b = 0;
+
+            for (uint64_t j = 0; j < size_; ++j)
+                if (j < i || j >= i + n) max_b = std::max(max_b, bitsize(at(j)));
+
+            if (max_b < width_) {
+                rebuild_rem(i, max_b, n);
+                return;
+            }
+        }
+
+        for (uint64_t j = i; j < i + n; ++j) psum_ -= at(j);
+
+        const uint64_t m = size_ - i - n;  // integers moved back
+        const uint64_t old_words =
+            size_ / int_per_word_ + (size_ % int_per_word_ != 0);
+        uint64_t j = 0;
+
+        // up to the end of the word of position i, one integer at a time
+        for (; j < m && (i + j) % int_per_word_ != 0; ++j)
+            set_without_psum_update(i + j, at(i + j + n));
+
+        // then whole words: word w gets the integers starting at position
+        // w * int_per_word_ + n, i.e. at offset r of word w + q
+        const uint64_t q = n / int_per_word_;
+        const uint64_t r = n % int_per_word_;
+        const uint64_t used_bits = int_per_word_ * width_;
+        const uint64_t word_mask =
+            used_bits == 64 ? ~uint64_t(0) : (uint64_t(1) << used_bits) - 1;
+
+        for (; j < m; j += int_per_word_) {
+            const uint64_t w = (i + j) / int_per_word_;
+            uint64_t x = words[w + q] >> (r * width_);
+
+            if (r && w + q + 1 < old_words)
+                x |= words[w + q + 1] << ((int_per_word_ - r) * width_);
+
+            words[w] = x & word_mask;
+        }
+
+        // integers after the end are 0
+        size_ -= n;
+        const uint64_t nr_words =
+            size_ / int_per_word_ + (size_ % int_per_word_ != 0);
+
+        if (size_ % int_per_word_)
+            words[nr_words - 1] &=
+                ~uint64_t(0) >> (64 - (size_ % int_per_word_) * width_);
+
+        std::fill(words.begin() + nr_words, words.begin() + old_words, 0);
+
+        while (words.size() > nr_words + extra_) words.pop_back();
+
+        assert((size_ / int_per_word_ + (size_ % int_per_word_ != 0) ==
+                    words.size() ||
+                !(words[words.size() - 1] >>
+                  ((size_ % int_per_word_) * width_))) &&
+               "uninitialized non-zero values in the end of the vector");
+    }
+
     void insert(uint64_t i, uint64_t x) {
         if (i == size()) {
             push_back(x);
@@ -468,24 +581,17 @@ class packed_vector {
             // only one integer to insert
             insert(i, word);
 
-        } else if (width == 1 && width_ == 1 && n == 64) {
-            // insert 64 bits packed into a word
+        } else if (width == 1 && width_ == 1 && n == 64 && i == size_) {
+            // append 64 bits packed into a word
             uint64_t pos = size_ / 64;
             uint8_t offset = size_ - pos * 64;
 
-            if (!offset) {
-                words.insert(words.begin() + pos, word);
-            } else {
-                assert(pos + 1 < words.size());
-
-                words.insert(words.begin() + pos, words[pos + 1]);
+            // bits after position size_ are 0
+            if (words.size() < pos + 1 + (offset != 0))
+                words.resize(pos + 1 + (offset != 0), 0);
 
-                words[pos] &= ((1llu << offset) - 1);
-                words[pos] |= word << offset;
-
-                words[pos + 1] &= ~((1llu << offset) - 1);
-                words[pos + 1] &= word >> (64 - offset);
-            }
+            words[pos] |= word << offset;
+            if (offset) words[pos + 1] = word >> (64 - offset);
 
             size_ += n;
             psum_ += __builtin_popcountll(word);
@@ -787,6 +893,11 @@ class packed_vector {
 
             words[j] <<= width_;
 
+            // clear the bits above the last integer of the word (if 64 is not
+            // a multiple of width_), where the last integer has been shifted
+            if (int_per_word_ * width_ < 64)
+                words[j] &= ~uint64_t(0) >> (64 - int_per_word_ * width_);
+
             assert(j * int_per_word_ >= size_ || !at(j * int_per_word_));
 
             assert(bitsize(falling_out) <= width_);
@@ -910,9 +1021,9 @@ class packed_vector {
                "uninitialized non-zero values in the end of the vector");
     }
 
-    // Rebuilds entire vector, removing j from the vector
-    void rebuild_rem(uint64_t j, uint8_t new_width_) {
-        if ((new_width_ == 0) || (size_ - 1 == 0)) {
+    // Rebuilds entire vector, removing [j, j+n) from the vector
+    void rebuild_rem(uint64_t j, uint8_t new_width_, uint64_t n = 1) {
+        if ((new_width_ == 0) || (size_ - n == 0)) {
             width_ = 0;
             size_ = 0;
             words.clear();
@@ -932,7 +1043,7 @@ class packed_vector {
 
         uint64_t new_psum_ = 0;
         uint8_t new_int_per_word_ = 64 / new_width_;
-        uint64_t new_size_ = size_ - 1;
+        uint64_t new_size_ = size_ - n;
 
         vector<uint64_t> new_words(new_size_ / new_int_per_word_ +
                                        (new_size_ % new_int_per_word_ != 0) +
@@ -943,7 +1054,7 @@ class packed_vector {
 
         uint64_t i = 0;
         for (uint64_t k = 0; k < size_; ++k) {
-            if (k == j) {
+            if (k >= j && k < j + n) {
                 // skip
 
             } else {
@@ -1141,6 +1252,162 @@ class packed_bit_vector : public packed_vector {
         }
     }
 
+    /*
+     * smallest index j >= i such that the j-th bit is 0, or size() if there
+     * is none
+     */
+    uint64_t next0(uint64_t i) const {
+        if (i >= size_) return size_;
+
+        uint64_t w = i / 64;
+        uint64_t nr_words = size_ / 64 + (size_ % 64 != 0);
+        uint64_t x = ~words[w] & (~uint64_t(0) << (i % 64));
+
+        while (x == 0 and ++w < nr_words) x = ~words[w];
+
+        if (x == 0) return size_;
+
+        // bits past the end of the vector are 0 in words, 1 in ~words
+        uint64_t j = w * 64 + __builtin_ctzll(x);
+        return j < size_ ? j : size_;
+    }
+
+    /*
+     * the n <= 64 bits starting at position i, packed in the n least
+     * significant bits of the result
+     */
+    uint64_t get_bits(uint64_t i, uint8_t n) const {
+        assert(n <= 64 and i + n <= size_);
+
+        if (n == 0) return 0;
+
+        uint64_t s = i % 64;
+        uint64_t x = words[i / 64] >> s;
+
+        if (s + n > 64) x |= words[i / 64 + 1] << (64 - s);
+
+        return n == 64 ? x : x & ((uint64_t(1) << n) - 1);
+    }
+
+    /*
+     * the n <= 64 bits starting at position i of the bits packed (least
+     * significant bit first) in src
+     */
+    static uint64_t get_bits(const vector<uint64_t>& src, uint64_t i, uint8_t n) {
+        assert(n <= 64 and (i + n + 63) / 64 <= src.size());
+
+        if (n == 0) return 0;
+
+        uint64_t s = i % 64;
+        uint64_t x = src[i / 64] >> s;
+
+        if (s + n > 64) x |= src[i / 64 + 1] << (64 - s);
+
+        return n == 64 ? x : x & ((uint64_t(1) << n) - 1);
+    }
+
+    /*
+     * insert at position i the n bits starting at position off of the bits
+     * packed in src: the bits from position i onwards are moved by n, 64 at
+     * a time and from the top, then the new bits are written 64 at a time
+     */
+    void insert_bits(uint64_t i, const vector<uint64_t>& src, uint64_t off, uint64_t n) {
+        assert(i <= size_);
+
+        if (n == 0) return;
+
+        const uint64_t nr_words = (size_ + n) / 64 + ((size_ + n) % 64 != 0);
+        if (words.size() < nr_words) words.resize(nr_words + extra_, 0);
+
+        for (uint64_t j = size_; j > i;) {
+            const uint8_t c = std::min<uint64_t>(64, j - i);
+            j -= c;
+            write_bits(j + n, get_bits(j, c), c);
+        }
+
+        for (uint64_t j = 0; j < n; j += 64) {
+            const uint8_t c = std::min<uint64_t>(64, n - j);
+            const uint64_t x = get_bits(src, off + j, c);
+
+            write_bits(i + j, x, c);
+            psum_ += __builtin_popcountll(x);
+        }
+
+        size_ += n;
+
+        assert((size_ % 64 == 0 || !(words[size_ / 64] >> (size_ % 64))) &&
+               "uninitialized non-zero values in the end of the vector");
+    }
+
+    /*
+     * insert n bits packed into word at position i: the bits from position i
+     * onwards are shifted by n with one pass over the words
+     */
+    void insert_word(uint64_t i, uint64_t word, uint8_t width, uint8_t n) {
+        if (width != 1 or n == 1 or i == size_) {
+            packed_vector::insert_word(i, word, width, n);
+            return;
+        }
+
+        assert(i < size_);
+        assert(n <= 64);
+        assert(n == 64 || (word >> n) == 0);
+
+        const uint64_t nr_words = (size_ + n) / 64 + ((size_ + n) % 64 != 0);
+        if (words.size() < nr_words) words.resize(nr_words + extra_, 0);
+
+        const uint64_t w = i / 64;
+        const uint8_t s = i % 64;
+        const uint64_t low_mask = s ? (~uint64_t(0)) >> (64 - s) : 0;
+        const uint64_t low = words[w] & low_mask;
+
+        // shift words [w, nr_words) left by n bits, from the top
+        words[w] &= ~low_mask;
+        for (uint64_t j = nr_words - 1; j > w; --j) {
+            words[j] = n == 64 ? words[j - 1]
+                               : (words[j] << n) | (words[j - 1] >> (64 - n));
+        }
+        words[w] = n == 64 ? 0 : words[w] << n;
+
+        // put back the bits before i, then the new ones
+        words[w] |= low | (word << s);
+        if (s && s + n > 64) words[w + 1] |= word >> (64 - s);
+
+        size_ += n;
+        psum_ += __builtin_popcountll(word);
+
+        assert((size_ % 64 == 0 || !(words[size_ / 64] >> (size_ % 64))) &&
+               "uninitialized non-zero values in the end of the vector");
+    }
+
+    /*
+     * remove the n bits in positions [i, i+n): the bits after them are
+     * moved back 64 at a time
+     */
+    void remove_range(uint64_t i, uint64_t n) {
+        assert(i + n <= size_);
+
+        for (uint64_t j = i; j < i + n; j += 64) {
+            psum_ -= __builtin_popcountll(get_bits(j, std::min<uint64_t>(64, i + n - j)));
+        }
+
+        // each chunk is read before the writes reach it
+        const uint64_t m = size_ - i - n;
+        for (uint64_t j = 0; j < m; j += 64) {
+            const uint8_t c = std::min<uint64_t>(64, m - j);
+            write_bits(i + j, get_bits(i + n + j, c), c);
+        }
+
+        // bits after the end are 0
+        const uint64_t old_words = size_ / 64 + (size_ % 64 != 0);
+        size_ -= n;
+        uint64_t nr_words = size_ / 64 + (size_ % 64 != 0);
+        if (size_ % 64) words[nr_words - 1] &= (~uint64_t(0)) >> (64 - size_ % 64);
+        std::fill(words.begin() + nr_words, words.begin() + old_words, 0);
+
+        while (words.size() > nr_words + extra_) words.pop_back();
+    }
+
     packed_bit_vector* split() {
         uint64_t tot_words =
             (size_ / int_per_word_) + (size_ % int_per_word_ != 0);
@@ -1182,6 +1449,19 @@ class packed_bit_vector : public packed_vector {
 
         return right;
     }
+
+   private:
+    // overwrite the c <= 64 bits starting at position i with those of x
+    void write_bits(uint64_t i, uint64_t x, uint8_t c) {
+        assert(c > 0 and c <= 64);
+
+        const uint64_t mask = c == 64 ? ~uint64_t(0) : (uint64_t(1) << c) - 1;
+        const uint64_t w = i / 64;
+        const uint8_t s = i % 64;
+
+        words[w] = (words[w] & ~(mask << s)) | (x << s);
+        if (s + c > 64) words[w + 1] = (words[w + 1] & ~(mask >> (64 - s))) | (x >> (64 - s));
+    }
 };
 
 }  // namespace dyn
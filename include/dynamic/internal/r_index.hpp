@@ -0,0 +1,445 @@
+// Copyright (c) 2017, Nicola Prezza.  All rights reserved.
+// Use of this source code is governed
+// by a MIT license that can be found in the LICENSE file.
+
+/*
+ * r_index.hpp
+ *
+ *  Dynamic r-index: a BWT (typically run-length encoded) with SA samples at
+ *  the BWT run boundaries only, i.e. O(r) samples where r is the number of
+ *  runs. Supports LF mapping, backward search, locate, left-extend text.
+ *
+ *  As in fm_index, text positions are enumerated from the end: the BWT
+ *  terminator has position 0, SA[LF(i)] = SA[i]+1.
+ *
+ *  - For each run we store SA at its first and at its last row.
+ *  - Toehold lemma: during backward search we keep SA at the last row of the
+ *    interval. Extending the interval of W with c, the new last row is
+ *    LF(k), where k is the last c in the interval: either k is the old last
+ *    row, or k ends a run.
+ *  - phi(x) = SA[ISA[x]-1] lists the occurrences from the last row upwards.
+ *    If row ISA[x] does not start a run, then phi(x+1) = phi(x)+1 (LF maps
+ *    the two rows of the run to consecutive rows). phi is therefore stored
+ *    only for the positions x+1 such that row ISA[x] starts a run: for the
+ *    other positions, phi(x) = phi(p) + x-p where p is the largest stored
+ *    position <= x (predecessor query on a bitvector over text positions).
+ *
+ *  Left-extending the text does not change the text positions, so samples
+ *  are never shifted: extend only changes the runs around the old terminator
+ *  row and the new row, and O(1) phi samples.
+ *
+ */
+
+#ifndef INCLUDE_INTERNAL_R_INDEX_HPP_
+#define INCLUDE_INTERNAL_R_INDEX_HPP_
+
+#include "dynamic/internal/includes.hpp"
+
+namespace dyn {
+
+template <	class dyn_bwt,	//dynamic BWT
+			class dyn_bv,	//dynamic bitvector (sparse: e.g. gap_bitvector)
+			class dyn_vec	//dynamic vector
+		>
+class r_index : public dyn_bwt{
+
+public:
+
+	//we allow any alphabet
+	using char_type = ulint;
+
+	/*
+	 * Constructor #1
+	 *
+	 * Alphabet is unknown. Characters are gamma-coded.
+	 * BWT is initialized with only terminator character (size=1)
+	 *
+	 */
+	r_index(){
+
+		init();
+
+	}
+
+	/*
+	 * Constructor #2
+	 *
+	 * We know only alphabet size. Each character is assigned log2(sigma) bits.
+	 * Characters are assigned codes 0,1,2,... in order of appearance
+	 * BWT is initialized with only terminator character (size=1)
+	 *
+	 */
+	r_index(uint64_t sigma) : dyn_bwt(sigma){
+
+		init();
+
+	}
+
+	/*
+	 * Constructor #3
+	 *
+	 * We know character probabilities. Input: pairs <character, probability>
+	 *
+	 * Here the alphabet is Huffman encoded.
+	 * BWT is initialized with only terminator character (size=1)
+	 *
+	 */
+	r_index(vector<pair<char_type,double> >& P) : dyn_bwt(P){
+
+		init();
+
+	}
+
+	/*
+	 * input: position on F column of the BWT
+	 * output: corresponding position on text (see fm_index::locate).
+	 *
+	 * SA is known at the last row of the run containing i: phi is applied
+	 * once per row between the two.
+	 */
+	ulint locate(ulint i) const {
+
+		assert(i<this->bwt_length());
+
+		return locate(pair<ulint,ulint>(i,i+1))[0];
+
+	}
+
+	/*
+	 * input: range [l,r) (right-excluded) of positions on F column of the BWT
+	 * output: vector of corresponding positions on text
+	 */
+	vector<ulint> locate(pair<ulint,ulint> range) const {
+
+		assert(range.first <= range.second and range.second <= this->bwt_length());
+
+		if(range.first == range.second) return {};
+
+		ulint q = run_of(range.second-1);
+		ulint x = last_sa.at(q);
+
+		//from the last row of the run up to the last row of the range
+		for(ulint i = run_end(q); i >= range.second; --i) x = phi(x);
+
+		return locate(range, x);
+
+	}
+
+	/*
+	 * input: pattern P
+	 * output: occurrences of P in the text, by increasing BWT row.
+	 *
+	 * Backward search keeping SA at the last row of the interval (toehold),
+	 * then one phi per occurrence
+	 */
+	vector<ulint> locate(vector<char_type> P) const {
+
+		ulint l = 0;
+		ulint r = this->bwt_length();
+		ulint x = last_sa.at(last_sa.size()-1);	//SA[r-1]
+
+		for(ulint j = P.size(); j > 0; --j){
+
+			char_type c = P[j-1];
+
+			ulint l1 = dyn_bwt::LF(l,c);
+			ulint r1 = dyn_bwt::LF(r,c);
+
+			if(l1 >= r1) return {};
+
+			//last c in [l,r): r1-1 = LF(k)
+			ulint k = this->FL(r1-1);
+
+			x = (k == r-1 ? x : last_sa.at(run_of(k))) + 1;
+
+			l = l1;
+			r = r1;
+
+		}
+
+		return locate({l,r}, x);
+
+	}
+
+	/*
+	 * build r-index of cW from r-index of W
+	 */
+	void extend(char_type c){
+
+		ulint n = this->text_length();
+		ulint size = this->bwt_length();
+		ulint t = this->get_terminator_position();	//row of SA value n
+
+		//row of the new suffix (SA value n+1)
+		ulint m = dyn_bwt::LF(t,c);
+
+		/*
+		 * SA of the rows m-1 and m, that will surround the new row. Row m-1
+		 * (if not 0) is LF(k) where k is the last c before t, or the last
+		 * occurrence of the character before c: k ends a run. In the same
+		 * way row m is LF of the first row of a run
+		 */
+		ulint sa_prev = m == 1 ? 0 : last_sa.at(run_of(this->FL(m-1))) + 1;
+		ulint sa_next = m < size ? first_sa.at(run_of(this->FL(m))) + 1 : 0;
+
+		//SA of row t+1, which starts a run (it follows the terminator)
+		ulint sa_after_t = t+1 < size ? first_sa.at(run_of(t+1)) : 0;
+
+		bool merge_left = t > 0 and this->at(t-1) == c;
+		bool merge_right = t+1 < size and this->at(t+1) == c;
+
+		dyn_bwt::extend(c);
+
+		/*
+		 * runs, on the old rows: the terminator run [t,t] becomes a c and is
+		 * merged with its neighbours
+		 */
+		ulint q = run_of(t);
+
+		if(merge_right){
+
+			last_sa.set(q,last_sa.at(q+1));
+			remove_run(q+1);
+			clear_head(t+1);
+
+		}
+
+		if(merge_left){
+
+			last_sa.set(q-1,last_sa.at(q));
+			remove_run(q);
+			clear_head(t);
+
+		}
+
+		/*
+		 * runs: insert the new row m (the terminator) as a run. If rows m-1
+		 * and m were in the same run, the run is split
+		 */
+		if(m == size){
+
+			heads.push_back(true);
+			insert_run(first_sa.size(),n+1,n+1);
+
+		}else if(heads.at(m)){
+
+			heads.insert(m,true);
+			insert_run(run_of(m-1)+1,n+1,n+1);
+
+		}else{
+
+			q = run_of(m-1);
+
+			insert_run(q+1,n+1,n+1);
+			insert_run(q+2,sa_next,last_sa.at(q));
+			last_sa.set(q,sa_prev);
+
+			heads.insert(m,true);
+			heads.set(m+1);
+
+		}
+
+		/*
+		 * phi samples: position v+1 is sampled iff row ISA[v] starts a run.
+		 * This can change only for the rows around t and m. Then, row m+1
+		 * is now preceded by the new row
+		 */
+		phi_positions.push_back(false);	//position n+1
+
+		update_phi_sample(n, t + (t >= m));
+		if(t+1 < size) update_phi_sample(sa_after_t, t+1 + (t+1 >= m));
+		if(m < size) update_phi_sample(sa_next, m+1);
+
+		if(m < size and phi_positions.at(sa_next))
+			phi_values.set(phi_positions.rank1(sa_next),n+1);
+
+	}
+
+	/*
+	 * build r-index of sW from r-index of W, where s = s[0,...,len-1].
+	 * Same as extend(s[len-1]), extend(s[len-2]), ..., extend(s[0]).
+	 */
+	void extend(const char_type* s, size_t len){
+
+		for(ulint j = len; j > 0; --j) extend(s[j-1]);
+
+	}
+
+	/*
+	 * number of samples: 2 per run, and one phi sample per run
+	 */
+	ulint number_of_samples() const {
+
+		return first_sa.size() + last_sa.size() + phi_values.size();
+
+	}
+
+	/*
+	 * Total number of bits allocated in RAM for this structure
+	 * (see the warning on fm_index::bit_size)
+	 */
+	ulint bit_size() const {
+
+		ulint size = sizeof(r_index<dyn_bwt,dyn_bv,dyn_vec>)*8;
+
+		size += dyn_bwt::bit_size();
+		size += heads.bit_size();
+		size += first_sa.bit_size();
+		size += last_sa.bit_size();
+		size += phi_positions.bit_size();
+		size += phi_values.bit_size();
+
+		return size;
+
+	}
+
+	ulint serialize(ostream &out) const {
+
+		ulint w_bytes=0;
+
+		w_bytes += dyn_bwt::serialize(out);
+
+		w_bytes += heads.serialize(out);
+		w_bytes += first_sa.serialize(out);
+		w_bytes += last_sa.serialize(out);
+		w_bytes += phi_positions.serialize(out);
+		w_bytes += phi_values.serialize(out);
+
+		return w_bytes;
+
+	}
+
+	void load(istream &in){
+
+		dyn_bwt::load(in);
+
+		heads.load(in);
+		first_sa.load(in);
+		last_sa.load(in);
+		phi_positions.load(in);
+		phi_values.load(in);
+
+	}
+
+private:
+
+	/*
+	 * only the terminator: one run [0,0] with SA 0, no phi samples
+	 */
+	void init(){
+
+		heads.push_back(true);
+		first_sa.push_back(0);
+		last_sa.push_back(0);
+		phi_positions.push_back(false);
+
+	}
+
+	/*
+	 * occurrences in [l,r), given x = SA[r-1]
+	 */
+	vector<ulint> locate(pair<ulint,ulint> range, ulint x) const {
+
+		vector<ulint> res(range.second-range.first);
+
+		for(ulint j = res.size(); j > 0; --j){
+
+			res[j-1] = x;
+			if(j > 1) x = phi(x);
+
+		}
+
+		return res;
+
+	}
+
+	/*
+	 * SA[ISA[x]-1], x > 0
+	 */
+	ulint phi(ulint x) const {
+
+		ulint k = phi_positions.rank1(x+1);
+
+		assert(k>0);
+
+		return phi_values.at(k-1) + (x - phi_positions.select1(k-1));
+
+	}
+
+	/*
+	 * position v+1 must be sampled iff row i = ISA[v] starts a run. The
+	 * sample is SA[LF(i)-1]: LF(i)-1 is 0 or LF(k) with k ending a run
+	 * (as in extend)
+	 */
+	void update_phi_sample(ulint v, ulint i){
+
+		bool sampled = phi_positions.at(v+1);
+
+		if(heads.at(i) == sampled) return;
+
+		ulint k = phi_positions.rank1(v+1);
+
+		if(sampled){
+
+			phi_positions.remove(v+1);
+			phi_positions.insert(v+1,false);
+			phi_values.remove(k);
+
+		}else{
+
+			ulint j = this->LF(i)-1;
+
+			phi_positions.set(v+1);
+			phi_values.insert(k, j == 0 ? 0 : last_sa.at(run_of(this->FL(j))) + 1);
+
+		}
+
+	}
+
+	//index of the run containing row i
+	ulint run_of(ulint i) const {
+
+		return heads.rank1(i+1)-1;
+
+	}
+
+	//last row of run q
+	ulint run_end(ulint q) const {
+
+		return q+1 < first_sa.size() ? heads.select1(q+1)-1 : this->bwt_length()-1;
+
+	}
+
+	void insert_run(ulint q, ulint first, ulint last){
+
+		first_sa.insert(q,first);
+		last_sa.insert(q,last);
+
+	}
+
+	void remove_run(ulint q){
+
+		first_sa.remove(q);
+		last_sa.remove(q);
+
+	}
+
+	void clear_head(ulint i){
+
+		heads.remove(i);
+		heads.insert(i,false);
+
+	}
+
+	dyn_bv heads;		//heads[i] = 1 iff BWT row i starts a run (the terminator is a run)
+	dyn_vec first_sa;	//SA at the first row of each run
+	dyn_vec last_sa;	//SA at the last row of each run
+
+	dyn_bv phi_positions;	//sampled text positions of phi
+	dyn_vec phi_values;		//phi at the sampled positions
+
+};
+
+}
+
+#endif /* INCLUDE_INTERNAL_R_INDEX_HPP_ */
@@ -10,6 +10,13 @@
  *
  *  in the bitvectors, runs are encoded as 0^k1, k being the run length
  *
+ *  When the alphabet is bounded (constructors #2 and #3), characters smaller
+ *  than DENSE_SIGMA are remapped to slots 0,1,2,... in order of appearance and
+ *  their per-letter bitvectors are stored contiguously in a vector. Other
+ *  characters (and all characters with constructor #1) use a hash map.
+ *  The slot table is indexed by character and grows up to the largest
+ *  dense character seen: 4 bytes per entry, at most 1 KB per string.
+ *
  */
 
 #ifndef INCLUDE_INTERNAL_RLE_STRING_HPP_
@@ -52,6 +59,7 @@ public:
 		assert(sigma>0);
 
 		run_heads_ = string_t(sigma);
+		init_dense(sigma);
 
 	}
 
@@ -66,6 +74,7 @@ public:
 	rle_string(vector<pair<char_type,double> >& P){
 
 		run_heads_ = string_t(P);
+		init_dense(P.size());
 
 	}
 
@@ -97,10 +106,10 @@ public:
 		assert(run_heads_.char_exists(c));
 		assert(i < rank(size(),c));
 
-		ulint this_c_run = runs_per_letter.at(c).rank1(i);
+		ulint this_c_run = letter_runs(c).rank1(i);
 
 		//position of i-th c inside its c-run
-		ulint sel = i - ( this_c_run == 0 ? 0 : runs_per_letter.at(c).select1(this_c_run-1)+1 );
+		ulint sel = i - ( this_c_run == 0 ? 0 : letter_runs(c).select1(this_c_run-1)+1 );
 
 		//run number among all runs
 		ulint this_run = run_heads_.select(this_c_run, c);
@@ -157,16 +166,64 @@ public:
 					0 :
 					i - (this_run == 0 ? 0 : runs.select1(this_run-1)+1 );
 
-		assert(runs_per_letter.at(c).size()>0);
-		assert(this_c_run == 0 || this_c_run-1 < runs_per_letter.at(c).rank1(runs_per_letter.at(c).size()));
+		assert(letter_runs(c).size()>0);
+		assert(this_c_run == 0 || this_c_run-1 < letter_runs(c).rank1(letter_runs(c).size()));
 
 		//add also number of cs before this run (excluded)
-		rk += (this_c_run == 0 ? 0 : runs_per_letter.at(c).select1(this_c_run-1)+1 );
+		rk += (this_c_run == 0 ? 0 : letter_runs(c).select1(this_c_run-1)+1 );
 
 		return rk;
 
 	}
 
+	/*
+	 * rank(l,c) and rank(r,c) of each character c in positions [l,r), as
+	 * tuples <c, rank(l,c), rank(r,c)> in increasing order of character.
+	 *
+	 * The runs containing l and r, and the ranks of all characters among
+	 * the run heads (see wt_string::rank_all), are computed once: each
+	 * character then takes two selects on its c-runs bitvector
+	 */
+	vector<std::tuple<char_type,ulint,ulint> > rank_all(ulint l, ulint r) const {
+
+		assert(l<=r and r<=size());
+
+		vector<std::tuple<char_type,ulint,ulint> > res;
+
+		if(l == r) return res;
+
+		//runs containing l and r (run_r = number of runs if r = size())
+		ulint run_l = runs.rank1(l);
+		ulint run_r = runs.rank1(r);
+
+		//offsets of l and r in their runs
+		ulint off_l = l - (run_l == 0 ? 0 : runs.select1(run_l-1)+1);
+		ulint off_r = run_r == run_heads_.size() ? 0 : r - (run_r == 0 ? 0 : runs.select1(run_r-1)+1);
+
+		char_type head_l = run_heads_.at(run_l);
+		char_type head_r = off_r > 0 ? run_heads_.at(run_r) : 0;
+
+		//the characters of [l,r) are the heads of runs run_l, ..., run_r (if off_r > 0)
+		for(auto t : run_heads_.rank_all(run_l, off_r > 0 ? run_r+1 : run_r)){
+
+			char_type c = std::get<0>(t);
+			auto& c_runs = letter_runs(c);
+
+			//c-runs before run_l and before run_r
+			ulint k_l = std::get<1>(t);
+			ulint k_r = std::get<2>(t) - (off_r > 0 and head_r == c ? 1 : 0);
+
+			ulint rk_l = (k_l == 0 ? 0 : c_runs.select1(k_l-1)+1) + (head_l == c ? off_l : 0);
+			ulint rk_r = (k_r == 0 ? 0 : c_runs.select1(k_r-1)+1) + (off_r > 0 and head_r == c ? off_r : 0);
+
+			res.push_back(std::make_tuple(c,rk_l,rk_r));
+
+		}
+
+		return res;
+
+	}
+
 	/*
 	 * number of 0s before position i (only for bitvectors!)
 	 */
@@ -200,7 +257,7 @@ public:
 		if(size()==0){
 
 			assert(runs.size()==0);
-			assert(runs_per_letter[c].size()==0);
+			assert(letter_runs(c).size()==0);
 			assert(number_of_runs()==0);
 
 			runs.insert1(0);
@@ -208,14 +265,14 @@ public:
 
 			run_heads_.insert(0,c);
 
-			runs_per_letter[c].insert1(0);
-			runs_per_letter[c].insert0(0,k-1);
+			letter_runs(c).insert1(0);
+			letter_runs(c).insert0(0,k-1);
 
 			//increase length and number of runs
 			//n++;
 			//R++;
 
-			assert(runs_per_letter[c].size() > 0);
+			assert(letter_runs(c).size() > 0);
 			assert(at(i)==c);
 
 			assert( run_at( runs.rank1(i) ) == run_at( run_heads_.rank(runs.rank1(i),c), c ) );
@@ -242,7 +299,7 @@ public:
 		if(prev_equals_c or next_equals_c){
 
 			//since position i touches a c-run, this vector can not be empty
-			assert(runs_per_letter[c].size() > 0);
+			assert(letter_runs(c).size() > 0);
 
 			//c-run that is extended with a new c
 			ulint extended_run = ( prev_equals_c ? runs.rank1(i-1) : runs.rank1(i) );
@@ -261,13 +318,13 @@ public:
 			//the extended run is the number 'extended_c_run' among all c-runs
 			ulint extended_c_run = run_heads_.rank(extended_run,c);
 
-			assert(extended_c_run < runs_per_letter[c].rank1());
-			runs_per_letter[c].insert0(runs_per_letter[c].select1(extended_c_run), k);
+			assert(extended_c_run < letter_runs(c).rank1());
+			letter_runs(c).insert0(letter_runs(c).select1(extended_c_run), k);
 
 			//n++;
 			//R does not increase because c touches a c-run
 
-			assert(runs_per_letter[c].size() > 0);
+			assert(letter_runs(c).size() > 0);
 
 			assert( run_at( runs.rank1(i) ) == run_at( run_heads_.rank(runs.rank1(i),c), c ) );
 			return;
@@ -286,13 +343,13 @@ public:
 			runs.insert0(0,k-1);
 
 			run_heads_.insert(0,c);
-			runs_per_letter[c].insert1(0);
-			runs_per_letter[c].insert0(0,k-1);
+			letter_runs(c).insert1(0);
+			letter_runs(c).insert0(0,k-1);
 
 			//n++;
 			//R++;
 
-			assert(runs_per_letter[c].size() > 0);
+			assert(letter_runs(c).size() > 0);
 
 			assert( run_at( runs.rank1(i) ) == run_at( run_heads_.rank(runs.rank1(i),c), c ) );
 			return;
@@ -312,13 +369,13 @@ public:
 
 			run_heads_.insert(number_of_runs(),c);
 
-			runs_per_letter[c].insert0(runs_per_letter[c].size(), k-1);
-			runs_per_letter[c].insert1(runs_per_letter[c].size());
+			letter_runs(c).insert0(letter_runs(c).size(), k-1);
+			letter_runs(c).insert1(letter_runs(c).size());
 
 			//n++;
 			//R++;
 
-			assert(runs_per_letter[c].size() > 0);
+			assert(letter_runs(c).size() > 0);
 
 			assert( run_at( runs.rank1(i) ) == run_at( run_heads_.rank(runs.rank1(i),c), c ) );
 			return;
@@ -348,15 +405,15 @@ public:
 
 			ulint this_c_run = run_heads_.rank(rk,c);
 
-			auto ins_pos = this_c_run == 0 ? 0 : runs_per_letter[c].select1(this_c_run-1)+1;
+			auto ins_pos = this_c_run == 0 ? 0 : letter_runs(c).select1(this_c_run-1)+1;
 
-			runs_per_letter[c].insert1( ins_pos );
-			runs_per_letter[c].insert0( ins_pos, k-1 );
+			letter_runs(c).insert1( ins_pos );
+			letter_runs(c).insert0( ins_pos, k-1 );
 
 			//n++;
 			//R++;
 
-			assert(runs_per_letter[c].size() > 0);
+			assert(letter_runs(c).size() > 0);
 
 			assert( run_at( runs.rank1(i) ) == run_at( run_heads_.rank(runs.rank1(i),c), c ) );
 			return;
@@ -395,19 +452,19 @@ public:
 		run_heads_split(this_run,c);
 
 		//insert a 0^k1 in c-runs
-		auto ins_pos = this_c_run == 0 ? 0 : runs_per_letter[c].select1(this_c_run-1)+1;
-		runs_per_letter[c].insert1( ins_pos	);
-		runs_per_letter[c].insert0( ins_pos, k-1	);
+		auto ins_pos = this_c_run == 0 ? 0 : letter_runs(c).select1(this_c_run-1)+1;
+		letter_runs(c).insert1( ins_pos	);
+		letter_runs(c).insert0( ins_pos, k-1	);
 
 		//insert a 1 in a-runs
 		assert(a_rank>0);
-		runs_per_letter[prev].set(a_rank-1);
-		//runs_per_letter[prev].insert1(a_rank);
+		letter_runs(prev).set(a_rank-1);
+		//letter_runs(prev).insert1(a_rank);
 
 		//n++;
 		//R += 2;
 
-		assert(runs_per_letter[c].size() > 0);
+		assert(letter_runs(c).size() > 0);
 		assert( run_at( runs.rank1(i) ) == run_at( run_heads_.rank(runs.rank1(i),c), c ) );
 
 	}
@@ -424,6 +481,87 @@ public:
 
 	}
 
+	/*
+	 * append the runs <c,k> (k>0) in [first,last) at the end of the string.
+	 * Adjacent runs of the same character are merged (also with the last run
+	 * of the string). The input is processed in chunks of APPEND_CHUNK runs:
+	 * runs, run_heads_ and the per-letter bitvectors are extended in bulk,
+	 * without going through insert().
+	 */
+	template<class Iterator>
+	void append_runs(Iterator first, Iterator last){
+
+		vector<char_type> heads;
+		vector<ulint> lens;
+
+		//per-letter run lengths of the current chunk, in order of appearance
+		tsl::hopscotch_map<char_type, vector<ulint> > letter_lens;
+
+		//run currently being merged
+		char_type c = 0;
+		ulint k = 0;
+
+		auto flush = [&](){
+
+			if(heads.size() == 0) return;
+
+			runs.append_runs(lens.begin(), lens.end());
+			run_heads_.push_many(heads);
+
+			for(auto& e : letter_lens)
+				letter_runs(e.first).append_runs(e.second.begin(), e.second.end());
+
+			heads.clear();
+			lens.clear();
+			letter_lens.clear();
+
+		};
+
+		auto close_run = [&](){
+
+			if(k == 0) return;
+
+			if(heads.size() == 0 and size() > 0 and run_heads_.at(number_of_runs()-1) == c){
+
+				//extend the last run of the string: insert 0s before its closing 1
+				runs.insert0(runs.size()-1, k);
+				letter_runs(c).insert0(letter_runs(c).size()-1, k);
+
+			}else{
+
+				heads.push_back(c);
+				lens.push_back(k);
+				letter_lens[c].push_back(k);
+
+			}
+
+			if(heads.size() == APPEND_CHUNK) flush();
+
+		};
+
+		for(; first != last; ++first){
+
+			assert(first->second > 0);
+
+			if(k > 0 and first->first == c){
+
+				k += first->second;
+
+			}else{
+
+				close_run();
+				c = first->first;
+				k = first->second;
+
+			}
+
+		}
+
+		close_run();
+		flush();
+
+	}
+
 	//break range: given a range <l',r'> on the string and a character c, this function
 	//breaks <l',r'> in maximal sub-ranges containing character c.
 	//for simplicity and efficiency, we assume that characters at range extremities are both 'c'
@@ -509,8 +647,8 @@ public:
 	//length of i-th c-run
 	ulint run_at(ulint i, char_type c) const {
 
-		assert(i<runs_per_letter.at(c).rank1(runs_per_letter.at(c).size()));
-		return (i==0) + runs_per_letter.at(c).select1(i) - (i==0?0:runs_per_letter.at(c).select1(i-1));
+		assert(i<letter_runs(c).rank1(letter_runs(c).size()));
+		return (i==0) + letter_runs(c).select1(i) - (i==0?0:letter_runs(c).select1(i-1));
 
 	}
 
@@ -568,6 +706,10 @@ public:
 
 		}
 
+		size += dense_slot_.capacity()*sizeof(uint32_t)*8;
+
+		for(auto& bv : dense_runs_) size += bv.bit_size();
+
 		return size;
 
 	}
@@ -579,11 +721,24 @@ public:
 		w_bytes += runs.serialize(out);
 		w_bytes += run_heads_.serialize(out);
 
-		ulint rpl_size = runs_per_letter.size();
+		//dense and sparse letters are written in the same format: the
+		//receiving object decides where to store them when loading
+		ulint rpl_size = runs_per_letter.size() + dense_runs_.size();
 
 		out.write((char*)&rpl_size, sizeof(rpl_size));
 		w_bytes += sizeof(rpl_size);
 
+		for(char_type c = 0; c < dense_slot_.size(); ++c){
+
+			if(dense_slot_[c] == NO_SLOT) continue;
+
+			out.write((char*)&c,sizeof(c));
+			w_bytes += sizeof(c);
+
+			w_bytes += dense_runs_[dense_slot_[c]].serialize(out);
+
+		}
+
 		for(auto &e : runs_per_letter){
 
 			out.write((char*)&e.first,sizeof(e.first));
@@ -611,7 +766,7 @@ public:
 			char_type key;
 			in.read((char*)&key,sizeof(key));
 
-			runs_per_letter[key].load(in);
+			letter_runs(key).load(in);
 
 		}
 
@@ -619,6 +774,61 @@ public:
 
 private:
 
+	static const ulint APPEND_CHUNK = 1<<20;
+
+	static constexpr char_type DENSE_SIGMA = 256;
+	static constexpr uint32_t NO_SLOT = ~uint32_t(0);
+
+	/*
+	 * switch to dense mode: characters < DENSE_SIGMA get a slot in dense_runs_
+	 */
+	void init_dense(uint64_t sigma){
+
+		dense_ = true;
+		dense_runs_.reserve(std::min(sigma, uint64_t(DENSE_SIGMA)));
+
+	}
+
+	/*
+	 * bitvector storing the runs of letter c. c must exist
+	 */
+	const sparse_bitvector_t& letter_runs(char_type c) const {
+
+		if(dense_ and c < DENSE_SIGMA){
+
+			assert(c < dense_slot_.size() and dense_slot_[c] != NO_SLOT);
+			return dense_runs_[dense_slot_[c]];
+
+		}
+
+		return runs_per_letter.at(c);
+
+	}
+
+	/*
+	 * bitvector storing the runs of letter c. If c does not exist,
+	 * an empty bitvector is created
+	 */
+	sparse_bitvector_t& letter_runs(char_type c){
+
+		if(dense_ and c < DENSE_SIGMA){
+
+			if(c >= dense_slot_.size()) dense_slot_.resize(c+1, NO_SLOT);
+
+			if(dense_slot_[c] == NO_SLOT){
+
+				dense_slot_[c] = dense_runs_.size();
+				dense_runs_.push_back(sparse_bitvector_t());
+
+			}
+
+			return dense_runs_[dense_slot_[c]];
+
+		}
+
+		return runs_per_letter[c];
+
+	}
 
 	/*
 	 * split i-th run head: a -> aca
@@ -643,6 +853,11 @@ private:
 	//for each letter, its runs stored contiguously
     tsl::hopscotch_map<char_type,sparse_bitvector_t> runs_per_letter;
 
+	//dense mode: runs of letter c < DENSE_SIGMA are dense_runs_[dense_slot_[c]]
+	bool dense_ = false;
+	vector<uint32_t> dense_slot_;
+	vector<sparse_bitvector_t> dense_runs_;
+
 	//store run heads in a compressed string supporting access/rank/select/insert
 	string_t run_heads_;
 
@@ -38,6 +38,11 @@
  *											frees the memory of V[k'']
  *										3.3 Otherwise, do nothing.
  *
+ *	V.update_intervals(U) :		apply V.update_interval(j,k,{l,r}) for each (j,k,{l,r}) in U. Intervals
+ *								must be sorted and pairwise disjoint.
+ *
+ *	for(auto e : V) :			iterate over the pairs (i, V[i]) such that V[i] != NIL, by increasing i
+ *
  */
 
 #ifndef INCLUDE_INTERNAL_SPARSE_VECTOR_HPP_
@@ -55,7 +60,7 @@ public:
 
 	sv_reference(Container &c, uint64_t idx): _sv(c), _idx(idx) {}
 
-    operator uint64_t() {
+    operator uint64_t() const {
         return _sv.at(_idx);
     }
 
@@ -118,11 +123,11 @@ public:
 	/*
 	 * return i-th element
 	 */
-	ulint at(ulint i){
+	ulint at(ulint i) const {
 
 		assert(i<size());
 
-		return bv_[i] ? spsi_[bv_.rank1(i)] : NIL;
+		return bv_[i] ? spsi_.at(bv_.rank1(i)) : NIL;
 
 	}
 
@@ -155,7 +160,7 @@ public:
 	 * number of non-NIL elements before position i
 	 * excluded
 	 */
-	ulint rank(ulint i){
+	ulint rank(ulint i) const {
 
 		assert(i<=size());
 		return bv_.rank1(i);
@@ -189,7 +194,7 @@ public:
 	/*
 	 * true iff there exists a non-NIL integer in the input range [l,r)
 	 */
-	bool exists_non_NIL(pair<ulint,ulint> range){
+	bool exists_non_NIL(pair<ulint,ulint> range) const {
 
 		auto l = range.first;
 		auto r = range.second;
@@ -205,7 +210,7 @@ public:
 	 * Otherwise, returns V[i], where l <= i < r is the smallest index
 	 * such that V[i] != NIL
 	 */
-	ulint find_non_NIL(pair<ulint,ulint> range){
+	ulint find_non_NIL(pair<ulint,ulint> range) const {
 
 		auto l = range.first;
 		auto r = range.second;
@@ -217,7 +222,7 @@ public:
 
 		bool exists = r <= l ? false : bv_.rank1(r) - rl > 0;
 
-		return exists ? spsi_[rl] : NIL;
+		return exists ? spsi_.at(rl) : NIL;
 
 	}
 
@@ -296,31 +301,202 @@ public:
 
 	}
 
-	ulint size(){
+	/*
+	 * apply update_interval(j,k,{l,r}) for each tuple (j,k,{l,r}) in U.
+	 * The intervals must be sorted and pairwise disjoint.
+	 *
+	 * Large batches are applied in one left-to-right scan of the non-NIL
+	 * elements, after which the structure is rebuilt in bulk (see
+	 * gap_bitvector::append_runs and spsi::push_many)
+	 */
+	void update_intervals(const vector<tuple<ulint,ulint,pair<ulint,ulint> > >& U){
+
+		//few updates: not worth a rebuild
+		if(U.size()*BATCH_RATIO < number_of_nonNIL_elements()){
+
+			for(auto& u : U) update_interval(get<0>(u),get<1>(u),get<2>(u));
+			return;
+
+		}
+
+		//positions and values of the non-NIL elements after the updates
+		vector<ulint> pos;
+		vector<ulint> val;
+
+		pos.reserve(number_of_nonNIL_elements()+U.size());
+		val.reserve(number_of_nonNIL_elements()+U.size());
+
+		auto it = begin();
+		auto e = end();
+
+		for(ulint i=0;i<U.size();++i){
+
+			ulint j = get<0>(U[i]);
+			ulint k = get<1>(U[i]);
+			ulint l = get<2>(U[i]).first;
+			ulint r = get<2>(U[i]).second;
+
+			assert(r>l);
+			assert(r<=size());
+			assert(k>=l and k<r);
+			assert(j != NIL);
+			assert(i==0 or get<2>(U[i-1]).second <= l);
+
+			for(;it != e and (*it).first < l; ++it){
+				pos.push_back((*it).first);
+				val.push_back((*it).second);
+			}
+
+			//non-NIL elements inside [l,r)
+			ulint first = pos.size();
+
+			for(;it != e and (*it).first < r; ++it){
+				pos.push_back((*it).first);
+				val.push_back((*it).second);
+			}
+
+			ulint nr = pos.size() - first;
+
+			if(nr == 0){
+
+				pos.push_back(k);
+				val.push_back(j);
+
+			}else if(nr == 1){
+
+				//set(k,j)
+				if(pos[first] == k){
+
+					val[first] = j;
+
+				}else if(pos[first] < k){
+
+					pos.push_back(k);
+					val.push_back(j);
+
+				}else{
+
+					pos.insert(pos.begin()+first,k);
+					val.insert(val.begin()+first,j);
+
+				}
+
+			}else if(k <= pos[first]){
+
+				pos[first] = k;
+				val[first] = j;
+
+			}else if(k >= pos.back()){
+
+				pos.back() = k;
+				val.back() = j;
+
+			}
+
+		}
+
+		for(;it != e; ++it){
+			pos.push_back((*it).first);
+			val.push_back((*it).second);
+		}
+
+		//rebuild: run lengths of the form 0^x 1
+		ulint n = size();
+
+		for(ulint i=pos.size();i>0;--i)
+			pos[i-1] = pos[i-1] - (i==1 ? 0 : pos[i-2]+1) + 1;
+
+		gap_bv_type bv;
+		bv.append_runs(pos.begin(),pos.end());
+		bv.insert0(bv.size(), n - bv.size());
+
+		spsi_type sp;
+		sp.push_many(val.begin(),val.end());
+
+		bv_ = std::move(bv);
+		spsi_ = std::move(sp);
+
+		assert(size() == n);
+
+	}
+
+	/*
+	 * forward iterator over the pairs (i, V[i]) such that V[i] != NIL,
+	 * by increasing i. Amortized O(1) per element. Invalidated by any
+	 * modification of the vector
+	 */
+	class const_iterator{
+
+	public:
+
+		typedef std::forward_iterator_tag iterator_category;
+		typedef pair<ulint,ulint> value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const pair<ulint,ulint>* pointer;
+		typedef pair<ulint,ulint> reference;
+
+		pair<ulint,ulint> operator*() const { return {*ones_, *vals_}; }
+
+		const_iterator& operator++(){ ++ones_; ++vals_; return *this; }
+		const_iterator operator++(int){ auto tmp = *this; ++*this; return tmp; }
+
+		bool operator==(const const_iterator& o) const { return ones_ == o.ones_; }
+		bool operator!=(const const_iterator& o) const { return ones_ != o.ones_; }
+
+	private:
+
+		friend class sparse_vector;
+
+		typename gap_bv_type::ones_iterator ones_;
+		typename spsi_type::const_iterator vals_;
+
+	};
+
+	/*
+	 * iterator to the first non-NIL element at position >= i
+	 */
+	const_iterator lower_bound(ulint i) const {
+
+		assert(i<=size());
+
+		ulint r = bv_.rank1(i);
+
+		const_iterator it;
+		it.ones_ = bv_.ones_from(r);
+		it.vals_ = spsi_.iterator_at(r);
+
+		return it;
+
+	}
+
+	const_iterator begin() const { return lower_bound(0); }
+	const_iterator end() const { return lower_bound(size()); }
+
+	ulint size() const {
 		return bv_.size();
 	}
 
-	ulint number_of_nonNIL_elements(){
+	ulint number_of_nonNIL_elements() const {
 		return spsi_.size();
 	}
 
 	/*
 	 * get value of NIL
 	 */
-	ulint get_NIL(){
+	ulint get_NIL() const {
 		return NIL;
 	}
 
 	/*
 	 * Total number of bits allocated in RAM for this structure
 	 */
-	ulint bit_size(){
+	ulint bit_size() const {
 
 		return sizeof(sparse_vector<spsi_type, gap_bv_type>)*8 + spsi_.bit_size() + bv_.bit_size();
 
 	}
 
-	ulint serialize(ostream &out){
+	ulint serialize(ostream &out) const {
 
 		ulint w_bytes=0;
 
@@ -345,6 +521,9 @@ public:
 
 private:
 
+	//update_intervals rebuilds the structure if |U|*BATCH_RATIO >= number of non-NIL elements
+	static constexpr ulint BATCH_RATIO = 64;
+
 	ulint NIL;
 	spsi_type spsi_;
 	gap_bv_type bv_;
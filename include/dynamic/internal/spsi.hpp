@@ -114,7 +114,7 @@ class spsi {
   /*
    * move constructor
    */
-  spsi(spsi&& sp) { root = sp.root; sp.root = NULL; }
+  spsi(spsi&& sp) noexcept { root = sp.root; sp.root = NULL; }
 
   /*
    * copy assignment
@@ -129,9 +129,14 @@ class spsi {
   /*
    * move assignment
    */
-  void operator=(spsi&& sp) {
-    root->free_mem();
-    delete root;
+  void operator=(spsi&& sp) noexcept {
+    if (this == &sp) return;
+
+    // a moved-from spsi has no root
+    if (root) {
+      root->free_mem();
+      delete root;
+    }
 
     root = sp.root;
     sp.root = NULL;
@@ -232,6 +237,74 @@ class spsi {
 
   void push_back(uint64_t x) { insert(size(), x); }
 
+  /*
+   * append the integers in [first,last). Short ranges fill the last leaf in
+   * one descent, and split it with one push_back when it is full; otherwise
+   * the last leaf is filled, new leaves are filled left to right and the
+   * internal levels are rebuilt bottom-up (no root-to-leaf descents).
+   * Iterator must be a forward iterator.
+   */
+  template <class Iterator>
+  void push_many(Iterator first, Iterator last) {
+    uint64_t n = std::distance(first, last);
+
+    if (n == 0) return;
+
+    // the rebuild visits all existing leaves: not worth it for few integers
+    if (n * B_LEAF < size()) {
+      while (first != last) {
+        first = root->push_tail(first, last);
+        if (first != last) push_back(*first++);
+      }
+      return;
+    }
+
+    vector<leaf_type*> leaves;
+    root->release_leaves(leaves);
+    delete root;
+    root = NULL;
+
+    // fill the last leaf
+    leaf_type* tail = leaves.back();
+    while (first != last && tail->size() < 2 * B_LEAF) tail->push_back(*first++);
+
+    // new leaves are full. The last two are materialized only at the end,
+    // so that they can be balanced (both must contain at least B_LEAF integers)
+    vector<uint64_t> buf;
+    buf.reserve(4 * B_LEAF);
+
+    while (first != last) {
+      buf.push_back(*first++);
+
+      if (buf.size() == 4 * B_LEAF) {
+        leaves.push_back(new_leaf(buf.begin(), buf.begin() + 2 * B_LEAF));
+        buf.erase(buf.begin(), buf.begin() + 2 * B_LEAF);
+      }
+    }
+
+    // a short remainder is balanced with the previous leaf, which is full
+    if (buf.size() > 0 && buf.size() < B_LEAF) {
+      leaf_type* prev = leaves.back();
+      assert(prev->size() == 2 * B_LEAF);
+
+      uint64_t m = (prev->size() - buf.size()) / 2;
+
+      buf.insert(buf.begin(), m, 0);
+      for (uint64_t j = 0; j < m; ++j) buf[j] = prev->at(prev->size() - m + j);
+      for (uint64_t j = 0; j < m; ++j) prev->remove(prev->size() - 1);
+    }
+
+    if (buf.size() > 2 * B_LEAF) {
+      auto half = buf.begin() + buf.size() / 2;
+      leaves.push_back(new_leaf(buf.begin(), half));
+      leaves.push_back(new_leaf(half, buf.end()));
+    } else if (buf.size() > 0) {
+      leaves.push_back(new_leaf(buf.begin(), buf.end()));
+    }
+
+    root = node::build(std::move(leaves));
+  }
+
   void push_word(uint64_t x, uint8_t width, uint8_t n) {
     assert(n);
     assert(n * width <= sizeof(x) * 8);
@@ -270,6 +343,28 @@ class spsi {
     }
   }
 
+  /*
+   * bitvector leaves only: insert the n bits packed (least significant bit
+   * first) in words at position i. Each leaf takes at once, in one descent,
+   * as many of them as it has room for; a full leaf is split by inserting
+   * the next (up to) 64 bits through insert_word
+   */
+  void insert_bits(uint64_t i, const vector<uint64_t>& words, uint64_t n) {
+    assert(i <= size());
+    assert(words.size() * 64 >= n);
+
+    for (uint64_t j = 0; j < n;) {
+      uint64_t k = root->insert_run(i + j, words, j, n - j);
+
+      if (k == 0) {
+        k = std::min<uint64_t>(64, n - j);
+        insert_word(i + j, leaf_type::get_bits(words, j, k), 1, k);
+      }
+
+      j += k;
+    }
+  }
+
   /*
    * remove the integer x at position i
    */
@@ -281,6 +376,25 @@ class spsi {
     }
   }
 
+  /*
+   * remove the n integers in positions [i, i+n). Each leaf loses at once as
+   * many of them as it can spare; the others go through remove(i)
+   */
+  void remove_range(uint64_t i, uint64_t n) {
+    assert(i + n <= size());
+
+    while (n > 0) {
+      uint64_t k = root->remove_run(i, n);
+
+      if (k == 0) {
+        remove(i);
+        k = 1;
+      }
+
+      n -= k;
+    }
+  }
+
   /*
    * return number of integers stored in the structure
    */
@@ -317,6 +431,40 @@ class spsi {
     return root->at(i);
   }
 
+  /*
+   * smallest j >= i such that I_j > 0 (on bitvectors: the next bit set), or
+   * size() if there is none. Subtrees with null partial sum are skipped, and
+   * the leaves are scanned word by word
+   */
+  uint64_t next1(uint64_t i) const {
+    return i >= size() ? size() : root->template next<true>(i);
+  }
+
+  /*
+   * bitvectors only: smallest j >= i such that the j-th bit is not set, or
+   * size() if there is none
+   */
+  uint64_t next0(uint64_t i) const {
+    return i >= size() ? size() : root->template next<false>(i);
+  }
+
+  /*
+   * largest j <= i such that I_j > 0, or size() if there is none
+   */
+  uint64_t prev1(uint64_t i) const {
+    assert(i < size());
+    return root->prev1(i);
+  }
+
+  /*
+   * call f(j) for each l <= j < r such that I_j > 0, by increasing j
+   */
+  template <class F>
+  void for_each_one(uint64_t l, uint64_t r, F f) const {
+    assert(r <= size());
+    if (l < r) root->for_each_one(l, r, f, 0);
+  }
+
   /*
    * decrement/increment i-th integer by delta units
    */
@@ -352,6 +500,181 @@ class spsi {
 
  private:
   class node;
+
+ public:
+  /*
+   * forward iterator over the integers. Leaves are visited left to right
+   * keeping the root-to-leaf path, so a scan costs amortized O(1) per
+   * integer. Invalidated by any modification of the structure
+   */
+  class const_iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef uint64_t value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const uint64_t* pointer;
+    typedef uint64_t reference;
+
+    uint64_t operator*() const {
+      assert(leaf_ != NULL);
+      return leaf_->at(off_);
+    }
+
+    const_iterator& operator++() { return skip(1); }
+
+    /*
+     * advance k positions. k must not exceed the integers left in the
+     * current leaf (see contiguous())
+     */
+    const_iterator& skip(uint64_t k) {
+      assert(pos_ + k <= size_);
+      assert(k <= contiguous());
+
+      pos_ += k;
+      off_ += k;
+
+      if (off_ < leaf_->size()) return *this;
+
+      off_ = 0;
+
+      if (pos_ == size_) {
+        leaf_ = NULL;
+        return *this;
+      }
+
+      // climb until a node has a next child, then descend to its leftmost leaf
+      while (path_.back().second + 1 == path_.back().first->number_of_children())
+        path_.pop_back();
+
+      path_.back().second++;
+
+      while (not path_.back().first->has_leaves())
+        path_.push_back({path_.back().first->child(path_.back().second), 0});
+
+      leaf_ = path_.back().first->leaf(path_.back().second);
+
+      return *this;
+    }
+
+    /*
+     * number of integers left in the current leaf
+     */
+    uint64_t contiguous() const { return leaf_ == NULL ? 0 : leaf_->size() - off_; }
+
+    /*
+     * bitvector leaves only: read the next n <= 64 bits, packed in the n
+     * least significant bits of the result, and advance n positions
+     */
+    uint64_t read_bits(uint8_t n) {
+      assert(n <= 64 and pos_ + n <= size_);
+
+      uint64_t x = 0;
+
+      for (uint8_t done = 0; done < n;) {
+        uint8_t k = std::min<uint64_t>(n - done, contiguous());
+        x |= leaf_->get_bits(off_, k) << done;
+        done += k;
+        skip(k);
+      }
+
+      return x;
+    }
+
+    const_iterator operator++(int) {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    bool operator==(const const_iterator& o) const { return pos_ == o.pos_; }
+    bool operator!=(const const_iterator& o) const { return pos_ != o.pos_; }
+
+    /*
+     * index of the current integer
+     */
+    uint64_t position() const { return pos_; }
+
+   private:
+    friend class spsi;
+
+    vector<pair<const node*, uint32_t>> path_;
+    const leaf_type* leaf_ = NULL;
+    uint64_t off_ = 0;  // offset inside the current leaf
+    uint64_t pos_ = 0;
+    uint64_t size_ = 0;
+  };
+
+  /*
+   * iterator pointing to the i-th integer (i = size() gives end())
+   */
+  const_iterator iterator_at(uint64_t i) const {
+    assert(i <= size());
+
+    const_iterator it;
+    it.pos_ = i;
+    it.size_ = size();
+
+    if (i == size()) return it;
+
+    it.off_ = root->find_leaf(i, it.path_);
+    it.leaf_ = it.path_.back().first->leaf(it.path_.back().second);
+
+    return it;
+  }
+
+  const_iterator begin() const { return iterator_at(0); }
+  const_iterator end() const { return iterator_at(size()); }
+
+  /*
+   * bitvector leaves only: replace the content with the n bits packed (least
+   * significant bit first) in words. Leaves are built directly from the
+   * words, and are filled up to 2*B_LEAF bits
+   */
+  void assign_bits(const vector<uint64_t>& words, uint64_t n) {
+    assert(words.size() * 64 >= n);
+
+    root->free_mem();
+    delete root;
+
+    if (n == 0) {
+      root = new node();
+      return;
+    }
+
+    uint64_t nr_words = n / 64 + (n % 64 != 0);
+    uint64_t nr_leaves = n / (2 * B_LEAF) + (n % (2 * B_LEAF) != 0);
+
+    vector<leaf_type*> leaves(nr_leaves);
+
+    // leaves get the same number of words, up to 1. They are independent,
+    // so they are filled in parallel
+    #pragma omp parallel for
+    for (uint64_t g = 0; g < nr_leaves; ++g) {
+      uint64_t len = nr_words / nr_leaves + (g < nr_words % nr_leaves);
+      uint64_t w = g * (nr_words / nr_leaves) + std::min(g, nr_words % nr_leaves);
+      uint64_t bits = std::min(64 * len, n - 64 * w);
+
+      vector<uint64_t> lw(len + 2, 0);
+      std::copy(words.begin() + w, words.begin() + w + len, lw.begin());
+
+      if (bits % 64) lw[len - 1] &= (uint64_t(1) << (bits % 64)) - 1;
+
+      leaves[g] = new leaf_type(std::move(lw), bits);
+    }
+
+    root = node::build(std::move(leaves));
+
+    assert(size() == n);
+  }
+
+ private:
+  template <class Iterator>
+  static leaf_type* new_leaf(Iterator first, Iterator last) {
+    auto l = new leaf_type();
+    while (first != last) l->push_back(*first++);
+    return l;
+  }
+
   node* root = NULL;  // tree root
 };
 
@@ -499,6 +822,49 @@ class spsi<leaf_type, B_LEAF, B>::node {
     return bs;
   }
 
+  /*
+   * build a tree on top of the given leaves (which must respect the
+   * B_LEAF <= m <= 2*B_LEAF bounds, except if there is only one leaf).
+   * Internal nodes get between B+1 and 2B+2 children. Returns the root
+   */
+  static node* build(vector<leaf_type*>&& l) {
+    assert(l.size() > 0);
+
+    vector<node*> level;
+
+    for (auto& g : split_evenly(l)) level.push_back(new node(std::move(g)));
+
+    while (level.size() > 1) {
+      vector<node*> up;
+
+      for (auto& g : split_evenly(level)) up.push_back(new node(std::move(g)));
+
+      level = std::move(up);
+    }
+
+    return level[0];
+  }
+
+  /*
+   * append to l all leaves of the subtree rooted in this node (left to
+   * right) and delete all internal nodes below this node. This node is
+   * left without children
+   */
+  void release_leaves(vector<leaf_type*>& l) {
+    if (has_leaves()) {
+      for (uint32_t i = 0; i < nr_children; ++i) l.push_back(leaves[i]);
+    } else {
+      for (uint32_t i = 0; i < nr_children; ++i) {
+        children[i]->release_leaves(l);
+        delete children[i];
+      }
+    }
+
+    leaves.clear();
+    children.clear();
+    nr_children = 0;
+  }
+
   bool has_leaves() const { return has_leaves_; }
 
   void free_mem() {
@@ -757,6 +1123,33 @@ class spsi<leaf_type, B_LEAF, B>::node {
    */
   bool can_lose() const { return (nr_children >= (B + 2) || (is_root())); }
 
+  /*
+   * append integers of [first,last) to the last leaf until it is full, in
+   * one descent. Returns the first integer not appended
+   */
+  template <class Iterator>
+  Iterator push_tail(Iterator first, Iterator last) {
+    uint32_t k = nr_children - 1;
+
+    uint64_t si = has_leaves_ ? leaves[k]->size() : children[k]->size();
+    uint64_t ps = has_leaves_ ? leaves[k]->psum() : children[k]->psum();
+
+    if (has_leaves_) {
+      leaf_type* l = leaves[k];
+      while (first != last && l->size() < 2 * B_LEAF) l->push_back(*first++);
+
+      subtree_sizes[k] += l->size() - si;
+      subtree_psums[k] += l->psum() - ps;
+    } else {
+      first = children[k]->push_tail(first, last);
+
+      subtree_sizes[k] += children[k]->size() - si;
+      subtree_psums[k] += children[k]->psum() - ps;
+    }
+
+    return first;
+  }
+
   bool leaf_can_lose(leaf_type* leaf) const {
     return (leaf->size() >= (B_LEAF + 1));
   }
@@ -1180,9 +1573,11 @@ class spsi<leaf_type, B_LEAF, B>::node {
           // 2B_LEAF
 
           if (y_is_prev) {
-            for (size_t ii = 0; ii < y->size(); ++ii) {
-              x->insert(0, y->at(y->size() - 1 - ii));
-            }
+            // rebuild x by appending, rather than inserting at its front
+            leaf_type t;
+            for (size_t ii = 0; ii < y->size(); ++ii) t.push_back(y->at(ii));
+            for (size_t ii = 0; ii < x->size(); ++ii) t.push_back(x->at(ii));
+            *x = std::move(t);
 
             assert(x->size() == 2 * B_LEAF);
 
@@ -1267,6 +1662,137 @@ class spsi<leaf_type, B_LEAF, B>::node {
     return new_root;
   }
 
+  /*
+   * bitvector leaves only: insert at position i up to k bits of words,
+   * starting at bit off, into the leaf containing i only and without
+   * splitting it. Return the number of inserted bits
+   */
+  uint64_t insert_run(uint64_t i, const vector<uint64_t>& words, uint64_t off,
+                      uint64_t k) {
+    assert(i <= size());
+
+    uint32_t j = nr_children - 1;
+    if (i < size()) j = find_child(i);
+
+    uint64_t pos = i - (j == 0 ? 0 : subtree_sizes[j - 1]);
+    uint64_t inserted, ps;
+
+    if (has_leaves()) {
+      leaf_type* x = leaves[j];
+
+      inserted = std::min<uint64_t>(k, free_capacity(*x));
+      if (inserted == 0) return 0;
+
+      ps = x->psum();
+      x->insert_bits(pos, words, off, inserted);
+      ps = x->psum() - ps;
+
+    } else {
+      ps = children[j]->psum();
+      inserted = children[j]->insert_run(pos, words, off, k);
+      ps = children[j]->psum() - ps;
+    }
+
+    for (uint32_t h = j; h < nr_children; ++h) {
+      subtree_sizes[h] += inserted;
+      subtree_psums[h] += ps;
+    }
+
+    return inserted;
+  }
+
+  /*
+   * remove up to k integers starting at position i, from the leaf containing
+   * i only, and without rebalancing: the leaf keeps at least B_LEAF integers
+   * (unless it is the only one). Return the number of removed integers
+   */
+  uint64_t remove_run(uint64_t i, uint64_t k) {
+    assert(i < size());
+
+    uint32_t j = find_child(i);
+    uint64_t pos = i - (j == 0 ? 0 : subtree_sizes[j - 1]);
+    uint64_t removed, ps;
+
+    if (has_leaves()) {
+      leaf_type* x = leaves[j];
+
+      // a leaf that cannot lose integers first takes those an adjacent
+      // sibling can spare, all at once
+      if (nr_children > 1 and not leaf_can_lose(x) and k > 1) {
+        refill_leaf(j);
+        pos = i - (j == 0 ? 0 : subtree_sizes[j - 1]);
+      }
+
+      uint64_t spare = nr_children == 1 ? x->size() : x->size() - std::min<uint64_t>(x->size(), B_LEAF);
+
+      removed = std::min(k, std::min(x->size() - pos, spare));
+      if (removed == 0) return 0;
+
+      ps = x->psum();
+      x->remove_range(pos, removed);
+      ps -= x->psum();
+
+    } else {
+      ps = children[j]->psum();
+      removed = children[j]->remove_run(pos, k);
+      ps -= children[j]->psum();
+    }
+
+    for (uint32_t h = j; h < nr_children; ++h) {
+      subtree_sizes[h] -= removed;
+      subtree_psums[h] -= ps;
+    }
+
+    return removed;
+  }
+
+  /*
+   * move to leaf j the integers that an adjacent sibling leaf can spare
+   * (those beyond B_LEAF): the first ones of the next sibling or, for the
+   * last leaf, the last ones of the previous sibling
+   */
+  void refill_leaf(uint32_t j) {
+    assert(has_leaves() and nr_children > 1);
+
+    leaf_type* x = leaves[j];
+    bool from_next = j + 1 < nr_children;
+    leaf_type* y = from_next ? leaves[j + 1] : leaves[j - 1];
+
+    if (not leaf_can_lose(y)) return;
+
+    uint64_t s = std::min<uint64_t>(y->size() - B_LEAF, 2 * B_LEAF - x->size());
+    uint64_t ps = 0;
+
+    if (from_next) {
+      for (uint64_t h = 0; h < s; ++h) {
+        uint64_t z = y->at(h);
+        x->push_back(z);
+        ps += z;
+      }
+      y->remove_range(0, s);
+
+      subtree_sizes[j] += s;
+      subtree_psums[j] += ps;
+
+    } else {
+      // rebuild x by appending, rather than inserting at its front
+      leaf_type t;
+
+      for (uint64_t h = y->size() - s; h < y->size(); ++h) {
+        uint64_t z = y->at(h);
+        t.push_back(z);
+        ps += z;
+      }
+      for (uint64_t h = 0; h < x->size(); ++h) t.push_back(x->at(h));
+
+      *x = std::move(t);
+      y->remove_range(y->size() - s, s);
+
+      subtree_sizes[j - 1] -= s;
+      subtree_psums[j - 1] -= ps;
+    }
+  }
+
   uint32_t rank() const { return rank_; }
 
   void overwrite_rank(uint32_t r) { rank_ = r; }
@@ -1281,7 +1807,120 @@ class spsi<leaf_type, B_LEAF, B>::node {
 
   void overwrite_parent(node* P) { parent = P; }
 
-  uint32_t number_of_children() { return nr_children; }
+  uint32_t number_of_children() const { return nr_children; }
+
+  const node* child(uint32_t j) const {
+    assert(not has_leaves() and j < nr_children);
+    return children[j];
+  }
+
+  const leaf_type* leaf(uint32_t j) const {
+    assert(has_leaves() and j < nr_children);
+    return leaves[j];
+  }
+
+  /*
+   * smallest j >= i such that I_j > 0 (b = true) or such that the j-th bit
+   * is 0 (b = false, bitvectors only). Returns size() if there is none
+   */
+  template <bool b>
+  uint64_t next(uint64_t i) const {
+    assert(i < size());
+
+    for (uint32_t j = find_child(i); j < nr_children; ++j) {
+      uint64_t previous_size = (j == 0 ? 0 : subtree_sizes[j - 1]);
+      uint64_t previous_psum = (j == 0 ? 0 : subtree_psums[j - 1]);
+
+      uint64_t len = subtree_sizes[j] - previous_size;
+      uint64_t ones = subtree_psums[j] - previous_psum;
+
+      // no candidates in this subtree
+      if ((b ? ones : len - ones) == 0) continue;
+
+      uint64_t from = i > previous_size ? i - previous_size : 0;
+      uint64_t k;
+
+      if (has_leaves()) {
+        if constexpr (b)
+          k = leaves[j]->next1(from);
+        else
+          k = leaves[j]->next0(from);
+      } else {
+        k = children[j]->template next<b>(from);
+      }
+
+      if (k < len) return previous_size + k;
+    }
+
+    return size();
+  }
+
+  /*
+   * largest j <= i such that I_j > 0, or size() if there is none
+   */
+  uint64_t prev1(uint64_t i) const {
+    assert(i < size());
+
+    for (uint32_t j = find_child(i) + 1; j > 0; --j) {
+      uint64_t previous_size = (j == 1 ? 0 : subtree_sizes[j - 2]);
+      uint64_t previous_psum = (j == 1 ? 0 : subtree_psums[j - 2]);
+
+      uint64_t len = subtree_sizes[j - 1] - previous_size;
+
+      if (subtree_psums[j - 1] == previous_psum) continue;
+
+      uint64_t to = std::min(i - previous_size, len - 1);
+      uint64_t k = has_leaves() ? leaves[j - 1]->prev1(to)
+                                : children[j - 1]->prev1(to);
+
+      if (k < len) return previous_size + k;
+    }
+
+    return size();
+  }
+
+  /*
+   * call f(base + j) for each l <= j < r such that I_j > 0
+   */
+  template <class F>
+  void for_each_one(uint64_t l, uint64_t r, F& f, uint64_t base) const {
+    assert(l < r and r <= size());
+
+    for (uint32_t j = find_child(l); j < nr_children; ++j) {
+      uint64_t previous_size = (j == 0 ? 0 : subtree_sizes[j - 1]);
+      uint64_t previous_psum = (j == 0 ? 0 : subtree_psums[j - 1]);
+
+      if (previous_size >= r) break;
+      if (subtree_psums[j] == previous_psum) continue;
+
+      uint64_t lo = l > previous_size ? l - previous_size : 0;
+      uint64_t hi = std::min(r, subtree_sizes[j]) - previous_size;
+
+      if (has_leaves()) {
+        for (uint64_t k = leaves[j]->next1(lo); k < hi; k = leaves[j]->next1(k + 1))
+          f(base + previous_size + k);
+      } else {
+        children[j]->for_each_one(lo, hi, f, base + previous_size);
+      }
+    }
+  }
+
+  /*
+   * descend to the leaf containing the i-th integer, appending the visited
+   * (node, child) pairs to path. Returns the offset of i inside the leaf
+   */
+  uint64_t find_leaf(uint64_t i, vector<pair<const node*, uint32_t>>& path) const {
+    assert(i < size());
+
+    uint32_t j = find_child(i);
+    uint64_t previous_size = (j == 0 ? 0 : subtree_sizes[j - 1]);
+
+    path.push_back({this, j});
+
+    if (has_leaves()) return i - previous_size;
+
+    return children[j]->find_leaf(i - previous_size, path);
+  }
 
   ulint serialize(ostream& out) const {
     ulint w_bytes = 0;
@@ -1548,6 +2187,38 @@ class spsi<leaf_type, B_LEAF, B>::node {
       next->insert_word(insert_pos - leaf->size(), x, width, n);
     }
 
+    // the right half may be short of up to n integers: move them from the
+    // end of the left half, which has more than B_LEAF. They go in as one
+    // packed word when they fit in 64 bits. Conversely, the left half may be
+    // short if the split was uneven (leaves are split at a word boundary)
+    if (leaf->size() < B_LEAF) {
+      uint64_t m = B_LEAF - leaf->size();
+
+      for (uint64_t h = 0; h < m; ++h) leaf->push_back(next->at(h));
+      next->remove_range(0, m);
+
+    } else if (next->size() < B_LEAF) {
+      uint64_t m = B_LEAF - next->size();
+      uint64_t first = leaf->size() - m;
+      uint8_t w = 1;
+
+      for (uint64_t h = first; h < leaf->size(); ++h)
+        w = std::max<uint8_t>(w, 64 - __builtin_clzll(leaf->at(h) | 1));
+
+      if (m * w <= 64) {
+        uint64_t y = 0;
+        for (uint64_t h = 0; h < m; ++h) y |= leaf->at(first + h) << (h * w);
+
+        next->insert_word(0, y, w, m);
+      } else {
+        for (uint64_t h = leaf->size(); h > first; --h) next->insert(0, leaf->at(h - 1));
+      }
+
+      leaf->remove_range(first, m);
+    }
+
+    assert(leaf->size() >= B_LEAF and leaf->size() <= 2 * B_LEAF);
+
     return next;
   }
 
@@ -1659,6 +2330,26 @@ class spsi<leaf_type, B_LEAF, B>::node {
     return right;
   }
 
+  /*
+   * split v in the minimum number of groups of at most 2B+2 elements.
+   * Group sizes differ by at most 1, so they are at least B+1 if there
+   * is more than one group
+   */
+  template <class T>
+  static vector<vector<T>> split_evenly(const vector<T>& v) {
+    uint64_t k = v.size() / (2 * B + 2) + (v.size() % (2 * B + 2) != 0);
+
+    vector<vector<T>> groups(k);
+
+    for (uint64_t g = 0, i = 0; g < k; ++g) {
+      uint64_t len = v.size() / k + (g < v.size() % k);
+      groups[g] = vector<T>(v.begin() + i, v.begin() + i + len);
+      i += len;
+    }
+
+    return groups;
+  }
+
   static uint64_t free_capacity(const leaf_type& l) {
     assert(l.size() <= 2 * B_LEAF);
     return 2 * B_LEAF - l.size();
@@ -125,6 +125,48 @@ class succinct_bitvector {
         return (i == 0 ? 0 : spsi_.psum(i - 1));
     }
 
+    /*
+     * batched access and rank. Positions in [first, last) must be sorted
+     * increasingly and <= size(). Calls f(k, rank1(p), b) for the k-th
+     * position p, where b is the bit at p (false if p == size()).
+     * A position close to the previous one is reached by popcounting the
+     * bits in between with a sequential leaf cursor; a far one with a new
+     * tree search
+     */
+    template <class Iterator, class F>
+    void rank1_batch(Iterator first, Iterator last, F f) const {
+        // farther positions are cheaper to reach from the root
+        const uint64_t max_sweep = 1024;
+
+        typename spsi_type::const_iterator it;
+        uint64_t cur = 0;  // position of it
+        uint64_t r = 0;    // rank1(cur)
+        bool positioned = false;
+
+        for (uint64_t k = 0; first != last; ++first, ++k) {
+            const uint64_t p = *first;
+
+            assert(p <= size());
+            assert(not positioned or p >= cur);
+
+            if (not positioned or p - cur > max_sweep) {
+                r = rank1(p);
+                it = spsi_.iterator_at(p);
+                cur = p;
+                positioned = true;
+            } else {
+                for (; cur + 64 <= p; cur += 64) r += __builtin_popcountll(it.read_bits(64));
+
+                if (p > cur) {
+                    r += __builtin_popcountll(it.read_bits(p - cur));
+                    cur = p;
+                }
+            }
+
+            f(k, r, p < size() and *it);
+        }
+    }
+
     /*
      * total number of bits not set
      */
@@ -135,6 +177,32 @@ class succinct_bitvector {
      */
     uint64_t rank1() const { return rank1(size()); }
 
+    /*
+     * position of the first bit set at position >= i, or size() if there is
+     * none
+     */
+    uint64_t next1(uint64_t i) const { return spsi_.next1(i); }
+
+    /*
+     * position of the first bit not set at position >= i, or size() if there
+     * is none
+     */
+    uint64_t next0(uint64_t i) const { return spsi_.next0(i); }
+
+    /*
+     * position of the last bit set at position <= i, or size() if there is
+     * none
+     */
+    uint64_t prev1(uint64_t i) const { return spsi_.prev1(i); }
+
+    /*
+     * call f(j) for each bit set at position l <= j < r, by increasing j
+     */
+    template <class F>
+    void for_each_one(uint64_t l, uint64_t r, F f) const {
+        spsi_.for_each_one(l, r, f);
+    }
+
     /*
      * insert a bit b at position i
      */
@@ -180,11 +248,167 @@ class succinct_bitvector {
         return sizeof(succinct_bitvector<spsi_type>) * 8 + spsi_.bit_size();
     }
 
+    /*
+     * replace the content with the n bits packed (least significant bit
+     * first) in words
+     */
+    void assign_words(const vector<uint64_t> &words, uint64_t n) {
+        spsi_.assign_bits(words, n);
+    }
+
+    /*
+     * insert the n bits packed (least significant bit first) in words at
+     * position i, with one descent of the tree per leaf filled (see
+     * spsi::insert_bits)
+     */
+    void insert_words(uint64_t i, const vector<uint64_t> &words, uint64_t n) {
+        assert(i <= size());
+        assert(words.size() * 64 >= n);
+
+        spsi_.insert_bits(i, words, n);
+    }
+
+    /*
+     * remove the n bits in positions [i, i+n)
+     */
+    void remove_range(uint64_t i, uint64_t n) { spsi_.remove_range(i, n); }
+
+    /*
+     * set operations with another bitvector B (possibly with a different
+     * underlying spsi). Bits past the end of the shorter bitvector are
+     * treated as 0. The two bitvectors are read with leaf cursors 64 bits
+     * at a time, and combined in chunks of aligned words.
+     */
+
+    /*
+     * number of positions set in both bitvectors: popcount(A AND B)
+     */
+    template <class other_spsi>
+    uint64_t and_count(const succinct_bitvector<other_spsi> &B) const {
+        return count(B, std::min(size(), B.size()),
+                     [](uint64_t x, uint64_t y) { return x & y; });
+    }
+
+    /*
+     * popcount(A OR B)
+     */
+    template <class other_spsi>
+    uint64_t or_count(const succinct_bitvector<other_spsi> &B) const {
+        return count(B, std::max(size(), B.size()),
+                     [](uint64_t x, uint64_t y) { return x | y; });
+    }
+
+    /*
+     * popcount(A XOR B)
+     */
+    template <class other_spsi>
+    uint64_t xor_count(const succinct_bitvector<other_spsi> &B) const {
+        return count(B, std::max(size(), B.size()),
+                     [](uint64_t x, uint64_t y) { return x ^ y; });
+    }
+
+    /*
+     * out = A AND B. The result has length min(size(), B.size())
+     */
+    template <class other_spsi, class out_spsi>
+    void and_into(const succinct_bitvector<other_spsi> &B,
+                  succinct_bitvector<out_spsi> &out) const {
+        materialize(B, std::min(size(), B.size()), out,
+                    [](uint64_t x, uint64_t y) { return x & y; });
+    }
+
+    /*
+     * out = A OR B. The result has length max(size(), B.size())
+     */
+    template <class other_spsi, class out_spsi>
+    void or_into(const succinct_bitvector<other_spsi> &B,
+                 succinct_bitvector<out_spsi> &out) const {
+        materialize(B, std::max(size(), B.size()), out,
+                    [](uint64_t x, uint64_t y) { return x | y; });
+    }
+
+    /*
+     * out = A XOR B. The result has length max(size(), B.size())
+     */
+    template <class other_spsi, class out_spsi>
+    void xor_into(const succinct_bitvector<other_spsi> &B,
+                  succinct_bitvector<out_spsi> &out) const {
+        materialize(B, std::max(size(), B.size()), out,
+                    [](uint64_t x, uint64_t y) { return x ^ y; });
+    }
+
     ulint serialize(ostream &out) const { return spsi_.serialize(out); }
 
     void load(istream &in) { spsi_.load(in); }
 
    private:
+    template <class>
+    friend class succinct_bitvector;
+
+    // number of 64-bit words combined at a time by the set operations
+    static constexpr uint64_t CHUNK_WORDS = 64;
+
+    /*
+     * call f(c, nw) on consecutive chunks of nw words c[k] = op(A_k, B_k),
+     * where A_k and B_k are the k-th 64-bit words of the two bitvectors in
+     * the range [0,n). The op loop runs on plain arrays, so that the
+     * compiler can vectorize it
+     */
+    template <class other_spsi, class Op, class F>
+    void combine(const succinct_bitvector<other_spsi> &B, uint64_t n, Op op,
+                 F f) const {
+        auto ia = spsi_.begin();
+        auto ib = B.spsi_.begin();
+
+        uint64_t a[CHUNK_WORDS];
+        uint64_t b[CHUNK_WORDS];
+        uint64_t c[CHUNK_WORDS];
+
+        for (uint64_t i = 0; i < n; i += 64 * CHUNK_WORDS) {
+            uint64_t bits = std::min(64 * CHUNK_WORDS, n - i);
+            uint64_t nw = bits / 64 + (bits % 64 != 0);
+
+            for (uint64_t k = 0; k < nw; ++k) {
+                uint64_t p = i + 64 * k;
+
+                uint8_t na = p < size() ? std::min<uint64_t>(64, size() - p) : 0;
+                uint8_t nb = p < B.size() ? std::min<uint64_t>(64, B.size() - p) : 0;
+
+                a[k] = na ? ia.read_bits(na) : 0;
+                b[k] = nb ? ib.read_bits(nb) : 0;
+            }
+
+            for (uint64_t k = 0; k < nw; ++k) c[k] = op(a[k], b[k]);
+
+            f(c, nw);
+        }
+    }
+
+    template <class other_spsi, class Op>
+    uint64_t count(const succinct_bitvector<other_spsi> &B, uint64_t n,
+                   Op op) const {
+        uint64_t cnt = 0;
+
+        combine(B, n, op, [&cnt](const uint64_t *c, uint64_t nw) {
+            for (uint64_t k = 0; k < nw; ++k) cnt += __builtin_popcountll(c[k]);
+        });
+
+        return cnt;
+    }
+
+    template <class other_spsi, class out_spsi, class Op>
+    void materialize(const succinct_bitvector<other_spsi> &B, uint64_t n,
+                     succinct_bitvector<out_spsi> &out, Op op) const {
+        vector<uint64_t> words;
+        words.reserve(n / 64 + 1);
+
+        combine(B, n, op, [&words](const uint64_t *c, uint64_t nw) {
+            words.insert(words.end(), c, c + nw);
+        });
+
+        out.assign_words(words, n);
+    }
+
     // underlying Searchable partial sum with inserts structure.
     // the spsi contains only integers 0 and 1
     spsi_type spsi_;
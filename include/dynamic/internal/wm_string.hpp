@@ -92,37 +92,79 @@ public:
 
         n = array.size();
 
-        std::vector<ulint> v(array), b(array.size(), 0);
+        /*
+         * level by level: pack the i-th bits of v into words, then stably
+         * partition v by that bit for the next level. Both passes work on
+         * independent chunks of v, in parallel when OpenMP is enabled
+         */
+        const ulint nr_words = n / 64 + (n % 64 != 0);
+        const ulint chunk = 1 << 16;    // positions per chunk; multiple of 64
+        const ulint nr_chunks = n / chunk + (n % chunk != 0);
+
+        std::vector<ulint> v(array), temp(n);
+        std::vector<uint64_t> words(nr_words);
+        std::vector<ulint> zeros(nr_chunks + 1);
+
+        // no reallocation: it would copy the bitvectors built so far
+        bit_arrays.reserve(bit_width);
 
         for (ulint i = 0; i < bit_width; ++i) {
-
-            std::vector<ulint> temp;
-            // 0をtempにいれてく
-            for (ulint j = 0; j < v.size(); ++j) {
-                ulint c = v.at(j);
-                ulint bit = (c >> (bit_width - i - 1)) & 1;  //　上からi番目のbit
-                if (bit == 0) {
-                    temp.push_back(c);
-                    b[j] = 0;
+            const ulint shift = bit_width - i - 1;  // 上からi番目のbit
+
+            #pragma omp parallel for
+            for (ulint t = 0; t < nr_chunks; ++t) {
+                const ulint end = std::min(n, (t + 1) * chunk);
+                ulint z = 0;
+                for (ulint w = t * chunk / 64; w * 64 < end; ++w) {
+                    uint64_t word = 0;
+                    const ulint m = std::min<ulint>(64, end - w * 64);
+                    for (ulint j = 0; j < m; ++j) {
+                        word |= uint64_t((v[w * 64 + j] >> shift) & 1) << j;
+                    }
+                    words[w] = word;
+                    z += m - __builtin_popcountll(word);
                 }
+                zeros[t + 1] = z;
             }
 
-            this->begin_one.at(i) = temp.size();
+            // zeros[t] = number of 0s before chunk t
+            zeros[0] = 0;
+            for (ulint t = 0; t < nr_chunks; ++t) zeros[t + 1] += zeros[t];
+
+            this->begin_one.at(i) = zeros[nr_chunks];
 
-            // 1をtempにいれてく
-            for (ulint j = 0; j < v.size(); ++j) {
-                ulint c = v.at(j);
-                ulint bit = (c >> (bit_width - i - 1)) & 1;  //　上からi番目のbit
-                if (bit == 1) {
-                    temp.push_back(c);
-                    b[j] = 1;
+            dynamic_bitvector_t dbv;
+            dbv.assign_words(words, n);
+            bit_arrays.push_back(std::move(dbv));
+
+            if (i + 1 == bit_width) break;
+
+            // stable partition: 0s first, then 1s. Each chunk is compacted
+            // into a local buffer with unconditional stores (bits are
+            // typically random, branches would mispredict), then copied
+            #pragma omp parallel for
+            for (ulint t = 0; t < nr_chunks; ++t) {
+                const ulint begin = t * chunk;
+                const ulint m = std::min(n, begin + chunk) - begin;
+                std::vector<ulint> buf(m + 1);
+
+                ulint z = 0;
+                for (ulint j = 0; j < m; ++j) {
+                    buf[z] = v[begin + j];
+                    z += 1 - ((words[(begin + j) / 64] >> (j % 64)) & 1);
                 }
+                ulint o = z;
+                for (ulint j = 0; j < m; ++j) {
+                    buf[o] = v[begin + j];
+                    o += (words[(begin + j) / 64] >> (j % 64)) & 1;
+                }
+
+                std::copy(buf.begin(), buf.begin() + z, temp.begin() + zeros[t]);
+                std::copy(buf.begin() + z, buf.begin() + m,
+                          temp.begin() + zeros[nr_chunks] + begin - zeros[t]);
             }
 
-            dynamic_bitvector_t dbv;
-            for (auto& i : b) { dbv.push_back(i); }
-            bit_arrays.emplace_back(dbv);
-            v = temp;
+            v.swap(temp);
         }
     }
 
@@ -225,6 +267,8 @@ public:
     void insert(ulint pos, ulint c) {
         assert(pos <= this->n);
 
+        grow(c);
+
         for (ulint i = 0; i < bit_arrays.size(); ++i) {
             const ulint bit = (c >> (bit_width - i - 1)) & 1;  //　上からi番目のbit
             bit_arrays.at(i).insert(pos, bit);
@@ -273,11 +317,511 @@ public:
         this->n--;
     }
 
-    // posにcをセットする
+    /*
+     * substring operations. A substring is a contiguous range on the first
+     * level; on each level below, the values of a range with the same bit
+     * form again a contiguous range. Each such range receives a single
+     * batched insertion/removal, and is read with one sequential scan by
+     * extract. Ranges are listed 0s first, so that they stay sorted by
+     * position
+     */
+
+    // [first, last)をposに挿入する
+    template <typename Iterator>
+    void insert_range(ulint pos, Iterator first, Iterator last) {
+        assert(pos <= this->n);
+
+        vector<ulint> vals(first, last);
+        for (auto c : vals) grow(c);
+
+        // (position on the current level, first value, end); the values of
+        // each range are vals[order[first..end)]
+        vector<tuple<ulint, ulint, ulint>> ranges{std::make_tuple(pos, 0, vals.size())};
+        vector<ulint> order(vals.size()), next_order(vals.size());
+        for (ulint k = 0; k < vals.size(); ++k) order[k] = k;
+
+        vector<uint64_t> words;
+        for (ulint i = 0; i < bit_width && !vals.empty(); ++i) {
+            const ulint shift = bit_width - i - 1;  // 上からi番目のbit
+            vector<tuple<ulint, ulint, ulint>> zeros, ones;
+            ulint z = 0, o = 0;
+            for (ulint k = 0; k < ranges.size(); ++k) {
+                const ulint p = std::get<0>(ranges[k]);
+                const ulint p1 = bit_arrays.at(i).rank(p, 1);
+                const ulint begin = std::get<1>(ranges[k]), end = std::get<2>(ranges[k]);
+
+                ulint m0 = 0;
+                for (ulint j = begin; j < end; ++j) m0 += !((vals[order[j]] >> shift) & 1);
+
+                // 0s of the range go to [z, z+m0), 1s to [o, o+m1) of next_order
+                if (m0) zeros.push_back(std::make_tuple(p - p1, z, z + m0));
+                if (end - begin > m0) ones.push_back(std::make_tuple(begin_one.at(i) + p1, o, o + end - begin - m0));
+                z += m0;
+                o += end - begin - m0;
+            }
+            for (auto& r : ones) {
+                std::get<1>(r) += z;
+                std::get<2>(r) += z;
+            }
+
+            // insert from the last range, so that the positions of the
+            // others are still valid
+            for (ulint k = ranges.size(); k > 0; --k) {
+                const ulint p = std::get<0>(ranges[k - 1]);
+                const ulint begin = std::get<1>(ranges[k - 1]), end = std::get<2>(ranges[k - 1]);
+
+                words.assign((end - begin) / 64 + ((end - begin) % 64 != 0), 0);
+                for (ulint j = begin; j < end; ++j) {
+                    words[(j - begin) / 64] |= ((vals[order[j]] >> shift) & 1) << ((j - begin) % 64);
+                }
+                bit_arrays.at(i).insert_words(p, words, end - begin);
+            }
+
+            // stable partition of order by bit
+            ulint i0 = 0, i1 = z;
+            for (ulint j = 0; j < vals.size(); ++j) {
+                if ((vals[order[j]] >> shift) & 1) {
+                    next_order[i1++] = order[j];
+                } else {
+                    next_order[i0++] = order[j];
+                }
+            }
+            order.swap(next_order);
+            this->begin_one.at(i) += z;
+
+            zeros.insert(zeros.end(), ones.begin(), ones.end());
+            ranges.swap(zeros);
+        }
+
+        this->n += vals.size();
+    }
+
+    // [pos, pos+len)を削除する
+    void remove_range(ulint pos, ulint len) {
+        assert(pos + len <= this->n);
+
+        vector<pair<ulint, ulint>> ranges;
+        if (len) ranges.push_back({pos, pos + len});
+
+        for (ulint i = 0; i < bit_width && !ranges.empty(); ++i) {
+            vector<pair<ulint, ulint>> zeros, ones;
+            ulint z = 0;
+            for (auto& r : ranges) {
+                const ulint l1 = bit_arrays.at(i).rank(r.first, 1);
+                const ulint r1 = bit_arrays.at(i).rank(r.second, 1);
+                if (r.second - r.first > r1 - l1) zeros.push_back({r.first - l1, r.second - r1});
+                if (r1 > l1) ones.push_back({begin_one.at(i) + l1, begin_one.at(i) + r1});
+                z += (r.second - r.first) - (r1 - l1);
+            }
+
+            for (ulint k = ranges.size(); k > 0; --k) {
+                bit_arrays.at(i).remove_range(ranges[k - 1].first, ranges[k - 1].second - ranges[k - 1].first);
+            }
+            this->begin_one.at(i) -= z;
+
+            zeros.insert(zeros.end(), ones.begin(), ones.end());
+            ranges.swap(zeros);
+        }
+
+        this->n -= len;
+    }
+
+    // [pos, pos+len)の値をoutに書き出す
+    template <typename Iterator>
+    void extract(ulint pos, ulint len, Iterator out) const {
+        assert(pos + len <= this->n);
+
+        vector<ulint> res(len, 0);
+
+        // (range on the current level, first value); the values of each
+        // range are res[order[first..)]
+        vector<tuple<ulint, ulint, ulint>> ranges;
+        if (len) ranges.push_back(std::make_tuple(pos, pos + len, 0));
+        vector<ulint> order(len), next_order(len);
+        for (ulint k = 0; k < len; ++k) order[k] = k;
+
+        vector<bool> bits;
+        vector<ulint> ones_order;
+        for (ulint i = 0; i < bit_width && !ranges.empty(); ++i) {
+            vector<tuple<ulint, ulint, ulint>> zeros, ones;
+            ulint z = 0;
+            ones_order.clear();
+
+            for (auto& r : ranges) {
+                const ulint a = std::get<0>(r), b = std::get<1>(r), begin = std::get<2>(r);
+                const ulint a1 = bit_arrays.at(i).rank(a, 1);
+
+                bits.assign(b - a, false);
+                bit_arrays.at(i).for_each_one(a, b, [&](ulint j) { bits[j - a] = true; });
+
+                const ulint z0 = z, o0 = ones_order.size();
+                for (ulint j = 0; j < b - a; ++j) {
+                    const ulint k = order[begin + j];
+                    res[k] = (res[k] << 1) | bits[j];
+                    if (bits[j]) {
+                        ones_order.push_back(k);
+                    } else {
+                        next_order[z++] = k;
+                    }
+                }
+
+                const ulint m1 = ones_order.size() - o0;
+                if (z > z0) zeros.push_back(std::make_tuple(a - a1, b - a1 - m1, z0));
+                if (m1) ones.push_back(std::make_tuple(begin_one.at(i) + a1, begin_one.at(i) + a1 + m1, o0));
+            }
+
+            // the 1s follow the 0s
+            std::copy(ones_order.begin(), ones_order.end(), next_order.begin() + z);
+            for (auto& r : ones) std::get<2>(r) += z;
+
+            order.swap(next_order);
+            zeros.insert(zeros.end(), ones.begin(), ones.end());
+            ranges.swap(zeros);
+        }
+
+        std::copy(res.begin(), res.end(), out);
+    }
+
+    /*
+     * posにcをセットする
+     *
+     * levels where the old and the new value share their bits are only
+     * traversed. At the first level where they differ the bit is flipped in
+     * place; below it, the old value is removed and the new one inserted,
+     * level by level
+     */
     void update(ulint pos, ulint c) {
         assert(pos < this->n);
-        this->remove(pos);
-        this->insert(pos, c);
+
+        grow(c);
+
+        const ulint old = this->at(pos);
+        if (old == c) return;
+
+        ulint i = 0;
+        for (; i < bit_width; ++i) {
+            const ulint bit = (c >> (bit_width - i - 1)) & 1;
+            if (bit != ((old >> (bit_width - i - 1)) & 1)) break;
+
+            pos = bit_arrays.at(i).rank(pos, bit);
+            if (bit) {
+                pos += this->begin_one.at(i);
+            }
+        }
+
+        assert(i < bit_width);
+
+        // first level where the bits differ: flip in place. old_pos / new_pos
+        // are the positions of the old / new value on the next level
+        const ulint old_bit = (old >> (bit_width - i - 1)) & 1;
+        const ulint new_bit = 1 - old_bit;
+
+        ulint old_pos = bit_arrays.at(i).rank(pos, old_bit);
+        if (old_bit) {
+            old_pos += this->begin_one.at(i);
+        }
+
+        bit_arrays.at(i).set(pos, new_bit);
+        if (new_bit) {
+            this->begin_one.at(i)--;
+        } else {
+            this->begin_one.at(i)++;
+        }
+
+        ulint new_pos = bit_arrays.at(i).rank(pos, new_bit);
+        if (new_bit) {
+            new_pos += this->begin_one.at(i);
+        }
+
+        for (++i; i < bit_width; ++i) {
+            const ulint ob = (old >> (bit_width - i - 1)) & 1;
+            const ulint nb = (c >> (bit_width - i - 1)) & 1;
+
+            // the next level is still untouched: compute before removing
+            ulint next_old = bit_arrays.at(i).rank(old_pos, ob);
+            if (ob) {
+                next_old += this->begin_one.at(i);
+            }
+            bit_arrays.at(i).remove(old_pos);
+            if (not ob) {
+                this->begin_one.at(i)--;
+            }
+
+            bit_arrays.at(i).insert(new_pos, nb);
+            ulint next_new = bit_arrays.at(i).rank(new_pos, nb);
+            if (nb) {
+                next_new += this->begin_one.at(i);
+            } else {
+                this->begin_one.at(i)++;
+            }
+
+            old_pos = next_old;
+            new_pos = next_new;
+        }
+    }
+
+    /*
+     * range queries. All of them work on positions [l, r) and descend the
+     * levels with rank operations only: O(log sigma) rank calls per level
+     * visited / per reported value
+     */
+
+    // number of values c with cmin <= c <= cmax in positions [l, r)
+    ulint range_count(ulint l, ulint r, ulint cmin, ulint cmax) const {
+        assert(l <= r && r <= n);
+        if (cmin > cmax) return 0;
+
+        ulint hi = cmax >= max_value() ? r - l : rank_less(l, r, cmax + 1);
+        return hi - rank_less(l, r, cmin);
+    }
+
+    // k-th smallest value (k = 0, 1, ...) in positions [l, r)
+    ulint range_quantile(ulint l, ulint r, ulint k) const {
+        assert(l <= r && r <= n);
+        assert(k < r - l);
+
+        ulint c = 0;
+        for (ulint i = 0; i < bit_width; ++i) {
+            const ulint l0 = bit_arrays.at(i).rank(l, 0);
+            const ulint r0 = bit_arrays.at(i).rank(r, 0);
+            if (k < r0 - l0) {
+                descend(i, l, r, l0, r0, 0);
+                c <<= 1;
+            } else {
+                k -= r0 - l0;
+                descend(i, l, r, l0, r0, 1);
+                c = (c << 1) | 1;
+            }
+        }
+        return c;
+    }
+
+    /*
+     * the k most frequent values in positions [l, r), as pairs
+     * <value, frequency> in decreasing order of frequency
+     */
+    vector<pair<ulint, ulint>> range_top_k(ulint l, ulint r, ulint k) const {
+        assert(l <= r && r <= n);
+
+        vector<pair<ulint, ulint>> res;
+
+        // <frequency, level, l, r, value prefix>. A node's frequency bounds
+        // the frequency of all values below it: best-first search
+        typedef std::tuple<ulint, ulint, ulint, ulint, ulint> item;
+        std::priority_queue<item> Q;
+        if (l < r) Q.push(item{r - l, 0, l, r, 0});
+
+        while (not Q.empty() && res.size() < k) {
+            ulint f, i, a, b, c;
+            std::tie(f, i, a, b, c) = Q.top();
+            Q.pop();
+
+            if (i == bit_width) {
+                res.push_back({c, f});
+                continue;
+            }
+
+            const ulint a0 = bit_arrays.at(i).rank(a, 0);
+            const ulint b0 = bit_arrays.at(i).rank(b, 0);
+            if (b0 > a0) Q.push(item{b0 - a0, i + 1, a0, b0, c << 1});
+            if (b - a > b0 - a0) {
+                ulint a1 = a, b1 = b;
+                descend(i, a1, b1, a0, b0, 1);
+                Q.push(item{b1 - a1, i + 1, a1, b1, (c << 1) | 1});
+            }
+        }
+        return res;
+    }
+
+    /*
+     * distinct values in positions [l, r), as pairs <value, frequency>
+     * in increasing order of value
+     */
+    vector<pair<ulint, ulint>> range_distinct(ulint l, ulint r) const {
+        assert(l <= r && r <= n);
+
+        vector<pair<ulint, ulint>> res;
+
+        // <level, l, r, value prefix>. The 1-child is pushed first, so that
+        // values are popped in increasing order
+        vector<std::tuple<ulint, ulint, ulint, ulint>> S;
+        if (l < r) S.push_back(std::make_tuple(0, l, r, 0));
+
+        while (not S.empty()) {
+            ulint i, a, b, c;
+            std::tie(i, a, b, c) = S.back();
+            S.pop_back();
+
+            if (i == bit_width) {
+                res.push_back({c, b - a});
+                continue;
+            }
+
+            const ulint a0 = bit_arrays.at(i).rank(a, 0);
+            const ulint b0 = bit_arrays.at(i).rank(b, 0);
+            if (b - a > b0 - a0) {
+                ulint a1 = a, b1 = b;
+                descend(i, a1, b1, a0, b0, 1);
+                S.push_back(std::make_tuple(i + 1, a1, b1, (c << 1) | 1));
+            }
+            if (b0 > a0) S.push_back(std::make_tuple(i + 1, a0, b0, c << 1));
+        }
+        return res;
+    }
+
+    /*
+     * smallest value >= x in positions [l, r). The first component
+     * is false if there is no such value
+     */
+    pair<bool, ulint> range_next_value(ulint l, ulint r, ulint x) const {
+        assert(l <= r && r <= n);
+
+        // depth-first, 0-child first: the first leaf reached is the answer.
+        // Subtrees whose values are all < x are skipped
+        vector<std::tuple<ulint, ulint, ulint, ulint>> S;
+        if (l < r) S.push_back(std::make_tuple(0, l, r, 0));
+
+        while (not S.empty()) {
+            ulint i, a, b, c;
+            std::tie(i, a, b, c) = S.back();
+            S.pop_back();
+
+            // largest value in this subtree
+            const ulint rem = bit_width - i;
+            if (rem < 64 && ((c << rem) | ((ulint(1) << rem) - 1)) < x) continue;
+
+            if (i == bit_width) return {true, c};
+
+            const ulint a0 = bit_arrays.at(i).rank(a, 0);
+            const ulint b0 = bit_arrays.at(i).rank(b, 0);
+            if (b - a > b0 - a0) {
+                ulint a1 = a, b1 = b;
+                descend(i, a1, b1, a0, b0, 1);
+                S.push_back(std::make_tuple(i + 1, a1, b1, (c << 1) | 1));
+            }
+            if (b0 > a0) S.push_back(std::make_tuple(i + 1, a0, b0, c << 1));
+        }
+        return {false, 0};
+    }
+
+    /*
+     * batched queries. All queries are processed level by level: each level's
+     * bitvector is swept once, in increasing order of position (see
+     * rank1_batch), instead of being touched at random by each query.
+     * Sorting is needed only once: the map to the next level preserves the
+     * order of positions with the same bit, and all 0s go before all 1s,
+     * so a stable partition by bit keeps the queries sorted
+     */
+
+    // at(positions[k]) for each k
+    vector<ulint> access_batch(const vector<ulint>& positions) const {
+        const ulint q = positions.size();
+        vector<ulint> res(q, 0);
+
+        vector<ulint> id(q);
+        for (ulint k = 0; k < q; ++k) id[k] = k;
+        std::sort(id.begin(), id.end(),
+                  [&](ulint a, ulint b) { return positions[a] < positions[b]; });
+
+        vector<ulint> pos(q), next(q), bits(q);
+        for (ulint k = 0; k < q; ++k) {
+            assert(positions[id[k]] < n);
+            pos[k] = positions[id[k]];
+        }
+
+        for (ulint i = 0; i < bit_width; ++i) {
+            bit_arrays.at(i).rank1_batch(pos.begin(), pos.end(), [&](ulint k, ulint r1, bool b) {
+                res[id[k]] = (res[id[k]] << 1) | b;
+                bits[k] = b;
+                next[k] = b ? begin_one.at(i) + r1 : pos[k] - r1;
+            });
+            partition_by_bit(bits, next, id, pos);
+        }
+        return res;
+    }
+
+    // rank(queries[k].first, queries[k].second) for each k
+    vector<ulint> rank_batch(const vector<pair<ulint, ulint>>& queries) const {
+        const ulint q = queries.size();
+        vector<ulint> res(q, 0);
+
+        // both ends of the range of each query: 2k is [0, 2k+1 is [pos
+        vector<ulint> pos, val, id;
+        for (ulint k = 0; k < q; ++k) {
+            assert(queries[k].first <= n);
+            if (queries[k].second >= sigma) continue;
+
+            pos.push_back(0);
+            pos.push_back(queries[k].first);
+            val.push_back(queries[k].second);
+            val.push_back(queries[k].second);
+            id.push_back(2 * k);
+            id.push_back(2 * k + 1);
+        }
+
+        descend_batch(pos, val, id);
+
+        for (ulint k = 0; k < id.size(); ++k) {
+            if (id[k] % 2) {
+                res[id[k] / 2] += pos[k];
+            } else {
+                res[id[k] / 2] -= pos[k];
+            }
+        }
+        return res;
+    }
+
+    /*
+     * select(queries[k].first, queries[k].second) for each k (same
+     * conventions as select). The start of each value on the last level is
+     * found with descend_batch; the climb back is done with plain selects,
+     * issued in increasing order of position on each level
+     */
+    vector<ulint> select_batch(const vector<pair<ulint, ulint>>& queries) const {
+        const ulint q = queries.size();
+
+        vector<ulint> pos(q, 0), val(q), id(q);
+        for (ulint k = 0; k < q; ++k) {
+            assert(queries[k].first > 0);
+            assert(queries[k].second < sigma);
+            val[k] = queries[k].second;
+            id[k] = k;
+        }
+
+        descend_batch(pos, val, id);
+
+        // position of each query on the last level, sorted
+        vector<ulint> index(q), order(q);
+        for (ulint k = 0; k < q; ++k) {
+            index[id[k]] = pos[k] + queries[id[k]].first - 1;
+            order[k] = id[k];
+        }
+        std::sort(order.begin(), order.end(),
+                  [&](ulint a, ulint b) { return index[a] < index[b]; });
+
+        vector<ulint> zeros, ones;
+        for (ulint i = bit_width; i > 0; --i) {
+            const ulint shift = bit_width - i;  // 下から(bit_width-i)番目のbit
+
+            zeros.clear();
+            ones.clear();
+            for (ulint k : order) {
+                if ((queries[k].second >> shift) & 1) {
+                    index[k] = bit_arrays.at(i - 1).select(index[k] - begin_one.at(i - 1), 1);
+                    ones.push_back(k);
+                } else {
+                    index[k] = bit_arrays.at(i - 1).select(index[k], 0);
+                    zeros.push_back(k);
+                }
+            }
+
+            // both lists are sorted by the new index: merge them
+            std::merge(zeros.begin(), zeros.end(), ones.begin(), ones.end(), order.begin(),
+                       [&](ulint a, ulint b) { return index[a] < index[b]; });
+        }
+
+        for (auto& x : index) ++x;
+        return index;
     }
 
     ulint size(void) const {
@@ -296,6 +840,125 @@ public:
     // 他の操作は通常のWavelet Matrixと同じ
 
 private:
+    /*
+     * make room for value c: while c does not fit in bit_width bits, add an
+     * all-zero top level. A level of 0s does not reorder the values, so the
+     * existing levels stay valid and nothing is re-inserted
+     */
+    void grow(ulint c) {
+        while (bit_width < 64 && (c >> bit_width) != 0) {
+            dynamic_bitvector_t dbv;
+            dbv.assign_words(std::vector<uint64_t>(n / 64 + (n % 64 != 0), 0), n);
+
+            bit_arrays.insert(bit_arrays.begin(), std::move(dbv));
+            begin_one.insert(begin_one.begin(), n);
+            ++bit_width;
+        }
+
+        if (c >= sigma) sigma = c + 1;
+    }
+
+    /*
+     * stable partition of the queries by bit: 0s first. pos receives next,
+     * reordered; id is reordered the same way
+     */
+    void partition_by_bit(const vector<ulint>& bits, const vector<ulint>& next,
+                          vector<ulint>& id, vector<ulint>& pos) const {
+        vector<ulint> new_id;
+        new_id.reserve(id.size());
+
+        for (ulint b = 0; b < 2; ++b) {
+            for (ulint k = 0; k < id.size(); ++k) {
+                if (bits[k] != b) continue;
+                pos[new_id.size()] = next[k];
+                new_id.push_back(id[k]);
+            }
+        }
+        id.swap(new_id);
+    }
+
+    /*
+     * follow the path of value val[k] from position pos[k] of the first
+     * level, for each k, down to the last level. On return pos[k] is the
+     * position on the last level, and the three vectors are sorted by it
+     */
+    void descend_batch(vector<ulint>& pos, vector<ulint>& val, vector<ulint>& id) const {
+        const ulint q = pos.size();
+
+        {
+            vector<ulint> order(q);
+            for (ulint k = 0; k < q; ++k) order[k] = k;
+            std::sort(order.begin(), order.end(),
+                      [&](ulint a, ulint b) { return pos[a] < pos[b]; });
+
+            vector<ulint> p(q), v(q), d(q);
+            for (ulint k = 0; k < q; ++k) {
+                p[k] = pos[order[k]];
+                v[k] = val[order[k]];
+                d[k] = id[order[k]];
+            }
+            pos.swap(p);
+            val.swap(v);
+            id.swap(d);
+        }
+
+        vector<ulint> next(q), bits(q), order(q);
+        for (ulint i = 0; i < bit_width; ++i) {
+            const ulint shift = bit_width - i - 1;  // 上からi番目のbit
+
+            bit_arrays.at(i).rank1_batch(pos.begin(), pos.end(), [&](ulint k, ulint r1, bool) {
+                bits[k] = (val[k] >> shift) & 1;
+                next[k] = bits[k] ? begin_one.at(i) + r1 : pos[k] - r1;
+            });
+
+            // partition a permutation, then apply it to val and id
+            for (ulint k = 0; k < q; ++k) order[k] = k;
+            partition_by_bit(bits, next, order, pos);
+
+            vector<ulint> v(q), d(q);
+            for (ulint k = 0; k < q; ++k) {
+                v[k] = val[order[k]];
+                d[k] = id[order[k]];
+            }
+            val.swap(v);
+            id.swap(d);
+        }
+    }
+
+    // largest value representable with bit_width bits
+    ulint max_value() const {
+        return bit_width >= 64 ? ~ulint(0) : (ulint(1) << bit_width) - 1;
+    }
+
+    /*
+     * map range [l, r) of level i to the range of its bit-children at level i+1.
+     * l0, r0 are the number of zeros before l and r at level i
+     */
+    void descend(ulint i, ulint& l, ulint& r, ulint l0, ulint r0, ulint bit) const {
+        if (bit) {
+            l = begin_one.at(i) + l - l0;
+            r = begin_one.at(i) + r - r0;
+        } else {
+            l = l0;
+            r = r0;
+        }
+    }
+
+    // number of values < x in positions [l, r)
+    ulint rank_less(ulint l, ulint r, ulint x) const {
+        if (x > max_value()) return r - l;
+
+        ulint res = 0;
+        for (ulint i = 0; i < bit_width && l < r; ++i) {
+            const ulint bit = (x >> (bit_width - i - 1)) & 1;
+            const ulint l0 = bit_arrays.at(i).rank(l, 0);
+            const ulint r0 = bit_arrays.at(i).rank(r, 0);
+            if (bit) res += r0 - l0;
+            descend(i, l, r, l0, r0, bit);
+        }
+        return res;
+    }
+
     ulint get_num_of_bit(ulint x) {
         if (x == 0) return 0;
         x--;
@@ -16,8 +16,16 @@
  * sigma. New characters can always be inserted.
  *  - dynamic_string(uint64_t sigma) : fixed-length. Max sigma characters are
  * allowed
- *  - dynamic_string(vector<pair<char_type,double> > P) : Huffman-encoding. The
- * characters set is fixed at construction time.
+ *  - dynamic_string(vector<pair<char_type,double> > P, bool open) : Huffman-encoding.
+ * The characters set is fixed at construction time, unless open: new characters are
+ * then escape-coded (see alphabet_encoder).
+ *
+ *  Tree nodes live in one contiguous pool (a vector) and refer to each other
+ *  through 32-bit indices; the root is nodes[0]. New nodes are appended, so
+ *  parents always precede their children. The pool is re-laid out in level
+ *  (BFS) order once it has doubled since the last layout (amortized O(1) per
+ *  node), so top levels of the tree, touched by every query, share a few
+ *  cache lines.
  *
  */
 
@@ -35,6 +43,7 @@ class wt_string {
   // we allow any alphabet
   typedef uint64_t char_type;
   typedef char_type value_type;
+  typedef alphabet_encoder::code_t code_t;
 
   /*
    * Constructor #1
@@ -61,10 +70,13 @@ class wt_string {
    *
    * We know character probabilities. Input: pairs <character, probability>
    *
-   * Here the alphabet is Huffman encoded.
+   * Here the alphabet is Huffman encoded. If open, characters not in P can
+   * be inserted as well (with longer codes).
    *
    */
-  explicit wt_string(vector<pair<char_type, double>>& P) { ae = alphabet_encoder(P); }
+  explicit wt_string(vector<pair<char_type, double>>& P, bool open = false) {
+    ae = alphabet_encoder(P, open);
+  }
 
   template <typename t_str>
   wt_string(uint64_t sigma, const t_str& str) : wt_string(sigma) { push_many(str); }
@@ -84,7 +96,28 @@ class wt_string {
    */
   char_type at(uint64_t i) const {
     assert(i < size());
-    return root.at(i);
+
+    uint32_t x = 0;
+
+    while (not nodes[x].is_leaf()) {
+      const node& N = nodes[x];
+
+      assert(i < N.bv.size());
+
+      if (N.bv.at(i)) {
+        assert(N.has_child1());
+
+        i = N.bv.rank1(i);
+        x = N.child1_;
+      } else {
+        assert(N.has_child0());
+
+        i = N.bv.rank0(i);
+        x = N.child0_;
+      }
+    }
+
+    return nodes[x].label();
   }
 
   /*
@@ -94,7 +127,7 @@ class wt_string {
     assert(ae.char_exists(c));
     assert(i < rank(size(), c));
 
-    const auto& code = ae.encode_existing(c);
+    code_t code = ae.encode_existing(c);
 
     // if this fails, it means that c is not present
     // in the string or that it is not present
@@ -102,9 +135,18 @@ class wt_string {
     assert(code.size() > 0);
 
     // this code must have been inserted in the tree already
-    assert(root.exists(code));
+    assert(exists(code));
+
+    // top-down: find leaf associated with code
+    uint32_t x = get_leaf(code);
 
-    return root.select(i, code);
+    // bottom-up: from leaf to root
+    for (uint8_t j = code.size(); j > 0; --j) {
+      x = nodes[x].parent_;
+      i = nodes[x].bv.select(i, code[j - 1]);
+    }
+
+    return i;
   }
 
   /*
@@ -115,7 +157,7 @@ class wt_string {
 
     if (not ae.char_exists(c)) return 0;
 
-    const auto& code = ae.encode_existing(c);
+    code_t code = ae.encode_existing(c);
 
     // if this fails, it means that c is not present
     // in the string or that it is not present
@@ -127,7 +169,26 @@ class wt_string {
      * alphabet encoder, but it has not yet been inserted
      * in the tree
      */
-    return root.exists(code) ? root.rank(i, code) : 0;
+    if (not exists(code)) return 0;
+
+    uint32_t x = 0;
+
+    for (uint8_t j = 0; j < code.size(); ++j) {
+      const node& N = nodes[x];
+
+      // i must be smaller than bv.size()
+      assert(i <= N.bv.size());
+
+      if (code[j]) {
+        i = N.bv.rank1(i);
+        x = N.child1_;
+      } else {
+        i = N.bv.rank0(i);
+        x = N.child0_;
+      }
+    }
+
+    return i;
   }
 
   bool char_exists(char_type c) const { return ae.char_exists(c); }
@@ -137,7 +198,7 @@ class wt_string {
   // insert values from range [0,...,sigma)
   template <class Vector>
   void push_many(uint64_t sigma, const Vector& values) {
-    map<char_type, vector<bool>> path_to_leaf;
+    map<char_type, code_t> path_to_leaf;
     for (ulint c = 0; c < sigma; ++c) {
       path_to_leaf[c] = ae.encode(c);
     }
@@ -145,27 +206,35 @@ class wt_string {
     assert(std::all_of(values.begin(), values.end(),
                        [&](typename Vector::value_type c) { return ae.char_exists(c); }));
 
+    if (add_paths(path_to_leaf)) grow_layout();
+
     #pragma omp parallel
     #pragma omp master
-    root.push_many(path_to_leaf, values);
+    push_many(0, path_to_leaf, values);
     n += values.size();
   }
 
   template <class Vector>
   void push_many(const Vector& values) {
+    // new characters are encoded in increasing order, so that (with
+    // fixed-length codes) the tree is ordered by character
+    set<char_type> fresh;
     for (ulint i = 0; i < values.size(); ++i) {
       auto c = values[i];
-      if (!ae.char_exists(c)) ae.encode(c);
+      if (!ae.char_exists(c)) fresh.insert(c);
     }
+    for (char_type c : fresh) ae.encode(c);
 
-    map<char_type, vector<bool>> path_to_leaf;
+    map<char_type, code_t> path_to_leaf;
     for (char_type c : ae.keys()) {
       path_to_leaf[c] = ae.encode(c);
     }
 
+    if (add_paths(path_to_leaf)) grow_layout();
+
     #pragma omp parallel
     #pragma omp master
-    root.push_many(path_to_leaf, values);
+    push_many(0, path_to_leaf, values);
     n += values.size();
   }
 
@@ -177,9 +246,34 @@ class wt_string {
   void insert(uint64_t i, char_type c) {
     // get code of c
     // if code does not yet exist, create it
-    const auto& code = ae.encode(c);
+    code_t code = ae.encode(c);
 
-    root.insert(i, code, c);
+    // if code does not yet have a path in the tree, create it
+    if (add_path(code, c)) grow_layout();
+
+    uint32_t x = 0;
+
+    for (uint8_t j = 0; j < code.size(); ++j) {
+      node& N = nodes[x];
+
+      assert(i <= N.bv.size());
+      assert(not N.is_leaf());
+
+      bool b = code[j];
+      N.bv.insert(i, b);
+
+      if (b) {
+        i = N.bv.rank1(i);
+        x = N.child1_;
+      } else {
+        i = N.bv.rank0(i);
+        x = N.child0_;
+      }
+    }
+
+    // this node must be a leaf
+    assert(nodes[x].bv.size() == 0);
+    assert(nodes[x].label() == c);
 
     ++n;
   }
@@ -190,17 +284,503 @@ class wt_string {
   void remove(uint64_t i) {
     char_type c = this->at(i);
     // get code of c
-    const auto& code = ae.encode(c);
+    code_t code = ae.encode(c);
+
+    uint32_t x = 0;
+
+    for (uint8_t j = 0; j < code.size(); ++j) {
+      node& N = nodes[x];
+
+      assert(i < N.bv.size());
+      assert(not N.is_leaf());
+
+      bool b = code[j];
+
+      assert(b == N.bv.at(i));
+
+      // TODO: delete empty nodes?
+      ulint next_i = b ? N.bv.rank1(i) : N.bv.rank0(i);
+
+      N.bv.remove(i);
+
+      i = next_i;
+      x = b ? N.child1_ : N.child0_;
+    }
+
+    // TODO: Check if leaf should be deleted?
+
+    // this node must be a leaf
+    assert(nodes[x].bv.size() == 0);
+    assert(c == nodes[x].label());
 
-    root.remove(i, code, c);
     --n;
   }
 
+  /*
+   * substring operations. The characters of a substring occupy a contiguous
+   * range in every node they traverse, so each node's bitvector receives a
+   * single batched insertion/removal, and is read with one sequential scan
+   * by extract
+   */
+
+  // insert the characters in [first, last) before position i
+  template <typename Iterator>
+  void insert_range(uint64_t i, Iterator first, Iterator last) {
+    assert(i <= size());
+
+    vector<code_t> codes;
+    bool new_paths = false;
+
+    for (; first != last; ++first) {
+      char_type c = *first;
+      codes.push_back(ae.encode(c));
+      new_paths |= add_path(codes.back(), c);
+    }
+
+    if (new_paths) grow_layout();
+    if (codes.empty()) return;
+
+    // (node, position, depth, characters routed to the node)
+    vector<tuple<uint32_t, uint64_t, uint8_t, vector<uint64_t>>> S;
+
+    vector<uint64_t> all(codes.size());
+    for (uint64_t k = 0; k < all.size(); ++k) all[k] = k;
+    S.push_back(std::make_tuple(0, i, 0, std::move(all)));
+
+    vector<uint64_t> words;
+
+    while (not S.empty()) {
+      uint32_t x = std::get<0>(S.back());
+      uint64_t p = std::get<1>(S.back());
+      uint8_t d = std::get<2>(S.back());
+      vector<uint64_t> ks = std::move(std::get<3>(S.back()));
+      S.pop_back();
+
+      node& N = nodes[x];
+      assert(not N.is_leaf());
+
+      vector<uint64_t> ks0, ks1;
+      words.assign(ks.size() / 64 + (ks.size() % 64 != 0), 0);
+
+      for (uint64_t j = 0; j < ks.size(); ++j) {
+        bool b = codes[ks[j]][d];
+        words[j / 64] |= uint64_t(b) << (j % 64);
+        (b ? ks1 : ks0).push_back(ks[j]);
+      }
+
+      uint64_t p1 = N.bv.rank1(p);
+      N.bv.insert_words(p, words, ks.size());
+
+      // characters whose code ends here reached their leaf
+      if (not ks0.empty() and not nodes[N.child0_].is_leaf())
+        S.push_back(std::make_tuple(N.child0_, p - p1, d + 1, std::move(ks0)));
+      if (not ks1.empty() and not nodes[N.child1_].is_leaf())
+        S.push_back(std::make_tuple(N.child1_, p1, d + 1, std::move(ks1)));
+    }
+
+    n += codes.size();
+  }
+
+  // remove the len characters in positions [i, i+len)
+  void remove_range(uint64_t i, uint64_t len) {
+    assert(i + len <= size());
+
+    if (len == 0) return;
+
+    // (node, range)
+    vector<tuple<uint32_t, uint64_t, uint64_t>> S{std::make_tuple(0, i, i + len)};
+
+    while (not S.empty()) {
+      uint32_t x;
+      uint64_t l, r;
+      std::tie(x, l, r) = S.back();
+      S.pop_back();
+
+      node& N = nodes[x];
+      uint64_t l1 = N.bv.rank1(l), r1 = N.bv.rank1(r);
+
+      N.bv.remove_range(l, r - l);
+
+      if (r - l > r1 - l1 and not nodes[N.child0_].is_leaf())
+        S.push_back(std::make_tuple(N.child0_, l - l1, r - r1));
+      if (r1 > l1 and not nodes[N.child1_].is_leaf()) S.push_back(std::make_tuple(N.child1_, l1, r1));
+    }
+
+    n -= len;
+  }
+
+  /*
+   * write the len characters in positions [i, i+len) to out. The sequence of
+   * each node is the merge of its children's sequences, driven by its bits:
+   * nodes are processed bottom-up (reverse pool order) and children freed
+   * after use
+   */
+  template <typename Iterator>
+  void extract(uint64_t i, uint64_t len, Iterator out) const {
+    assert(i + len <= size());
+
+    if (len == 0) return;
+
+    // range of each node; parents come before their children in the pool
+    vector<uint64_t> L(nodes.size(), 0), R(nodes.size(), 0);
+    L[0] = i;
+    R[0] = i + len;
+
+    for (uint32_t x = 0; x < nodes.size(); ++x) {
+      const node& N = nodes[x];
+
+      if (N.is_leaf() or L[x] == R[x]) continue;
+
+      uint64_t l1 = N.bv.rank1(L[x]), r1 = N.bv.rank1(R[x]);
+
+      if (N.has_child0()) {
+        L[N.child0_] = L[x] - l1;
+        R[N.child0_] = R[x] - r1;
+      }
+      if (N.has_child1()) {
+        L[N.child1_] = l1;
+        R[N.child1_] = r1;
+      }
+    }
+
+    vector<vector<char_type>> S(nodes.size());
+    vector<bool> bits;
+
+    for (uint32_t x = nodes.size(); x > 0; --x) {
+      const node& N = nodes[x - 1];
+      const uint64_t l = L[x - 1], r = R[x - 1];
+
+      if (N.is_leaf() or l == r) continue;
+
+      // a leaf child is a run of its label
+      auto child = [&](uint32_t y) -> vector<char_type> {
+        if (nodes[y].is_leaf()) return vector<char_type>(R[y] - L[y], nodes[y].label());
+        return std::move(S[y]);
+      };
+
+      vector<char_type> S0 = N.has_child0() ? child(N.child0_) : vector<char_type>();
+      vector<char_type> S1 = N.has_child1() ? child(N.child1_) : vector<char_type>();
+
+      bits.assign(r - l, false);
+      N.bv.for_each_one(l, r, [&](uint64_t j) { bits[j - l] = true; });
+
+      vector<char_type>& res = S[x - 1];
+      res.resize(r - l);
+
+      uint64_t i0 = 0, i1 = 0;
+      for (uint64_t j = 0; j < res.size(); ++j) res[j] = bits[j] ? S1[i1++] : S0[i0++];
+    }
+
+    std::copy(S[0].begin(), S[0].end(), out);
+  }
+
+  /*
+   * range queries on positions [l, r). Each node stores the smallest and
+   * largest character below it, so that subtrees can be pruned by value.
+   * When the encoding preserves the order of characters (e.g. fixed-length
+   * codes assigned in increasing order, as in push_many(sigma, values)),
+   * they take O(log sigma) descents per reported item. Otherwise they are
+   * still correct, but may visit more nodes.
+   */
+
+  // number of characters c with cmin <= c <= cmax in positions [l, r)
+  uint64_t range_count(uint64_t l, uint64_t r, char_type cmin, char_type cmax) const {
+    assert(l <= r && r <= size());
+
+    uint64_t res = 0;
+
+    // <node, l, r>
+    vector<std::tuple<uint32_t, uint64_t, uint64_t>> S;
+    if (l < r) S.push_back(std::make_tuple(0, l, r));
+
+    while (not S.empty()) {
+      uint32_t x;
+      uint64_t a, b;
+      std::tie(x, a, b) = S.back();
+      S.pop_back();
+
+      const node& N = nodes[x];
+
+      if (N.hi_ < cmin or N.lo_ > cmax) continue;
+
+      // all characters below N are in range
+      if (cmin <= N.lo_ and N.hi_ <= cmax) {
+        res += b - a;
+        continue;
+      }
+
+      // leaves have lo_ == hi_, so N is internal
+      push_children(N, a, b, S);
+    }
+
+    return res;
+  }
+
+  // k-th smallest character (k = 0, 1, ...) in positions [l, r)
+  char_type range_quantile(uint64_t l, uint64_t r, uint64_t k) const {
+    assert(l <= r && r <= size());
+    assert(k < r - l);
+
+    uint32_t x = 0;
+
+    while (not nodes[x].is_leaf()) {
+      const node& N = nodes[x];
+
+      // the children are not ordered by value: sort the distinct
+      // characters below N
+      if (N.has_child0() and N.has_child1() and
+          nodes[N.child0_].hi_ > nodes[N.child1_].lo_) {
+        auto D = distinct(x, l, r);
+        std::sort(D.begin(), D.end());
+
+        for (auto& p : D) {
+          if (k < p.second) return p.first;
+          k -= p.second;
+        }
+
+        assert(false);
+      }
+
+      uint64_t l0 = N.bv.rank0(l);
+      uint64_t r0 = N.bv.rank0(r);
+
+      if (k < r0 - l0) {
+        l = l0;
+        r = r0;
+        x = N.child0_;
+      } else {
+        k -= r0 - l0;
+        l -= l0;
+        r -= r0;
+        x = N.child1_;
+      }
+    }
+
+    return nodes[x].label();
+  }
+
+  /*
+   * the k most frequent characters in positions [l, r), as pairs
+   * <character, frequency> in decreasing order of frequency
+   */
+  vector<pair<char_type, uint64_t>> range_top_k(uint64_t l, uint64_t r, uint64_t k) const {
+    assert(l <= r && r <= size());
+
+    vector<pair<char_type, uint64_t>> res;
+
+    // <frequency, node, l>. A node's frequency bounds the frequency
+    // of all characters below it: best-first search
+    typedef std::tuple<uint64_t, uint32_t, uint64_t> item;
+    std::priority_queue<item> Q;
+    if (l < r) Q.push(item{r - l, 0, l});
+
+    while (not Q.empty() and res.size() < k) {
+      uint64_t f, a;
+      uint32_t x;
+      std::tie(f, x, a) = Q.top();
+      Q.pop();
+
+      const node& N = nodes[x];
+
+      if (N.is_leaf()) {
+        res.push_back({N.label(), f});
+        continue;
+      }
+
+      uint64_t a0 = N.bv.rank0(a);
+      uint64_t b0 = N.bv.rank0(a + f);
+
+      if (b0 > a0) Q.push(item{b0 - a0, N.child0_, a0});
+      if (f > b0 - a0) Q.push(item{f - (b0 - a0), N.child1_, a - a0});
+    }
+
+    return res;
+  }
+
+  /*
+   * distinct characters in positions [l, r), as pairs <character, frequency>
+   * in increasing order of character
+   */
+  vector<pair<char_type, uint64_t>> range_distinct(uint64_t l, uint64_t r) const {
+    assert(l <= r && r <= size());
+
+    auto res = distinct(0, l, r);
+    std::sort(res.begin(), res.end());
+
+    return res;
+  }
+
+  /*
+   * rank(l, c) and rank(r, c) of each character c in positions [l, r), as
+   * tuples <c, rank(l, c), rank(r, c)> in increasing order of character.
+   * The range of a leaf is its pair of ranks: one pair of rank queries per
+   * visited node, instead of one descent per character
+   */
+  vector<std::tuple<char_type, uint64_t, uint64_t>> rank_all(uint64_t l, uint64_t r) const {
+    assert(l <= r && r <= size());
+
+    vector<std::tuple<char_type, uint64_t, uint64_t>> res;
+
+    vector<std::tuple<uint32_t, uint64_t, uint64_t>> S;
+    if (l < r) S.push_back(std::make_tuple(0, l, r));
+
+    while (not S.empty()) {
+      uint32_t x;
+      uint64_t a, b;
+      std::tie(x, a, b) = S.back();
+      S.pop_back();
+
+      const node& N = nodes[x];
+
+      if (N.is_leaf()) {
+        res.push_back(std::make_tuple(N.label(), a, b));
+        continue;
+      }
+
+      push_children(N, a, b, S);
+    }
+
+    std::sort(res.begin(), res.end());
+
+    return res;
+  }
+
+  /*
+   * smallest character >= c in positions [l, r). The first component
+   * is false if there is no such character
+   */
+  pair<bool, char_type> range_next_value(uint64_t l, uint64_t r, char_type c) const {
+    assert(l <= r && r <= size());
+
+    bool found = false;
+    char_type best = 0;
+
+    // depth-first, child with smaller characters first. Subtrees with no
+    // character >= c, or none smaller than the best found, are skipped
+    vector<std::tuple<uint32_t, uint64_t, uint64_t>> S;
+    if (l < r) S.push_back(std::make_tuple(0, l, r));
+
+    while (not S.empty()) {
+      uint32_t x;
+      uint64_t a, b;
+      std::tie(x, a, b) = S.back();
+      S.pop_back();
+
+      const node& N = nodes[x];
+
+      if (N.hi_ < c or (found and N.lo_ >= best)) continue;
+
+      if (N.is_leaf()) {
+        found = true;
+        best = N.label();
+        continue;
+      }
+
+      push_children(N, a, b, S);
+
+      // pop the child with smaller characters first
+      if (S.size() >= 2) {
+        auto& u = S[S.size() - 1];
+        auto& v = S[S.size() - 2];
+
+        if (nodes[std::get<0>(u)].lo_ > nodes[std::get<0>(v)].lo_) std::swap(u, v);
+      }
+    }
+
+    return {found, best};
+  }
+
+  /*
+   * entropy monitor. Character counts are read off the tree (the size of the
+   * leaf ranges), so updates pay nothing: each of these costs O(sigma)
+   * rank operations
+   */
+
+  // pairs <character, number of occurrences> for each character with a leaf
+  vector<pair<char_type, uint64_t>> char_counts() const {
+    vector<pair<char_type, uint64_t>> res;
+
+    for_each_leaf([&](uint32_t x, uint64_t count, uint64_t) {
+      res.push_back({nodes[x].label(), count});
+    });
+
+    return res;
+  }
+
+  // empirical entropy H0 of the string, in bits per character
+  double entropy() const {
+    double H = 0;
+
+    for (auto& e : char_counts()) {
+      if (e.second == 0) continue;
+
+      double p = double(e.second) / size();
+      H -= p * std::log2(p);
+    }
+
+    return H;
+  }
+
+  // average code length (= tree bits per character) of the current encoding
+  double avg_code_length() const {
+    if (size() == 0) return 0;
+
+    uint64_t bits = 0;
+
+    for_each_leaf([&](uint32_t, uint64_t count, uint64_t depth) { bits += count * depth; });
+
+    return double(bits) / size();
+  }
+
+  /*
+   * true iif the average code length exceeds by more than a
+   * factor (1 + tolerance) that of a Huffman code built on the current counts
+   */
+  bool should_reshape(double tolerance = 0.05) const {
+    if (size() == 0) return false;
+
+    auto P = probabilities();
+    alphabet_encoder huff(P);
+
+    uint64_t bits = 0;
+
+    for_each_leaf([&](uint32_t x, uint64_t count, uint64_t) {
+      bits += count * huff.encode_existing(nodes[x].label()).size();
+    });
+
+    return avg_code_length() > (1 + tolerance) * (double(bits) / size());
+  }
+
+  /*
+   * copy of this string, Huffman-encoded with the current character counts.
+   * The characters are extracted with one sequential scan of each node, and
+   * the copy is built in bulk (push_many).
+   *
+   * Being const, this can run in a background thread on a string that is
+   * not being modified meanwhile (e.g. a snapshot); the result is then
+   * swapped in with a move assignment. If the alphabet of this string can
+   * grow (gamma or fixed-length codes, open Huffman), so can the alphabet
+   * of the result: characters without a leaf get escape codes.
+   */
+  wt_string reshaped() const {
+    if (size() == 0) return *this;
+
+    auto P = probabilities();
+    wt_string res(P, ae.is_dynamic());
+    res.push_many(extract_all());
+
+    return res;
+  }
+
+  // reshape in place (see reshaped())
+  void reshape() { *this = reshaped(); }
+
   uint64_t bit_size() const {
     uint64_t size = 0;
     size += sizeof(wt_string<dynamic_bitvector_t>) * 8;
     size += ae.bit_size();
-    size += root.bit_size();
+    size += nodes.capacity() * sizeof(node) * 8;
+    for (const node& N : nodes) size += N.bv.bit_size();
     return size;
   }
 
@@ -212,7 +792,7 @@ class wt_string {
     out.write((char*)&n, sizeof(n));
     w_bytes += sizeof(n);
 
-    w_bytes += root.serialize(out);
+    w_bytes += serialize_node(0, out);
 
     w_bytes += ae.serialize(out);
 
@@ -221,232 +801,266 @@ class wt_string {
 
   void load(istream& in) {
     in.read((char*)&n, sizeof(n));
-    root.load(in);
+
+    nodes.clear();
+    load_node(NO_NODE, in);
+    relayout();
+
+    // character bounds, bottom-up: children follow their parents
+    for (uint32_t x = nodes.size(); x > 0; --x) {
+      node& N = nodes[x - 1];
+
+      if (N.is_leaf()) {
+        N.lo_ = N.hi_ = N.label();
+        continue;
+      }
+
+      for (uint32_t y : {N.child0_, N.child1_}) {
+        if (y == NO_NODE) continue;
+
+        N.lo_ = std::min(N.lo_, nodes[y].lo_);
+        N.hi_ = std::max(N.hi_, nodes[y].hi_);
+      }
+    }
+
     ae.load(in);
   }
 
  private:
   class node;
 
-  // current length
-  ulint n = 0;
+  // null child/parent index. The root is never a child, so 0 is free
+  static constexpr uint32_t NO_NODE = 0;
 
-  node root;
+  /*
+   * true iif code B has already been inserted
+   */
+  bool exists(code_t B) const {
+    uint32_t x = 0;
 
-  alphabet_encoder ae;
-};
+    for (uint8_t j = 0; j < B.size(); ++j) {
+      x = B[j] ? nodes[x].child1_ : nodes[x].child0_;
 
-template <class dynamic_bitvector_t>
-class wt_string<dynamic_bitvector_t>::node {
- public:
-  // root constructor
-  node() {}
+      if (x == NO_NODE) return false;
+    }
+
+    return true;
+  }
+
+  // get leaf associated to code B
+  uint32_t get_leaf(code_t B) const {
+    uint32_t x = 0;
 
-  // parent constructor
-  explicit node(node* parent_) { this->parent_ = parent_; }
+    for (uint8_t j = 0; j < B.size(); ++j) x = B[j] ? nodes[x].child1_ : nodes[x].child0_;
+
+    return x;
+  }
 
   /*
-   * copy constructor
+   * create the missing nodes on the path of code B and label its leaf
+   * with c. Returns true iif new nodes were appended to the pool
    */
-  explicit node(const node& other)
-      : child0_(nullptr),
-        child1_(nullptr),
-        parent_(nullptr),
-        l_(0),
-        is_leaf_(false) {
-    *this = other;
-  }
-
-  ~node() {
-    if (has_child0()) {
-      delete child0_;
-      child0_ = NULL;
-    }
+  bool add_path(code_t B, char_type c) {
+    assert(B.size() > 0);
 
-    if (has_child1()) {
-      delete child1_;
-      child1_ = NULL;
-    }
-  }
+    bool created = false;
+    uint32_t x = 0;
 
-  node& operator=(const node& other) {
-    if (!child0_) child0_ = new node();
-    if (other.child0_) {
-      *child0_ = *other.child0_;
-      child0_->parent_ = this;
-    } else {
-      delete child0_;
-      child0_ = nullptr;
+    for (uint8_t j = 0; j < B.size(); ++j) {
+      assert(not nodes[x].is_leaf());
+
+      nodes[x].add_bound(c);
+
+      uint32_t y = B[j] ? nodes[x].child1_ : nodes[x].child0_;
+
+      if (y == NO_NODE) {
+        // pool indices are 32 bits wide
+        assert(nodes.size() < UINT32_MAX);
+
+        y = nodes.size();
+
+        // note: emplace_back may reallocate, so no reference to nodes[x] is held
+        nodes.emplace_back(x);
+        (B[j] ? nodes[x].child1_ : nodes[x].child0_) = y;
+        created = true;
+      }
+
+      x = y;
     }
-    if (!child1_) child1_ = new node();
-    if (other.child1_) {
-      *child1_ = *other.child1_;
-      child1_->parent_ = this;
+
+    if (nodes[x].is_leaf()) {
+      // if it's already marked as leaf, check
+      // that the label is correct
+      assert(c == nodes[x].label());
     } else {
-      delete child1_;
-      child1_ = nullptr;
+      // else, mark node as leaf
+      nodes[x].make_leaf(c);
     }
-    parent_ = other.parent_;
-    bv = other.bv;
-    l_ = other.l_;
-    is_leaf_ = other.is_leaf_;
-    return *this;
-  }
 
-  node(node&& other)
-      : child0_(nullptr),
-        child1_(nullptr),
-        parent_(nullptr),
-        l_(0),
-        is_leaf_(false) {
-    *this = std::move(other);
-  }
-
-  node& operator=(node&& other) {
-    if (this != &other) {
-      if (has_child0()) delete child0_;
-      if (has_child1()) delete child1_;
-      child0_ = other.child0_;
-      if (has_child0()) child0_->parent_ = this;
-      child1_ = other.child1_;
-      if (has_child1()) child1_->parent_ = this;
-      parent_ = other.parent_;
-      bv = std::move(other.bv);
-      l_ = other.l_;
-      is_leaf_ = other.is_leaf_;
-      other.child0_ = nullptr;
-      other.child1_ = nullptr;
-      other.parent_ = nullptr;
-    }
-    return *this;
+    nodes[x].add_bound(c);
+
+    return created;
   }
 
-  // turn this node into a leaf
-  void make_leaf(char_type c) {
-    assert(not has_child0());  // musttnot have children
-    assert(not has_child1());
-    assert(bv.size() == 0);
+  bool add_paths(const map<char_type, code_t>& Bs) {
+    bool created = false;
 
-    assert(not is_root());  // cannot make the root leaf
+    for (auto& p : Bs) created = add_path(p.second, p.first) or created;
 
-    this->is_leaf_ = true;
-    this->l_ = c;
+    return created;
   }
 
-  // descend tree and return character at this position
-  char_type at(ulint i) const {
-    if (is_leaf()) return label();
-
-    assert(i < bv.size());
+  // re-lay out the pool if it has doubled since the last layout
+  void grow_layout() {
+    if (nodes.size() >= 2 * laid_out) relayout();
+  }
 
-    bool b = bv.at(i);
+  /*
+   * reorder the pool in level (BFS) order: children of a node are
+   * adjacent and each level is contiguous
+   */
+  void relayout() {
+    vector<uint32_t> order;
+    order.reserve(nodes.size());
+    order.push_back(0);
 
-    assert((b or has_child0()) and (not b or has_child1()));
+    for (ulint k = 0; k < order.size(); ++k) {
+      const node& N = nodes[order[k]];
 
-    if (b) {
-      return child1_->at(bv.rank1(i));
+      if (N.has_child0()) order.push_back(N.child0_);
+      if (N.has_child1()) order.push_back(N.child1_);
     }
 
-    return child0_->at(bv.rank0(i));
-  }
+    // new index of each old node
+    vector<uint32_t> new_idx(nodes.size());
+    for (ulint k = 0; k < order.size(); ++k) new_idx[order[k]] = k;
 
-  /*
-   * true iif code B has already been inserted
-   */
-  bool exists(const vector<bool>& B, ulint j = 0) const {
-    assert(j <= B.size());
+    vector<node> pool;
+    pool.reserve(order.size());
 
-    // not at the end of B -> (B[j] -> must have child 1)
-    bool c1 = j == B.size() || (not B[j] || has_child1());
+    for (uint32_t old : order) {
+      pool.push_back(std::move(nodes[old]));
 
-    // not at the end of B -> (notB[j] -> must have child 0)
-    bool c0 = j == B.size() || (B[j] || has_child0());
+      node& N = pool.back();
 
-    return (c1 and c0) &&
-           (j == B.size() ? true
-                          : (B[j] ? child1_->exists(B, j + 1)
-                                  : child0_->exists(B, j + 1)));
+      if (N.has_child0()) N.child0_ = new_idx[N.child0_];
+      if (N.has_child1()) N.child1_ = new_idx[N.child1_];
+      if (pool.size() > 1) N.parent_ = new_idx[N.parent_];
+    }
+
+    nodes = std::move(pool);
+    laid_out = nodes.size();
   }
 
   /*
-   * insert code B[j,...,B.size()-1] at position i. This code is associated
-   * with character c
+   * f(x, count, depth) for each leaf x, where count is the number of
+   * occurrences of its character and depth its code length
    */
-  void insert(ulint i, const vector<bool>& B, char_type c, ulint j = 0) {
-    if (j == B.size()) {
-      // this node must be a leaf
-      assert(bv.size() == 0);
+  template <class F>
+  void for_each_leaf(F f) const {
+    // parents come before their children in the pool
+    vector<uint64_t> count(nodes.size(), n), depth(nodes.size(), 0);
 
-      if (is_leaf()) {
-        // if it's already marked as leaf, check
-        // that the label is correct
-        assert(c == label());
+    for (uint32_t x = 0; x < nodes.size(); ++x) {
+      const node& N = nodes[x];
 
-      } else {
-        // else, mark node as leaf
-        make_leaf(c);
+      if (N.is_leaf()) {
+        f(x, count[x], depth[x]);
+        continue;
       }
 
-      return;
+      uint64_t ones = N.bv.rank1(N.bv.size());
+
+      if (N.has_child0()) {
+        count[N.child0_] = N.bv.size() - ones;
+        depth[N.child0_] = depth[x] + 1;
+      }
+      if (N.has_child1()) {
+        count[N.child1_] = ones;
+        depth[N.child1_] = depth[x] + 1;
+      }
     }
+  }
 
-    assert(i <= bv.size());
-    assert(not is_leaf());
+  // current counts as Huffman probabilities (characters with a leaf only)
+  vector<pair<char_type, double>> probabilities() const {
+    vector<pair<char_type, double>> P;
 
-    bool b = B[j];
-    bv.insert(i, b);
+    for (auto& e : char_counts()) P.push_back({e.first, double(e.second)});
 
-    if (b) {
-      // if child does not exist, create it.
-      if (not has_child1()) {
-        child1_ = new node(this);
-      }
+    return P;
+  }
 
-      assert(j == B.size() - 1 or bv.rank1(i) <= child1_->bv.size());
+  // the whole string
+  vector<char_type> extract_all() const {
+    vector<char_type> res;
+    res.reserve(size());
+    extract(0, size(), std::back_inserter(res));
+    return res;
+  }
 
-      child1_->insert(bv.rank1(i), B, c, j + 1);
+  // push the non-empty children of N, with their ranges, on stack S
+  void push_children(const node& N, uint64_t l, uint64_t r,
+                     vector<std::tuple<uint32_t, uint64_t, uint64_t>>& S) const {
+    uint64_t l0 = N.bv.rank0(l);
+    uint64_t r0 = N.bv.rank0(r);
 
-    } else {
-      if (not has_child0()) {
-        child0_ = new node(this);
-      }
+    if (r0 > l0) S.push_back(std::make_tuple(N.child0_, l0, r0));
+    if (r - l > r0 - l0) S.push_back(std::make_tuple(N.child1_, l - l0, r - r0));
+  }
+
+  // distinct characters (with frequencies) in range [l, r) of node x
+  vector<pair<char_type, uint64_t>> distinct(uint32_t x, uint64_t l, uint64_t r) const {
+    vector<pair<char_type, uint64_t>> res;
+
+    vector<std::tuple<uint32_t, uint64_t, uint64_t>> S;
+    if (l < r) S.push_back(std::make_tuple(x, l, r));
+
+    while (not S.empty()) {
+      uint64_t a, b;
+      std::tie(x, a, b) = S.back();
+      S.pop_back();
+
+      const node& N = nodes[x];
 
-      assert(j == B.size() - 1 or bv.rank0(i) <= child0_->bv.size());
+      if (N.is_leaf()) {
+        res.push_back({N.label(), b - a});
+        continue;
+      }
 
-      child0_->insert(bv.rank0(i), B, c, j + 1);
+      push_children(N, a, b, S);
     }
+
+    return res;
   }
 
+  /*
+   * fill the bitvectors of the subtree rooted in x with the j-th bits of the
+   * codes of values[offset...]. The paths of all codes in Bs must already
+   * exist, so that subtrees can be filled in parallel without touching the pool
+   */
   template <class Vector>
-  void push_many(const map<char_type, vector<bool>>& Bs, const Vector& values,
-                 ulint j = 0, ulint offset = 0) {
-    if (Bs.size() == 1) {
+  void push_many(uint32_t x, const map<char_type, code_t>& Bs,
+                 const Vector& values, ulint j = 0, ulint offset = 0) {
+    if (Bs.size() == 1 && j == Bs.begin()->second.size()) {
       // this node must be a leaf
-      assert(bv.size() == 0);
-
-      auto c = Bs.begin()->first;
-      assert(j == Bs.at(c).size());
+      assert(nodes[x].bv.size() == 0);
+      assert(nodes[x].label() == Bs.begin()->first);
 
-      if (is_leaf()) {
-        // if it's already marked as leaf, check
-        // that the label is correct
-        assert(c == label());
-      } else {
-        // else, mark node as leaf
-        make_leaf(c);
-      }
       return;
     }
 
-    assert(not is_leaf());
+    node& N = nodes[x];
+
+    assert(not N.is_leaf());
 
     bool task_started_0 = false;
     bool task_started_1 = false;
 
     tsl::hopscotch_map<char_type, bool> assignment;
-    map<char_type, vector<bool>> Bs_left, Bs_right;
+    map<char_type, code_t> Bs_left, Bs_right;
     for_each(Bs.begin(), Bs.end(),
-             [&](const pair<char_type, vector<bool>>& pair) {
+             [&](const pair<char_type, code_t>& pair) {
                if (pair.second[j]) {
                  Bs_right.insert(pair);
                } else {
@@ -468,7 +1082,7 @@ class wt_string<dynamic_bitvector_t>::node {
       word |= b << num_bits;
 
       if (++num_bits == 64) {
-        bv.push_word(word, 64);
+        N.bv.push_word(word, 64);
         word = 0;
         num_bits = 0;
       }
@@ -476,222 +1090,168 @@ class wt_string<dynamic_bitvector_t>::node {
       if (b && !task_started_1) {
         task_started_1 = true;
 
-        if (not has_child1()) child1_ = new node(this);
-
         #pragma omp task shared(values, Bs_right)
-        child1_->push_many(Bs_right, values, j + 1, idx);
+        push_many(N.child1_, Bs_right, values, j + 1, idx);
       }
 
       if (!b && !task_started_0) {
         task_started_0 = true;
 
-        if (not has_child0()) child0_ = new node(this);
-
         #pragma omp task shared(values, Bs_left)
-        child0_->push_many(Bs_left, values, j + 1, idx);
+        push_many(N.child0_, Bs_left, values, j + 1, idx);
       }
     }
 
-    if (num_bits) bv.push_word(word, num_bits);
+    if (num_bits) N.bv.push_word(word, num_bits);
 
     #pragma omp taskwait
   }
 
-  /*
-   * remove code B[j,...,B.size()-1] from position i. This code is associated
-   * with character c
-   */
-  void remove(ulint i, const vector<bool>& B, char_type c, ulint j = 0) {
-    if (j == B.size()) {
-      // TODO: Check if leaf should be deleted?
-
-      // this node must be a leaf
-      assert(bv.size() == 0);
-      assert(c == label());
-      // if(is_leaf()){
-
-      //    //if it's already marked as leaf, check
-      //    //that the label is correct
-      //    assert(c==label());
-
-      // }else{
+  // pre-order, same format as the former pointer-based tree
+  ulint serialize_node(uint32_t x, ostream& out) const {
+    const node& N = nodes[x];
+    ulint w_bytes = 0;
 
-      //    //else, mark node as leaf
-      //    make_leaf(c);
+    out.write((char*)&N.l_, sizeof(N.l_));
+    w_bytes += sizeof(N.l_);
 
-      // }
+    out.write((char*)&N.is_leaf_, sizeof(N.is_leaf_));
+    w_bytes += sizeof(N.is_leaf_);
 
-      return;
-    }
+    w_bytes += N.bv.serialize(out);
 
-    assert(i <= (bv.size() - 1));
-    assert(not is_leaf());
+    bool has_child0 = N.has_child0();
+    bool has_child1 = N.has_child1();
 
-    bool b = B[j];
+    out.write((char*)&has_child0, sizeof(has_child0));
+    w_bytes += sizeof(has_child0);
 
-    assert(b == bv.at(i));
+    out.write((char*)&has_child1, sizeof(has_child1));
+    w_bytes += sizeof(has_child1);
 
-    if (b) {
-      // TODO: delete empty nodes?
+    if (has_child0) w_bytes += serialize_node(N.child0_, out);
+    if (has_child1) w_bytes += serialize_node(N.child1_, out);
 
-      assert(j == B.size() - 1 or bv.rank1(i) <= child1_->bv.size());
+    return w_bytes;
+  }
 
-      child1_->remove(bv.rank1(i), B, c, j + 1);
+  // load a subtree, append its nodes to the pool and return its root index
+  uint32_t load_node(uint32_t parent, istream& in) {
+    uint32_t x = nodes.size();
+    nodes.emplace_back(parent);
 
-    } else {
-      assert(j == B.size() - 1 or bv.rank0(i) <= child0_->bv.size());
+    in.read((char*)&nodes[x].l_, sizeof(nodes[x].l_));
 
-      child0_->remove(bv.rank0(i), B, c, j + 1);
-    }
+    in.read((char*)&nodes[x].is_leaf_, sizeof(nodes[x].is_leaf_));
 
-    bv.remove(i);
-  }
+    nodes[x].bv.load(in);
 
-  ulint rank(ulint i, const vector<bool>& B, ulint j = 0) const {
-    assert(j <= B.size());
+    bool has_child0;
+    bool has_child1;
 
-    // not at the end of B -> (B[j] -> must have child 1)
-    assert(j == B.size() || (not B[j] || has_child1()));
+    in.read((char*)&has_child0, sizeof(has_child0));
+    in.read((char*)&has_child1, sizeof(has_child1));
 
-    // not at the end of B -> (notB[j] -> must have child 0)
-    assert(j == B.size() || (B[j] || has_child0()));
+    if (has_child0) {
+      uint32_t y = load_node(x, in);
+      nodes[x].child0_ = y;
+    }
 
-    // not at the end of B -> i must be smaller than bv.size()
-    assert(j == B.size() || i <= bv.size());
+    if (has_child1) {
+      uint32_t y = load_node(x, in);
+      nodes[x].child1_ = y;
+    }
 
-    return j == B.size() ? i
-                         : (B[j] ? child1_->rank(bv.rank1(i), B, j + 1)
-                                 : child0_->rank(bv.rank0(i), B, j + 1));
+    return x;
   }
 
-  ulint select(ulint i, const vector<bool>& B) const {
-    // top-down: find leaf associated with B
-    const node* L = get_leaf(B);
+  // current length
+  ulint n = 0;
 
-    auto p = L->parent_;
+  // node pool, parents before children. nodes[0] is the root
+  vector<node> nodes = vector<node>(1);
 
-    // bottom-up: from leaf to root
-    return p->select(i, B, B.size() - 1);
-  }
+  // pool size at the last (level-order) layout
+  ulint laid_out = 1;
 
-  ulint select(ulint i, const vector<bool>& B, ulint j) {
-    auto s = bv.select(i, B[j]);
+  alphabet_encoder ae;
+};
 
-    return j == 0 ? s : parent_->select(s, B, j - 1);
-  }
+template <class dynamic_bitvector_t>
+class wt_string<dynamic_bitvector_t>::node {
+ public:
+  node() {}
 
-  // get leaf associated to code B
-  const node* get_leaf(const vector<bool>& B, ulint j = 0) const {
-    assert(j <= B.size());
+  explicit node(uint32_t parent) : parent_(parent) {}
+
+  node(const node&) = default;
+  node& operator=(const node&) = default;
+
+  // noexcept, so that the pool relocates nodes instead of copying them
+  node(node&& other) noexcept
+      : child0_(other.child0_),
+        child1_(other.child1_),
+        parent_(other.parent_),
+        bv(std::move(other.bv)),
+        l_(other.l_),
+        is_leaf_(other.is_leaf_),
+        lo_(other.lo_),
+        hi_(other.hi_) {}
+
+  node& operator=(node&& other) noexcept {
+    child0_ = other.child0_;
+    child1_ = other.child1_;
+    parent_ = other.parent_;
+    bv = std::move(other.bv);
+    l_ = other.l_;
+    is_leaf_ = other.is_leaf_;
+    lo_ = other.lo_;
+    hi_ = other.hi_;
+    return *this;
+  }
 
-    return j == B.size() ? this
-                         : (B[j] ? child1_->get_leaf(B, j + 1)
-                                 : child0_->get_leaf(B, j + 1)
+  // turn this node into a leaf
+  void make_leaf(char_type c) {
+    assert(not has_child0());  // musttnot have children
+    assert(not has_child1());
+    assert(bv.size() == 0);
 
-                           );
+    this->is_leaf_ = true;
+    this->l_ = c;
   }
 
-  bool is_root() const { return not parent_; }
   bool is_leaf() const { return is_leaf_; }
-  bool has_child0() const { return child0_; }
-  bool has_child1() const { return child1_; }
+  bool has_child0() const { return child0_ != NO_NODE; }
+  bool has_child1() const { return child1_ != NO_NODE; }
 
-  /*
-   * to have left label, this node must not have a left (0)
-   * child AND must have at least one bit equal to 0 in
-   * its bitvector
-   */
   char_type label() const {
     assert(is_leaf());
     return l_;
   }
 
-  /*
-   * Total number of bits allocated in RAM for this structure
-   *
-   * WARNING: this measure is good only for relatively small alphabets (e.g.
-   * ASCII) as we use STL containers such as set and map which do not give
-   * direct info on the total memory allocated. The sizes of these containers
-   * are proportional to the alphabet size (but the constants involved are
-   * high since internally they can use heavy structures as RBT)
-   */
-  ulint bit_size() const {
-    ulint size = sizeof(node) * 8;
-
-    size += bv.bit_size();
-    if (child0_ != NULL) size += child0_->bit_size();
-    if (child1_ != NULL) size += child1_->bit_size();
-
-    return size;
-  }
-
-  ulint serialize(ostream& out) const {
-    ulint w_bytes = 0;
-
-    out.write((char*)&l_, sizeof(l_));
-    w_bytes += sizeof(l_);
-
-    out.write((char*)&is_leaf_, sizeof(is_leaf_));
-    w_bytes += sizeof(is_leaf_);
-
-    w_bytes += bv.serialize(out);
-
-    bool has_child0 = child0_ != NULL;
-    bool has_child1 = child1_ != NULL;
-
-    out.write((char*)&has_child0, sizeof(has_child0));
-    w_bytes += sizeof(has_child0);
-
-    out.write((char*)&has_child1, sizeof(has_child1));
-    w_bytes += sizeof(has_child1);
-
-    if (child0_) w_bytes += child0_->serialize(out);
-    if (child1_) w_bytes += child1_->serialize(out);
-
-    return w_bytes;
-  }
-
-  void load(istream& in) {
-    in.read((char*)&l_, sizeof(l_));
-
-    in.read((char*)&is_leaf_, sizeof(is_leaf_));
-
-    bv.load(in);
-
-    bool has_child0;
-    bool has_child1;
-
-    in.read((char*)&has_child0, sizeof(has_child0));
-    in.read((char*)&has_child1, sizeof(has_child1));
-
-    child0_ = NULL;
-    child1_ = NULL;
-
-    if (has_child0) {
-      child0_ = new node();
-      child0_->load(in);
-      child0_->parent_ = this;
-    }
-
-    if (has_child1) {
-      child1_ = new node();
-      child1_->load(in);
-      child1_->parent_ = this;
-    }
+  // character c has a leaf below this node
+  void add_bound(char_type c) {
+    lo_ = std::min(lo_, c);
+    hi_ = std::max(hi_, c);
   }
 
- private:
-  node* child0_ = NULL;
-  node* child1_ = NULL;
-  node* parent_ = NULL;  // parent (NULL if root)
+  // pool indices (NO_NODE if absent; parent_ is meaningless for the root)
+  uint32_t child0_ = NO_NODE;
+  uint32_t child1_ = NO_NODE;
+  uint32_t parent_ = NO_NODE;
 
   dynamic_bitvector_t bv;
 
   // if is_leaf_, then node is labeled
   char_type l_ = 0;
   bool is_leaf_ = false;
+
+  // smallest and largest character of the leaves below this node
+  char_type lo_ = ~char_type(0);
+  char_type hi_ = 0;
 };
 
+
 }  // namespace dyn
 
 #endif /* INCLUDE_INTERNAL_WT_STRING_HPP_ */
@@ -374,4 +374,1320 @@ void remove_test(const uint64_t size) {
         }
     }
     delete tree;
-}
\ No newline at end of file
+}
+
+template <class T>
+void append_runs_test(const uint64_t size) {
+    auto bv = new T();
+    std::vector<bool> control;
+    for (uint64_t i = 0; i < 10; i++) {
+        bool b = rand() % 2;
+        bv->push_back(b);
+        control.push_back(b);
+    }
+    std::vector<uint64_t> runs(size);
+    for (auto& k : runs) {
+        k = 1 + rand() % 8;
+        control.insert(control.end(), k - 1, false);
+        control.push_back(true);
+    }
+    bv->append_runs(runs.begin(), runs.end());
+    ASSERT_EQ(bv->size(), control.size());
+    uint64_t r = 0;
+    for (uint64_t i = 0; i < control.size(); i++) {
+        EXPECT_EQ(bv->at(i), control[i]) << "Value at " << i;
+        EXPECT_EQ(bv->rank1(i), r) << "Rank at " << i;
+        r += control[i];
+    }
+    EXPECT_EQ(bv->rank1(), r);
+    for (uint64_t i = 0; i < 100; i++) {
+        uint64_t j = rand() % (control.size() + 1);
+        bv->insert(j, i % 2);
+        control.insert(control.begin() + j, i % 2);
+    }
+    for (uint64_t i = 0; i < control.size(); i++) {
+        EXPECT_EQ(bv->at(i), control[i]) << "Value after insert at " << i;
+    }
+    delete bv;
+}
+
+template <class T>
+void push_many_test(const uint64_t prefix, const uint64_t size) {
+    T s;
+    std::vector<uint64_t> control;
+    for (uint64_t i = 0; i < prefix; i++) {
+        uint64_t x = rand() % 1000;
+        s.push_back(x);
+        control.push_back(x);
+    }
+    std::vector<uint64_t> values(size);
+    for (auto& x : values) x = rand() % 1000;
+    s.push_many(values.begin(), values.end());
+    control.insert(control.end(), values.begin(), values.end());
+    ASSERT_EQ(s.size(), control.size());
+    uint64_t psum = 0;
+    for (uint64_t i = 0; i < control.size(); i++) {
+        EXPECT_EQ(s.at(i), control[i]) << "Value at " << i;
+        psum += control[i];
+    }
+    EXPECT_EQ(s.psum(), psum);
+    // the leaves must still respect their bounds under updates
+    for (uint64_t i = 0; i < 2000 && control.size() > 0; i++) {
+        uint64_t j = rand() % control.size();
+        if (i % 2) {
+            s.remove(j);
+            control.erase(control.begin() + j);
+        } else {
+            s.insert(j, i);
+            control.insert(control.begin() + j, i);
+        }
+    }
+    ASSERT_EQ(s.size(), control.size());
+    for (uint64_t i = 0; i < control.size(); i++) {
+        EXPECT_EQ(s.at(i), control[i]) << "Value after updates at " << i;
+    }
+}
+
+template <class T>
+void rle_append_runs_test(const uint64_t nr_runs, const uint64_t sigma) {
+    T a, b;
+    // both strings start with the same prefix, so that the first run may
+    // extend the last run of the string
+    for (uint64_t i = 0; i < 5; i++) {
+        uint64_t c = 'a' + rand() % sigma;
+        a.push_back(c);
+        b.push_back(c);
+    }
+    std::vector<std::pair<uint64_t, uint64_t>> runs(nr_runs);
+    for (auto& r : runs) {
+        // adjacent runs of the same character are allowed
+        r = {'a' + rand() % sigma, 1 + rand() % 3};
+    }
+    a.append_runs(runs.begin(), runs.end());
+    for (auto r : runs) {
+        for (uint64_t k = 0; k < r.second; k++) b.push_back(r.first);
+    }
+    ASSERT_EQ(a.size(), b.size());
+    ASSERT_EQ(a.number_of_runs(), b.number_of_runs());
+    uint64_t step = 1 + a.size() / 20000;
+    for (uint64_t i = 0; i < a.size(); i += step) {
+        ASSERT_EQ(a.at(i), b.at(i)) << "Value at " << i;
+        for (uint64_t c = 'a'; c < 'a' + sigma; c++) {
+            ASSERT_EQ(a.rank(i, c), b.rank(i, c)) << "Rank at " << i;
+        }
+    }
+    for (uint64_t c = 'a'; c < 'a' + sigma; c++) {
+        uint64_t nr = b.rank(b.size(), c);
+        for (uint64_t j = 0; j < nr; j += 1 + nr / 1000) {
+            ASSERT_EQ(a.select(j, c), b.select(j, c)) << "Select " << j;
+        }
+    }
+}
+
+template <class T>
+void update_intervals_test(const uint64_t size, const uint64_t nonNIL, const uint64_t updates) {
+    const uint64_t NIL = ~uint64_t(0);
+    T a(size), b(size);
+    std::vector<uint64_t> control(size, NIL);
+    for (uint64_t i = 0; i < nonNIL; i++) {
+        uint64_t j = rand() % size;
+        uint64_t x = rand() % 1000;
+        a.set(j, x);
+        b.set(j, x);
+        control[j] = x;
+    }
+    // sorted, pairwise disjoint intervals
+    std::vector<std::tuple<uint64_t, uint64_t, std::pair<uint64_t, uint64_t>>> U;
+    uint64_t width = size / updates;
+    for (uint64_t u = 0; u < updates; u++) {
+        uint64_t l = u * width + rand() % width;
+        uint64_t r = l + 1 + rand() % ((u + 1) * width - l);
+        uint64_t k = l + rand() % (r - l);
+        U.push_back(std::make_tuple(rand() % 1000, k, std::make_pair(l, r)));
+    }
+    a.update_intervals(U);
+    for (auto& u : U) {
+        uint64_t j = std::get<0>(u), k = std::get<1>(u);
+        uint64_t l = std::get<2>(u).first, r = std::get<2>(u).second;
+        b.update_interval(j, k, {l, r});
+        // naive model
+        std::vector<uint64_t> idx;
+        for (uint64_t i = l; i < r; i++) {
+            if (control[i] != NIL) idx.push_back(i);
+        }
+        if (idx.size() <= 1) {
+            control[k] = j;
+        } else if (k <= idx.front()) {
+            control[idx.front()] = NIL;
+            control[k] = j;
+        } else if (k >= idx.back()) {
+            control[idx.back()] = NIL;
+            control[k] = j;
+        }
+    }
+    ASSERT_EQ(a.size(), control.size());
+    ASSERT_EQ(a.number_of_nonNIL_elements(), b.number_of_nonNIL_elements());
+    for (uint64_t i = 0; i < size; i++) {
+        ASSERT_EQ(a.at(i), control[i]) << "Batch value at " << i;
+        ASSERT_EQ(b.at(i), control[i]) << "Sequential value at " << i;
+    }
+}
+
+template <class T>
+void sparse_iterator_test(const uint64_t size, const uint64_t nonNIL) {
+    const uint64_t NIL = ~uint64_t(0);
+    T v(size);
+    for (uint64_t i = 0; i < nonNIL; i++) v.set(rand() % size, rand() % 1000);
+    std::vector<std::pair<uint64_t, uint64_t>> control;
+    for (uint64_t i = 0; i < size; i++) {
+        if (v.at(i) != NIL) control.push_back({i, v.at(i)});
+    }
+    std::vector<std::pair<uint64_t, uint64_t>> iterated;
+    for (auto e : v) iterated.push_back(e);
+    ASSERT_EQ(iterated, control);
+    for (uint64_t q = 0; q < 1000; q++) {
+        uint64_t i = rand() % (size + 1);
+        auto it = v.lower_bound(i);
+        auto c = std::lower_bound(control.begin(), control.end(), std::make_pair(i, uint64_t(0)));
+        // a few steps from the starting point
+        for (uint64_t t = 0; t < 5 && c != control.end(); t++, ++it, ++c) {
+            ASSERT_TRUE(it != v.end());
+            ASSERT_EQ(*it, *c) << "lower_bound(" << i << ") + " << t;
+        }
+        if (c == control.end()) {
+            ASSERT_TRUE(it == v.end());
+        }
+    }
+}
+
+template <class T>
+void ones_iterator_test(const uint64_t size) {
+    T bv;
+    std::vector<uint64_t> ones;
+    for (uint64_t i = 0; i < size; i++) {
+        bool b = rand() % 5 == 0;
+        bv.push_back(b);
+        if (b) ones.push_back(i);
+    }
+    std::vector<uint64_t> iterated;
+    for (auto it = bv.ones_begin(); it != bv.ones_end(); ++it) iterated.push_back(*it);
+    ASSERT_EQ(iterated, ones);
+    for (uint64_t q = 0; q < 1000; q++) {
+        uint64_t j = rand() % (ones.size() + 1);
+        auto it = bv.ones_from(j);
+        for (uint64_t t = 0; t < 5 && j + t < ones.size(); t++, ++it) {
+            ASSERT_EQ(it.rank(), j + t);
+            ASSERT_EQ(*it, ones[j + t]) << "ones_from(" << j << ") + " << t;
+        }
+        if (j + 5 >= ones.size()) {
+            ASSERT_TRUE(it == bv.ones_end());
+        }
+    }
+}
+
+template <class T>
+void next_prev_test(const uint64_t size) {
+    auto tree = new T();
+    std::vector<bool> control;
+    // long runs of zeros and ones, so that whole leaves/subtrees are skipped
+    while (control.size() < size) {
+        bool b = rand() % 2;
+        uint64_t len = rand() % 2 ? 1 + rand() % 8 : 1 + rand() % 20000;
+        for (uint64_t i = 0; i < len && control.size() < size; i++) {
+            tree->push_back(b);
+            control.push_back(b);
+        }
+    }
+    // a few random inserts (pending buffered operations in the leaves)
+    for (uint64_t i = 0; i < 50; i++) {
+        uint64_t j = rand() % (control.size() + 1);
+        tree->insert(j, i % 2);
+        control.insert(control.begin() + j, i % 2);
+    }
+    uint64_t n = control.size();
+    std::vector<uint64_t> next1(n + 1, n), next0(n + 1, n), prev1(n, n);
+    for (uint64_t i = n; i > 0; i--) {
+        next1[i - 1] = control[i - 1] ? i - 1 : next1[i];
+        next0[i - 1] = control[i - 1] ? next0[i] : i - 1;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        prev1[i] = control[i] ? i : (i == 0 ? n : prev1[i - 1]);
+    }
+    for (uint64_t i = 0; i <= n; i++) {
+        ASSERT_EQ(tree->next1(i), next1[i]) << "next1(" << i << ")";
+        ASSERT_EQ(tree->next0(i), next0[i]) << "next0(" << i << ")";
+        if (i < n) {
+            ASSERT_EQ(tree->prev1(i), prev1[i]) << "prev1(" << i << ")";
+        }
+    }
+    for (uint64_t t = 0; t < 100; t++) {
+        uint64_t l = rand() % (n + 1);
+        uint64_t r = l + rand() % (n + 1 - l);
+        std::vector<uint64_t> ones;
+        tree->for_each_one(l, r, [&](uint64_t j) { ones.push_back(j); });
+        std::vector<uint64_t> expected;
+        for (uint64_t j = next1[l]; j < r; j = next1[j + 1]) expected.push_back(j);
+        ASSERT_EQ(ones, expected) << "for_each_one(" << l << ", " << r << ")";
+    }
+    delete tree;
+}
+
+template <class T, class U>
+void set_ops_test(const uint64_t size_a, const uint64_t size_b) {
+    auto a = new T();
+    auto b = new U();
+    std::vector<bool> ca, cb;
+    for (uint64_t i = 0; i < size_a; i++) {
+        bool x = rand() % 3 == 0;
+        a->push_back(x);
+        ca.push_back(x);
+    }
+    for (uint64_t i = 0; i < size_b; i++) {
+        bool x = rand() % 2;
+        b->push_back(x);
+        cb.push_back(x);
+    }
+    // random inserts, so that the leaves of a and b do not line up
+    for (uint64_t i = 0; i < 100; i++) {
+        uint64_t j = rand() % (ca.size() + 1);
+        a->insert(j, i % 2);
+        ca.insert(ca.begin() + j, i % 2);
+    }
+    uint64_t n = std::max(ca.size(), cb.size());
+    uint64_t and_cnt = 0, or_cnt = 0, xor_cnt = 0;
+    std::vector<bool> ox(n);
+    for (uint64_t i = 0; i < n; i++) {
+        bool x = i < ca.size() && ca[i];
+        bool y = i < cb.size() && cb[i];
+        and_cnt += x & y;
+        or_cnt += x | y;
+        xor_cnt += x ^ y;
+        ox[i] = x ^ y;
+    }
+    EXPECT_EQ(a->and_count(*b), and_cnt);
+    EXPECT_EQ(a->or_count(*b), or_cnt);
+    EXPECT_EQ(a->xor_count(*b), xor_cnt);
+    EXPECT_EQ(b->and_count(*a), and_cnt);
+
+    control_bv out;
+    a->xor_into(*b, out);
+    ASSERT_EQ(out.size(), n);
+    for (uint64_t i = 0; i < n; i++) {
+        EXPECT_EQ(out.at(i), ox[i]) << "xor at " << i;
+    }
+    delete a;
+    delete b;
+}
+
+template <class T>
+void range_queries_test(const uint64_t size, const uint64_t sigma) {
+    std::vector<uint64_t> control(size);
+    for (auto& c : control) c = rand() % sigma;
+    auto s = new T(sigma, control);
+    // inserts after the bulk construction
+    for (uint64_t i = 0; i < 100; i++) {
+        uint64_t j = rand() % (control.size() + 1);
+        uint64_t c = rand() % sigma;
+        s->insert(j, c);
+        control.insert(control.begin() + j, c);
+    }
+    uint64_t n = control.size();
+    for (uint64_t t = 0; t < 200; t++) {
+        uint64_t l = rand() % (n + 1);
+        uint64_t r = l + rand() % (n + 1 - l);
+        std::map<uint64_t, uint64_t> freq;
+        for (uint64_t i = l; i < r; i++) freq[control[i]]++;
+        std::vector<uint64_t> sorted(control.begin() + l, control.begin() + r);
+        std::sort(sorted.begin(), sorted.end());
+
+        uint64_t cmin = rand() % sigma, cmax = cmin + rand() % sigma;
+        uint64_t cnt = 0;
+        for (auto& e : freq) cnt += e.first >= cmin && e.first <= cmax ? e.second : 0;
+        ASSERT_EQ(s->range_count(l, r, cmin, cmax), cnt) << "range_count(" << l << ", " << r << ")";
+
+        if (l < r) {
+            uint64_t k = rand() % (r - l);
+            ASSERT_EQ(s->range_quantile(l, r, k), sorted[k]) << "range_quantile(" << l << ", " << r << ")";
+        }
+
+        auto d = s->range_distinct(l, r);
+        std::vector<std::pair<uint64_t, uint64_t>> expected(freq.begin(), freq.end());
+        ASSERT_EQ(d, expected) << "range_distinct(" << l << ", " << r << ")";
+
+        auto top = s->range_top_k(l, r, 5);
+        ASSERT_EQ(top.size(), std::min<uint64_t>(5, freq.size()));
+        std::vector<uint64_t> fs;
+        for (auto& e : freq) fs.push_back(e.second);
+        std::sort(fs.rbegin(), fs.rend());
+        for (uint64_t i = 0; i < top.size(); i++) {
+            EXPECT_EQ(top[i].second, fs[i]) << "range_top_k rank " << i;
+            EXPECT_EQ(freq[top[i].first], top[i].second);
+        }
+
+        uint64_t x = rand() % (sigma + 1);
+        auto it = freq.lower_bound(x);
+        auto next = s->range_next_value(l, r, x);
+        ASSERT_EQ(next.first, it != freq.end());
+        if (next.first) {
+            ASSERT_EQ(next.second, it->first);
+        }
+    }
+    delete s;
+}
+
+template <class T>
+void bulk_construct_test(const uint64_t size, const uint64_t sigma) {
+    std::vector<uint64_t> control(size);
+    for (auto& c : control) c = rand() % sigma;
+    auto bulk = new T(sigma, control);
+    auto incremental = new T(sigma);
+    for (auto c : control) incremental->push_back(c);
+    ASSERT_EQ(bulk->size(), control.size());
+    for (uint64_t i = 0; i < size; i++) {
+        ASSERT_EQ(bulk->at(i), control[i]) << "Value at " << i;
+    }
+    for (uint64_t t = 0; t < 1000; t++) {
+        uint64_t i = rand() % (size + 1);
+        uint64_t c = rand() % sigma;
+        ASSERT_EQ(bulk->rank(i, c), incremental->rank(i, c)) << "rank(" << i << ", " << c << ")";
+    }
+    delete bulk;
+    delete incremental;
+}
+
+template <class T>
+void alphabet_growth_test(const uint64_t size) {
+    auto s = new T(2);
+    std::vector<uint64_t> control;
+    // the alphabet doubles every size/8 insertions
+    for (uint64_t i = 0; i < size; i++) {
+        uint64_t sigma = uint64_t(2) << (8 * i / size);
+        uint64_t j = rand() % (control.size() + 1);
+        uint64_t c = rand() % sigma;
+        s->insert(j, c);
+        control.insert(control.begin() + j, c);
+    }
+    // updates, also with values that need more levels
+    for (uint64_t i = 0; i < size / 4; i++) {
+        uint64_t j = rand() % control.size();
+        uint64_t c = i % 100 == 99 ? rand() % 100000 : rand() % 512;
+        s->update(j, c);
+        control[j] = c;
+    }
+    ASSERT_EQ(s->size(), control.size());
+    std::map<uint64_t, uint64_t> rank;
+    for (uint64_t i = 0; i < control.size(); i++) {
+        ASSERT_EQ(s->at(i), control[i]) << "Value at " << i;
+        if (i % 7 == 0) {
+            ASSERT_EQ(s->rank(i, control[i]), rank[control[i]]) << "rank at " << i;
+        }
+        rank[control[i]]++;
+    }
+    delete s;
+}
+
+template <class T>
+void batch_queries_test(const uint64_t size, const uint64_t sigma, const uint64_t queries) {
+    std::vector<uint64_t> control(size);
+    for (auto& c : control) c = rand() % sigma;
+    auto s = new T(sigma, control);
+    std::vector<uint64_t> positions(queries);
+    std::vector<std::pair<uint64_t, uint64_t>> ranks(queries), selects(queries);
+    std::map<uint64_t, uint64_t> count;
+    for (auto c : control) count[c]++;
+    for (uint64_t k = 0; k < queries; k++) {
+        positions[k] = rand() % size;
+        ranks[k] = {rand() % (size + 1), rand() % (sigma + 2)};
+        uint64_t c = control[rand() % size];
+        selects[k] = {1 + rand() % count[c], c};
+    }
+    auto values = s->access_batch(positions);
+    auto r = s->rank_batch(ranks);
+    auto sel = s->select_batch(selects);
+    ASSERT_EQ(values.size(), queries);
+    ASSERT_EQ(r.size(), queries);
+    ASSERT_EQ(sel.size(), queries);
+    for (uint64_t k = 0; k < queries; k++) {
+        EXPECT_EQ(values[k], control[positions[k]]) << "access " << positions[k];
+        EXPECT_EQ(r[k], s->rank(ranks[k].first, ranks[k].second)) << "rank " << k;
+        EXPECT_EQ(sel[k], s->select(selects[k].first, selects[k].second)) << "select " << k;
+    }
+    delete s;
+}
+
+template <class T>
+void huffman_string_test(const uint64_t size, const uint64_t sigma) {
+    // geometric probabilities: unrestricted Huffman codes would be sigma-1 bits long
+    std::vector<std::pair<uint64_t, double>> P;
+    for (uint64_t c = 0; c < sigma; c++) P.push_back({c * 3, std::pow(0.5, c)});
+    auto s = new T(P);
+    std::vector<uint64_t> control;
+    for (uint64_t i = 0; i < size; i++) {
+        uint64_t c = 3 * std::min<uint64_t>(sigma - 1, __builtin_ctzll(rand() | (1ull << 40)));
+        uint64_t j = rand() % (control.size() + 1);
+        s->insert(j, c);
+        control.insert(control.begin() + j, c);
+    }
+    std::stringstream ss;
+    s->serialize(ss);
+    auto t = new T();
+    t->load(ss);
+    std::map<uint64_t, uint64_t> rank;
+    for (uint64_t i = 0; i < control.size(); i++) {
+        ASSERT_EQ(s->at(i), control[i]) << "Value at " << i;
+        ASSERT_EQ(t->at(i), control[i]) << "Loaded value at " << i;
+        ASSERT_EQ(t->rank(i, control[i]), rank[control[i]]) << "rank at " << i;
+        ASSERT_EQ(t->select(rank[control[i]], control[i]), i) << "select at " << i;
+        rank[control[i]]++;
+    }
+    delete s;
+    delete t;
+}
+
+template<class T>
+void reshape_test(const uint64_t size, const uint64_t sigma) {
+    // fixed-length codes on a skewed (geometric) distribution
+    auto s = new T(sigma);
+    std::vector<uint64_t> control;
+    for (uint64_t i = 0; i < size; i++) {
+        uint64_t c = std::min<uint64_t>(sigma - 1, __builtin_ctzll(rand() | (1ull << 40)));
+        uint64_t j = rand() % (control.size() + 1);
+        s->insert(j, c);
+        control.insert(control.begin() + j, c);
+    }
+    std::map<uint64_t, uint64_t> count;
+    for (auto c : control) count[c]++;
+    for (auto e : s->char_counts()) ASSERT_EQ(e.second, count[e.first]) << "count of " << e.first;
+    ASSERT_TRUE(s->should_reshape());
+    uint64_t bits = s->bit_size();
+    s->reshape();
+    ASSERT_FALSE(s->should_reshape());
+    ASSERT_LT(s->bit_size(), bits);
+    ASSERT_LE(s->entropy(), s->avg_code_length());
+    ASSERT_LT(s->avg_code_length(), s->entropy() + 1);
+    // the reshaped string is still dynamic
+    for (uint64_t i = 0; i < size / 10; i++) {
+        uint64_t j = rand() % (control.size() + 1);
+        s->insert(j, control[i]);
+        control.insert(control.begin() + j, control[i]);
+    }
+    std::map<uint64_t, uint64_t> rank;
+    for (uint64_t i = 0; i < control.size(); i++) {
+        ASSERT_EQ(s->at(i), control[i]) << "Value at " << i;
+        ASSERT_EQ(s->rank(i, control[i]), rank[control[i]]) << "rank at " << i;
+        ASSERT_EQ(s->select(rank[control[i]], control[i]), i) << "select at " << i;
+        rank[control[i]]++;
+    }
+    // the alphabet is still open: new characters get escape codes, also
+    // after a serialization
+    for (uint64_t i = 0; i < 100; i++) {
+        uint64_t c = sigma + i % 20;
+        uint64_t j = rand() % (control.size() + 1);
+        s->insert(j, c);
+        control.insert(control.begin() + j, c);
+    }
+    std::stringstream ss;
+    s->serialize(ss);
+    T l;
+    l.load(ss);
+    l.push_back(sigma + 20);
+    control.push_back(sigma + 20);
+    rank.clear();
+    for (uint64_t i = 0; i < control.size(); i++) {
+        ASSERT_EQ(l.at(i), control[i]) << "Value at " << i;
+        ASSERT_EQ(l.rank(i, control[i]), rank[control[i]]) << "rank at " << i;
+        ASSERT_EQ(l.select(rank[control[i]], control[i]), i) << "select at " << i;
+        rank[control[i]]++;
+    }
+    // gamma codes: the alphabet stays open as well
+    T g;
+    for (uint64_t i = 0; i < 1000; i++)
+        for (uint64_t c = 0; c < 3; c++) g.push_back(c);
+    for (uint64_t i = 0; i < 10; i++) g.push_back(5);
+    g.reshape();
+    g.push_back(42);
+    ASSERT_EQ(g.at(g.size() - 1), 42u);
+    ASSERT_EQ(g.rank(g.size(), 42), 1u);
+    ASSERT_EQ(g.rank(g.size(), 5), 10u);
+    delete s;
+}
+
+template<class T>
+void substring_test(const uint64_t size, const uint64_t sigma, const uint64_t max_len) {
+    auto s = new T(sigma);
+    std::vector<uint64_t> control;
+    while (control.size() < size) {
+        std::vector<uint64_t> sub(rand() % (max_len + 1));
+        for (auto& c : sub) c = rand() % sigma;
+        uint64_t i = rand() % (control.size() + 1);
+        s->insert_range(i, sub.begin(), sub.end());
+        control.insert(control.begin() + i, sub.begin(), sub.end());
+        if (rand() % 3 == 0) {
+            uint64_t len = rand() % (max_len + 1);
+            len = std::min<uint64_t>(len, control.size());
+            uint64_t j = rand() % (control.size() - len + 1);
+            s->remove_range(j, len);
+            control.erase(control.begin() + j, control.begin() + j + len);
+        }
+    }
+    ASSERT_EQ(s->size(), control.size());
+    for (uint64_t k = 0; k < 100; k++) {
+        uint64_t len = rand() % (max_len + 1);
+        uint64_t i = rand() % (control.size() - len + 1);
+        std::vector<uint64_t> sub;
+        s->extract(i, len, std::back_inserter(sub));
+        ASSERT_TRUE(std::equal(sub.begin(), sub.end(), control.begin() + i)) << "extract at " << i;
+    }
+    std::vector<uint64_t> all;
+    s->extract(0, s->size(), std::back_inserter(all));
+    ASSERT_TRUE(all == control);
+    std::map<uint64_t, uint64_t> rank;
+    for (uint64_t i = 0; i < control.size(); i++) {
+        ASSERT_EQ(s->at(i), control[i]) << "Value at " << i;
+        ASSERT_EQ(s->rank(i, control[i]), rank[control[i]]) << "rank at " << i;
+        rank[control[i]]++;
+    }
+    delete s;
+}
+
+template <class T>
+void pv_remove_range_test(const uint64_t size) {
+    // random widths, so that some removals shrink the vector
+    T pv;
+    std::vector<uint64_t> control;
+    for (uint64_t i = 0; i < size; i++) {
+        uint64_t x = rand() % 1000;
+        if (i % 97 == 0) x = uint64_t(rand()) << 20;
+        pv.push_back(x);
+        control.push_back(x);
+    }
+    while (!control.empty()) {
+        uint64_t i = rand() % control.size();
+        uint64_t n = std::min<uint64_t>(rand() % 200, control.size() - i);
+        pv.remove_range(i, n);
+        control.erase(control.begin() + i, control.begin() + i + n);
+        ASSERT_EQ(pv.size(), control.size());
+        uint64_t psum = 0;
+        for (uint64_t j = 0; j < control.size(); j++) {
+            ASSERT_EQ(pv.at(j), control[j]) << "Value at " << j;
+            psum += control[j];
+        }
+        ASSERT_EQ(pv.psum(), psum);
+        if (n == 0) {
+            pv.remove(0);
+            control.erase(control.begin());
+        }
+    }
+}
+
+template <class T>
+void insert_words_test(const uint64_t size) {
+    // bulk insertions spanning several leaves, and range removals
+    T bv;
+    std::vector<bool> control;
+    while (control.size() < size) {
+        uint64_t i = rand() % (control.size() + 1);
+        uint64_t n = 1 + rand() % 20000;
+        std::vector<uint64_t> words(n / 64 + 1);
+        for (auto& w : words) w = (uint64_t(rand()) << 32) ^ rand();
+        bv.insert_words(i, words, n);
+        std::vector<bool> bits;
+        for (uint64_t j = 0; j < n; j++) bits.push_back((words[j / 64] >> (j % 64)) & 1);
+        control.insert(control.begin() + i, bits.begin(), bits.end());
+        if (rand() % 3 == 0) {
+            uint64_t l = rand() % control.size();
+            uint64_t len = std::min<uint64_t>(rand() % 5000, control.size() - l);
+            bv.remove_range(l, len);
+            control.erase(control.begin() + l, control.begin() + l + len);
+        }
+    }
+    ASSERT_EQ(bv.size(), control.size());
+    uint64_t r = 0;
+    for (uint64_t i = 0; i < control.size(); i++) {
+        ASSERT_EQ(bv.at(i), control[i]) << "Value at " << i;
+        ASSERT_EQ(bv.rank1(i), r) << "Rank at " << i;
+        r += control[i];
+    }
+    ASSERT_EQ(bv.rank1(), r);
+}
+
+template <class T>
+void spsi_insert_word_test(const uint64_t size) {
+    // packed words inserted into full leaves, with values of several widths
+    T s;
+    std::vector<uint64_t> control;
+    for (uint64_t i = 0; i < size; i++) {
+        uint64_t x = rand() % (i % 2 ? 1000 : 2);
+        s.push_back(x);
+        control.push_back(x);
+    }
+    for (uint64_t t = 0; t < 2000; t++) {
+        uint8_t width = 1 + rand() % 8;
+        uint8_t n = 1 + rand() % (64 / width);
+        uint64_t word = 0;
+        uint64_t i = rand() % (control.size() + 1);
+        std::vector<uint64_t> values;
+        for (uint8_t h = 0; h < n; h++) {
+            uint64_t x = rand() % (uint64_t(1) << width);
+            word |= x << (h * width);
+            values.push_back(x);
+        }
+        s.insert_word(i, word, width, n);
+        control.insert(control.begin() + i, values.begin(), values.end());
+    }
+    ASSERT_EQ(s.size(), control.size());
+    uint64_t psum = 0;
+    for (uint64_t i = 0; i < control.size(); i++) {
+        ASSERT_EQ(s.at(i), control[i]) << "Value at " << i;
+        psum += control[i];
+    }
+    ASSERT_EQ(s.psum(), psum);
+}
+
+template<class T>
+void multiary_string_test(const uint64_t size, const uint64_t sigma) {
+    // small characters first, so that the tree grows while not empty
+    auto s = new T();
+    std::vector<uint64_t> control;
+    for (uint64_t i = 0; i < size; i++) {
+        uint64_t c = rand() % (i < size / 2 ? std::min<uint64_t>(sigma, 4) : sigma);
+        uint64_t j = rand() % (control.size() + 1);
+        s->insert(j, c);
+        control.insert(control.begin() + j, c);
+        if (rand() % 4 == 0) {
+            j = rand() % control.size();
+            s->remove(j);
+            control.erase(control.begin() + j);
+        }
+    }
+    ASSERT_EQ(s->size(), control.size());
+    std::stringstream ss;
+    s->serialize(ss);
+    auto t = new T();
+    t->load(ss);
+    std::map<uint64_t, uint64_t> rank;
+    for (uint64_t i = 0; i < control.size(); i++) {
+        ASSERT_EQ(s->at(i), control[i]) << "Value at " << i;
+        ASSERT_EQ(t->at(i), control[i]) << "Loaded value at " << i;
+        ASSERT_EQ(s->rank(i, control[i]), rank[control[i]]) << "rank at " << i;
+        ASSERT_EQ(s->select(rank[control[i]], control[i]), i) << "select at " << i;
+        rank[control[i]]++;
+    }
+    ASSERT_EQ(s->rank(control.size(), sigma + 1000), 0u);
+    delete s;
+    delete t;
+}
+
+template<class T, class U>
+void bwt_equal_test(const uint64_t size, const uint64_t sigma) {
+    // the same text left-extended into two BWTs with different string types
+    T a;
+    U b;
+    for (uint64_t i = 0; i < size; i++) {
+        uint64_t c = 'a' + rand() % sigma;
+        a.extend(c);
+        b.extend(c);
+    }
+    ASSERT_EQ(a.bwt_length(), b.bwt_length());
+    for (uint64_t i = 0; i < a.bwt_length(); i++) {
+        ASSERT_EQ(a.at(i), b.at(i)) << "BWT at " << i;
+        ASSERT_EQ(a.LF(i), b.LF(i)) << "LF at " << i;
+    }
+}
+
+template<class T>
+void bwt_test(const uint64_t size, const uint64_t sigma) {
+    // left-extend with text[size-1], ..., text[0]
+    std::string text(size, 'a');
+    for (auto& c : text) c = 'a' + rand() % sigma;
+    T b;
+    for (uint64_t i = size; i > 0; i--) b.extend(uint64_t(text[i - 1]));
+    // naive BWT: sort the suffixes of text$, with $ smallest
+    std::vector<uint64_t> sa(size + 1);
+    for (uint64_t i = 0; i <= size; i++) sa[i] = i;
+    std::sort(sa.begin(), sa.end(), [&](uint64_t x, uint64_t y) {
+        return text.compare(x, std::string::npos, text, y, std::string::npos) < 0;
+    });
+    std::string bwt_string(size + 1, '#');
+    for (uint64_t i = 0; i <= size; i++) {
+        if (sa[i] > 0) bwt_string[i] = text[sa[i] - 1];
+    }
+    ASSERT_EQ(b.bwt_length(), size + 1);
+    ASSERT_EQ(b.text_alphabet_size(), std::set<char>(text.begin(), text.end()).size());
+    std::stringstream ss;
+    b.serialize(ss);
+    T c;
+    c.load(ss);
+    for (uint64_t i = 0; i <= size; i++) {
+        uint64_t expected = sa[i] > 0 ? uint64_t(bwt_string[i]) : b.get_terminator();
+        ASSERT_EQ(b.at(i), expected) << "BWT at " << i;
+        ASSERT_EQ(c.at(i), expected) << "loaded BWT at " << i;
+        ASSERT_EQ(b.FL(b.LF(i)), i) << "FL(LF) at " << i;
+    }
+    for (uint64_t k = 0; k < 100; k++) {
+        uint64_t len = 1 + rand() % 3;
+        uint64_t pos = rand() % (size - len + 1);
+        std::vector<uint64_t> P(text.begin() + pos, text.begin() + pos + len);
+        uint64_t occ = 0;
+        for (uint64_t i = 0; i + len <= size; i++) occ += text.compare(i, len, text, pos, len) == 0;
+        auto range = b.count(P);
+        ASSERT_EQ(range.second - range.first, occ) << "count of pattern at " << pos;
+    }
+    // bulk construction, where available
+    if constexpr (std::is_same<T, dyn::rle_bwt>::value) {
+        T d;
+        d.build_from_string(bwt_string, '#');
+        for (uint64_t i = 0; i <= size; i++) ASSERT_EQ(d.at(i), b.at(i)) << "built BWT at " << i;
+        ASSERT_EQ(d.LF(0), b.LF(0));
+    }
+}
+
+template<class T>
+void fm_extend_test(const uint64_t size, const uint64_t sigma, const uint64_t sample_rate) {
+    // the same text left-extended character by character and in batches
+    // of random length; T is an fm_index
+    std::vector<uint64_t> text(size);
+    for (auto& c : text) c = 'a' + rand() % sigma;
+    T a(256, sample_rate);
+    T b(256, sample_rate);
+    for (uint64_t i = size; i > 0; i--) a.extend(text[i - 1]);
+    uint64_t j = size;
+    while (j > 0) {
+        uint64_t len = std::min(j, uint64_t(1 + rand() % 2000));
+        b.extend(text.data() + j - len, len);
+        j -= len;
+    }
+    ASSERT_EQ(a.bwt_length(), b.bwt_length());
+    ASSERT_EQ(a.get_terminator_position(), b.get_terminator_position());
+    ASSERT_EQ(a.text_alphabet_size(), b.text_alphabet_size());
+    for (uint64_t i = 0; i < a.bwt_length(); i++) {
+        ASSERT_EQ(a.at(i), b.at(i)) << "BWT at " << i;
+        ASSERT_EQ(a.LF(i), b.LF(i)) << "LF at " << i;
+        ASSERT_EQ(a.locate(i), b.locate(i)) << "locate at " << i;
+    }
+    std::vector<uint64_t> P(text.begin() + size / 2, text.begin() + size / 2 + 4);
+    ASSERT_EQ(a.locate(P), b.locate(P));
+}
+
+template<class T, bool fm>
+void merge_test(const uint64_t size_v, const uint64_t size_w, const uint64_t sigma) {
+    // index of V sep W by merge, and by left-extension. sep = 'a' is smaller
+    // than the characters of V, and can occur in W
+    std::vector<uint64_t> v(size_v), w(size_w);
+    for (auto& c : v) c = 'b' + rand() % sigma;
+    for (auto& c : w) c = 'a' + rand() % sigma;
+    T a, b, expected;
+    for (uint64_t i = size_w; i > 0; i--) a.extend(w[i - 1]);
+    for (uint64_t i = size_v; i > 0; i--) b.extend(v[i - 1]);
+    for (uint64_t i = size_w; i > 0; i--) expected.extend(w[i - 1]);
+    expected.extend('a');
+    for (uint64_t i = size_v; i > 0; i--) expected.extend(v[i - 1]);
+    a.merge(b, 'a');
+    // the merged index can be extended further
+    for (uint64_t i = 0; i < 100; i++) {
+        uint64_t c = 'a' + rand() % (sigma + 1);
+        a.extend(c);
+        expected.extend(c);
+    }
+    ASSERT_EQ(a.bwt_length(), expected.bwt_length());
+    ASSERT_EQ(a.get_terminator_position(), expected.get_terminator_position());
+    ASSERT_EQ(a.text_alphabet_size(), expected.text_alphabet_size());
+    for (uint64_t i = 0; i < a.bwt_length(); i++) {
+        ASSERT_EQ(a.at(i), expected.at(i)) << "BWT at " << i;
+        ASSERT_EQ(a.LF(i), expected.LF(i)) << "LF at " << i;
+        if constexpr (fm) {
+            ASSERT_EQ(a.locate(i), expected.locate(i)) << "locate at " << i;
+        }
+    }
+}
+
+template<class T>
+void query_many_test(const uint64_t size, const uint64_t sigma, const uint64_t queries) {
+    // batched count/locate against one query at a time. Patterns are
+    // substrings of the text (some with a common suffix, some repeated) and
+    // random strings
+    std::vector<uint64_t> text(size);
+    for (auto& c : text) c = 'a' + rand() % sigma;
+    T f;
+    for (uint64_t i = size; i > 0; i--) f.extend(text[i - 1]);
+    std::vector<std::vector<uint64_t>> P;
+    for (uint64_t k = 0; k < queries; k++) {
+        uint64_t len = 4 + rand() % 8;
+        uint64_t pos = rand() % (size - len);
+        std::vector<uint64_t> p(text.begin() + pos, text.begin() + pos + len);
+        if (k % 4 == 1) p = P.back();
+        if (k % 4 == 2) p.push_back('a' + sigma);
+        P.push_back(p);
+    }
+    typename T::query_stats stats;
+    auto ranges = f.count_many(P, &stats);
+    ASSERT_EQ(ranges.size(), P.size());
+    for (uint64_t k = 0; k < queries; k++) ASSERT_EQ(ranges[k], f.count(P[k])) << "count of pattern " << k;
+    ASSERT_EQ(stats.queries, queries);
+    ASSERT_LE(stats.LF_steps, stats.pattern_length);
+    ASSERT_EQ(stats.latency.size(), queries);
+    ASSERT_LE(stats.percentile(50), stats.percentile(100));
+    auto occ = f.locate_many(P, &stats);
+    ASSERT_EQ(occ.size(), P.size());
+    for (uint64_t k = 0; k < queries; k++) ASSERT_EQ(occ[k], f.locate(P[k])) << "locate of pattern " << k;
+    ASSERT_LE(stats.percentile(100), stats.seconds);
+}
+
+template<class T>
+void extract_test(const uint64_t size_v, const uint64_t size_w, const uint64_t sigma, const uint64_t sample_rate) {
+    // extract and extract_all on the index of V sep W, built by merge (so
+    // that not all SA samples are multiples of the sample rate)
+    std::vector<uint64_t> v(size_v), w(size_w);
+    for (auto& c : v) c = 'b' + rand() % sigma;
+    for (auto& c : w) c = 'a' + rand() % sigma;
+    T a(256, sample_rate), b(256, sample_rate);
+    a.extend(w.data(), size_w);
+    b.extend(v.data(), size_v);
+    a.merge(b, 'a');
+    std::vector<uint64_t> text(v);
+    text.push_back('a');
+    text.insert(text.end(), w.begin(), w.end());
+    const uint64_t n = text.size();
+    ASSERT_EQ(a.text_length(), n);
+    // position i is text[n - i]
+    for (uint64_t i = 1; i <= n; i++) ASSERT_EQ(a.extract(i, 1)[0], text[n - i]) << "extract at " << i;
+    for (uint64_t k = 0; k < 200; k++) {
+        uint64_t i = 1 + rand() % n;
+        uint64_t len = rand() % (std::min(i, uint64_t(3 * sample_rate)) + 1);
+        std::vector<uint64_t> expected(text.begin() + (n - i), text.begin() + (n - i) + len);
+        ASSERT_EQ(a.extract(i, len), expected) << "extract of " << len << " at " << i;
+    }
+    ASSERT_EQ(a.extract(n, n), text);
+    std::vector<uint64_t> all;
+    a.extract_all([&](uint64_t c) { all.push_back(c); });
+    ASSERT_EQ(all, text);
+}
+
+template<class T, class T_sampled>
+void count_only_test(const uint64_t size, const uint64_t sigma) {
+    // an index without samples (T) against the same index with samples:
+    // same BWT and counts, less space; serialization round trip
+    std::vector<uint64_t> text(size);
+    for (auto& c : text) c = 'a' + rand() % sigma;
+    T a;
+    T_sampled b;
+    a.extend(text.data() + size / 2, size - size / 2);
+    for (uint64_t i = size / 2; i > 0; i--) a.extend(text[i - 1]);
+    b.extend(text.data(), size);
+    ASSERT_EQ(a.bwt_length(), b.bwt_length());
+    ASSERT_EQ(a.get_terminator_position(), b.get_terminator_position());
+    for (uint64_t i = 0; i < a.bwt_length(); i++) {
+        ASSERT_EQ(a.at(i), b.at(i)) << "BWT at " << i;
+        ASSERT_EQ(a.LF(i), b.LF(i)) << "LF at " << i;
+    }
+    for (uint64_t k = 0; k < 100; k++) {
+        uint64_t pos = rand() % (size - 8);
+        std::vector<uint64_t> P(text.begin() + pos, text.begin() + pos + 1 + rand() % 8);
+        ASSERT_EQ(a.count(P), b.count(P));
+    }
+    ASSERT_LT(a.bit_size(), b.bit_size());
+    std::stringstream ss;
+    a.serialize(ss);
+    T c;
+    c.load(ss);
+    ASSERT_EQ(c.bwt_length(), a.bwt_length());
+    for (uint64_t i = 0; i < a.bwt_length(); i++) ASSERT_EQ(c.LF(i), a.LF(i)) << "loaded LF at " << i;
+}
+
+template<class T, class T_fmi>
+void r_index_test(const uint64_t size, const uint64_t sigma) {
+    // r-index against fm_index on a repetitive text: locate of all rows, of
+    // patterns and of ranges. Half of the text is extended in batch
+    std::vector<uint64_t> block(size / 20 + 1);
+    for (auto& c : block) c = 'a' + rand() % sigma;
+    std::vector<uint64_t> text(size);
+    for (uint64_t i = 0; i < size; i++) text[i] = rand() % 50 == 0 ? 'a' + rand() % sigma : block[i % block.size()];
+    T a;
+    T_fmi b(256, 8);
+    a.extend(text.data() + size / 2, size - size / 2);
+    for (uint64_t i = size / 2; i > 0; i--) a.extend(text[i - 1]);
+    b.extend(text.data(), size);
+    ASSERT_EQ(a.bwt_length(), b.bwt_length());
+    for (uint64_t i = 0; i < a.bwt_length(); i++) {
+        ASSERT_EQ(a.at(i), b.at(i)) << "BWT at " << i;
+        ASSERT_EQ(a.locate(i), b.locate(i)) << "locate at " << i;
+    }
+    for (uint64_t k = 0; k < 200; k++) {
+        uint64_t pos = rand() % (size - 10);
+        std::vector<uint64_t> P(text.begin() + pos, text.begin() + pos + 2 + rand() % 8);
+        ASSERT_EQ(a.locate(P), b.locate(P)) << "locate of pattern at " << pos;
+        auto range = b.count(P);
+        ASSERT_EQ(a.locate(range), b.locate(range));
+    }
+    ASSERT_TRUE(a.locate(std::vector<uint64_t>{'a' + sigma}).empty());
+    ASSERT_EQ(a.locate(std::vector<uint64_t>()), b.locate(std::vector<uint64_t>()));
+    // the terminator can split a run
+    ASSERT_LE(a.number_of_samples(), 3 * (a.number_of_runs() + 2));
+    std::stringstream ss;
+    a.serialize(ss);
+    T c;
+    c.load(ss);
+    for (uint64_t i = 0; i < c.bwt_length(); i++) ASSERT_EQ(c.locate(i), b.locate(i)) << "loaded locate at " << i;
+}
+
+template<class T>
+void adaptive_sampling_test(const uint64_t size, const uint64_t sigma, const uint64_t sample_rate, const uint64_t budget) {
+    // locate_adaptive on skewed traffic against an index without extra
+    // samples; then extend, merge, lower the budget and reload
+    std::vector<uint64_t> text(size), other(size / 4);
+    for (auto& c : text) c = 'b' + rand() % sigma;
+    for (auto& c : other) c = 'b' + rand() % sigma;
+    T a(256, sample_rate), b(256, sample_rate);
+    a.extend(text.data() + size / 2, size - size / 2);
+    b.extend(text.data() + size / 2, size - size / 2);
+    a.set_adaptive_sampling(budget, 1);
+    std::vector<std::vector<uint64_t> > hot;
+    for (uint64_t k = 0; k < 10; k++) {
+        uint64_t pos = size / 2 + rand() % (size / 2 - 4);
+        hot.push_back(std::vector<uint64_t>(text.begin() + pos, text.begin() + pos + 4));
+    }
+    for (uint64_t k = 0; k < 1000; k++) {
+        uint64_t pos = size / 2 + rand() % (size / 2 - 6);
+        auto P = rand() % 10 ? hot[rand() % hot.size()] : std::vector<uint64_t>(text.begin() + pos, text.begin() + pos + 6);
+        ASSERT_EQ(a.locate_adaptive(P), b.locate(P));
+        ASSERT_LE(a.number_of_hot_samples(), budget);
+    }
+    ASSERT_GT(a.number_of_hot_samples(), 0u);
+    a.extend(text.data(), size / 2);
+    b.extend(text.data(), size / 2);
+    T c(256, sample_rate), d(256, sample_rate);
+    c.extend(other.data(), other.size());
+    d.extend(other.data(), other.size());
+    c.set_adaptive_sampling(budget, 1);
+    for (auto& P : hot) c.locate_adaptive(P);
+    a.merge(c, 'a');
+    b.merge(d, 'a');
+    ASSERT_LE(a.number_of_hot_samples(), budget);
+    for (uint64_t i = 0; i < a.bwt_length(); i++) ASSERT_EQ(a.locate(i), b.locate(i)) << "locate at " << i;
+    ASSERT_EQ(a.extract(a.text_length(), a.text_length()), b.extract(b.text_length(), b.text_length()));
+    a.set_adaptive_sampling(budget / 2);
+    ASSERT_LE(a.number_of_hot_samples(), budget / 2);
+    for (auto& P : hot) ASSERT_EQ(a.locate_adaptive(P), b.locate(P));
+    std::stringstream ss;
+    a.serialize(ss);
+    T e;
+    e.load(ss);
+    // only the regular samples are serialized
+    ASSERT_GT(a.number_of_hot_samples(), 0u);
+    ASSERT_EQ(a.number_of_samples(), b.number_of_samples() + a.number_of_hot_samples());
+    ASSERT_EQ(e.number_of_samples(), b.number_of_samples());
+    ASSERT_EQ(e.number_of_hot_samples(), 0u);
+    for (uint64_t i = 0; i < e.bwt_length(); i++) ASSERT_EQ(e.locate(i), b.locate(i)) << "loaded locate at " << i;
+    e.set_adaptive_sampling(budget / 2, 1);
+    for (auto& P : hot) ASSERT_EQ(e.locate_adaptive(P), b.locate(P));
+    ASSERT_LE(e.number_of_hot_samples(), budget / 2);
+    // save/load cycles do not accumulate samples
+    std::stringstream se;
+    e.serialize(se);
+    T f;
+    f.load(se);
+    ASSERT_EQ(f.number_of_samples(), b.number_of_samples());
+    for (uint64_t i = 0; i < f.bwt_length(); i++) ASSERT_EQ(f.locate(i), b.locate(i)) << "reloaded locate at " << i;
+}
+
+template<class T>
+void kmer_table_test(const uint64_t size, const uint64_t sigma, const uint64_t k) {
+    // count with the k-mer table against count without it: table built on the
+    // empty index and patched by extend, built on a full index, rebuilt by
+    // merge, dropped by a new character
+    std::vector<uint64_t> text(size), other(size / 3);
+    for (auto& c : text) c = 'b' + rand() % sigma;
+    for (auto& c : other) c = 'b' + rand() % sigma;
+    std::vector<uint64_t> alphabet;
+    for (uint64_t c = 0; c < sigma; c++) alphabet.push_back('b' + c);
+    T a, b, c, d;
+    a.build_kmer_table(k, alphabet);
+    a.extend(text.data() + size / 2, size - size / 2);
+    for (uint64_t i = size / 2; i > 0; i--) a.extend(text[i - 1]);
+    b.extend(text.data(), size);
+    c.extend(text.data(), size);
+    c.build_kmer_table(k);
+    ASSERT_EQ(a.kmer_table_length(), k);
+    auto check = [&](T& x, T& y, std::vector<uint64_t>& t) {
+        for (uint64_t q = 0; q < 500; q++) {
+            uint64_t len = 1 + rand() % (k + 5);
+            uint64_t pos = rand() % (t.size() - len);
+            std::vector<uint64_t> P(t.begin() + pos, t.begin() + pos + len);
+            if (q % 3 == 0) P[rand() % len] = 'a' + rand() % (sigma + 2);
+            ASSERT_EQ(x.count(P), y.count(P)) << "pattern of length " << len << " at " << pos;
+        }
+        // the end of the text (short suffixes)
+        for (uint64_t len = 1; len <= k + 1; len++) {
+            std::vector<uint64_t> P(t.end() - len, t.end());
+            ASSERT_EQ(x.count(P), y.count(P)) << "suffix of length " << len;
+        }
+    };
+    check(a, b, text);
+    check(c, b, text);
+    d.extend(other.data(), other.size());
+    a.merge(d, 'a');
+    b.merge(d, 'a');
+    ASSERT_EQ(a.kmer_table_length(), k);
+    std::vector<uint64_t> merged(other);
+    merged.push_back('a');
+    merged.insert(merged.end(), text.begin(), text.end());
+    check(a, b, merged);
+    a.extend('z');
+    b.extend('z');
+    ASSERT_EQ(a.kmer_table_length(), 0);
+    merged.insert(merged.begin(), 'z');
+    check(a, b, merged);
+}
+
+template<class T>
+void approximate_test(const uint64_t size, const uint64_t sigma, const uint64_t m, const uint64_t k, const bool edits) {
+    // LF_all against LF, then locate_approximate against a scan of the text
+    // (Hamming distance, or edit distance with a free end in the text)
+    std::vector<uint64_t> text(size);
+    for (auto& c : text) c = 'a' + rand() % sigma;
+    T a(256, 8);
+    a.extend(text.data(), size);
+    const uint64_t n = a.text_length();
+    auto alphabet = a.get_alphabet();
+    for (uint64_t q = 0; q < 200; q++) {
+        uint64_t l = rand() % (n + 2), r = rand() % (n + 2);
+        std::pair<uint64_t, uint64_t> rn = {std::min(l, r), std::max(l, r)};
+        std::vector<std::pair<uint64_t, std::pair<uint64_t, uint64_t> > > expected;
+        for (auto c : alphabet) {
+            if (c == a.get_terminator()) continue;
+            auto x = a.LF(rn, c);
+            if (x.first < x.second) expected.push_back({c, x});
+        }
+        ASSERT_EQ(a.LF_all(rn), expected) << "LF_all of [" << rn.first << "," << rn.second << ")";
+    }
+    for (uint64_t q = 0; q < 20; q++) {
+        uint64_t pos = rand() % (n - m);
+        std::vector<uint64_t> P(text.begin() + pos, text.begin() + pos + m);
+        for (uint64_t e = 0; e < k; e++) P[rand() % m] = 'a' + rand() % (sigma + 1);
+        std::vector<std::pair<uint64_t, uint64_t> > expected;
+        for (uint64_t s = 0; s < n; s++) {
+            uint64_t best = k + 1;
+            if (not edits) {
+                if (s + m > n) break;
+                best = 0;
+                for (uint64_t i = 0; i < m; i++) best += P[i] != text[s + i];
+            } else {
+                // dp[i] = edit distance of P[0,...,i-1] and text[s,...,s+t-1]
+                std::vector<uint64_t> dp(m + 1);
+                for (uint64_t i = 0; i <= m; i++) dp[i] = i;
+                for (uint64_t t = 1; t <= m + k and s + t <= n; t++) {
+                    uint64_t diag = dp[0];
+                    dp[0] = t;
+                    for (uint64_t i = 1; i <= m; i++) {
+                        uint64_t up = dp[i];
+                        dp[i] = std::min({up + 1, dp[i - 1] + 1, diag + (P[i - 1] != text[s + t - 1])});
+                        diag = up;
+                    }
+                    best = std::min(best, dp[m]);
+                }
+            }
+            if (best <= k) expected.push_back({n - s, best});
+        }
+        std::sort(expected.begin(), expected.end());
+        ASSERT_EQ(a.locate_approximate(P, k, edits), expected) << "pattern at " << pos;
+    }
+}
+
+template<class T>
+void rle_dense_test(const uint64_t size, const uint64_t sigma) {
+    // bounded alphabet (dense slots for characters < 256, hash map for the
+    // others) against a vector; then serialized between a dense and a sparse
+    // (unbounded alphabet) string, both ways
+    std::vector<uint64_t> alphabet(sigma);
+    for (uint64_t k = 0; k < sigma; k++) alphabet[k] = k % 2 ? 'a' + k : 256 + 1000 * k;
+    T a(sigma), b;
+    std::vector<uint64_t> control;
+    while (control.size() < size) {
+        uint64_t c = alphabet[rand() % sigma];
+        uint64_t len = 1 + rand() % 10;
+        uint64_t j = rand() % (control.size() + 1);
+        for (uint64_t t = 0; t < len; t++) {
+            a.insert(j, c);
+            b.insert(j, c);
+        }
+        control.insert(control.begin() + j, len, c);
+    }
+    auto check = [&](const T& x) {
+        ASSERT_EQ(x.size(), control.size());
+        std::map<uint64_t, uint64_t> rank;
+        for (uint64_t i = 0; i < control.size(); i++) {
+            ASSERT_EQ(x.at(i), control[i]) << "at " << i;
+            for (auto c : alphabet) ASSERT_EQ(x.rank(i, c), rank[c]) << "rank(" << i << ", " << c << ")";
+            ASSERT_EQ(x.select(rank[control[i]], control[i]), i) << "select at " << i;
+            rank[control[i]]++;
+        }
+    };
+    check(a);
+    check(b);
+    std::stringstream s1, s2;
+    b.serialize(s1);
+    a.serialize(s2);
+    T c(sigma), d;
+    c.load(s1);
+    d.load(s2);
+    check(c);
+    check(d);
+}
+
+template<class T>
+void encoder_dense_test(const uint64_t sigma) {
+    // fixed-size codes (dense tables for characters < 256) against a map;
+    // serialized into a sparse (default) and a dense encoder
+    std::vector<uint64_t> alphabet(sigma);
+    for (uint64_t k = 0; k < sigma; k++) alphabet[k] = k % 2 ? k : 256 + 7 * k;
+    T e(sigma);
+    std::map<uint64_t, typename T::code_t> codes;
+    for (uint64_t t = 0; t < 4 * sigma; t++) {
+        uint64_t c = alphabet[rand() % sigma];
+        auto code = e.encode(c);
+        if (codes.count(c)) {
+            ASSERT_EQ(code.bits, codes[c].bits);
+            ASSERT_EQ(code.len, codes[c].len);
+        }
+        codes[c] = code;
+    }
+    auto check = [&](const T& x) {
+        std::set<uint64_t> keys;
+        for (auto& p : codes) {
+            keys.insert(p.first);
+            ASSERT_TRUE(x.char_exists(p.first));
+            ASSERT_TRUE(x.code_exists(p.second));
+            ASSERT_EQ(x.decode(p.second), p.first);
+            ASSERT_EQ(x.encode_existing(p.first).bits, p.second.bits);
+        }
+        for (auto c : alphabet) ASSERT_EQ(x.char_exists(c), codes.count(c) > 0) << "char " << c;
+        ASSERT_FALSE(x.char_exists(255));
+        ASSERT_EQ(x.keys(), keys);
+    };
+    check(e);
+    std::stringstream s1, s2;
+    e.serialize(s1);
+    e.serialize(s2);
+    T sparse, dense(sigma);
+    sparse.load(s1);
+    dense.load(s2);
+    check(sparse);
+    check(dense);
+}
+
+template <class T>
+void encoder_long_codes_test() {
+    // code_t up to MAX_CODE_LEN bits
+    typename T::code_t code;
+    std::vector<bool> bits;
+    for (uint64_t j = 0; j < T::MAX_CODE_LEN; j++) {
+        bool b = rand() % 2;
+        code = code.append(b);
+        bits.push_back(b);
+    }
+    ASSERT_EQ(code.size(), T::MAX_CODE_LEN);
+    for (uint64_t j = 0; j < bits.size(); j++) ASSERT_EQ(code[j], bits[j]) << "bit " << j;
+    // fixed-size codes of MAX_CODE_LEN bits
+    T e(uint64_t(1) << T::MAX_CODE_LEN);
+    std::map<uint64_t, typename T::code_t> codes;
+    for (uint64_t t = 0; t < 1000; t++) {
+        uint64_t c = t % 2 ? rand() % 256 : ~uint64_t(0) - 1 - rand();
+        codes[c] = e.encode(c);
+        ASSERT_EQ(codes[c].len, T::MAX_CODE_LEN);
+    }
+    std::stringstream s;
+    e.serialize(s);
+    T f;
+    f.load(s);
+    for (auto& p : codes) {
+        ASSERT_EQ(e.decode(p.second), p.first);
+        ASSERT_EQ(f.decode(p.second), p.first);
+        ASSERT_EQ(f.encode_existing(p.first), p.second);
+    }
+    // longer codes are rejected
+    EXPECT_THROW(T((uint64_t(1) << T::MAX_CODE_LEN) + 1), std::length_error);
+}
+
+template <class T>
+void wt_random_test(const uint64_t ops, const uint64_t sigma) {
+    // random updates against a naive model. The alphabet grows during the
+    // test, so that new paths (and relayouts of the node pool) are triggered
+    // by single inserts and by insert_range
+    T s;
+    std::vector<uint64_t> control;
+    uint64_t seen = 1;
+    auto check = [&]() {
+        ASSERT_EQ(s.size(), control.size());
+        std::map<uint64_t, uint64_t> count;
+        for (uint64_t i = 0; i < control.size(); i++) {
+            uint64_t c = control[i];
+            ASSERT_EQ(s.at(i), c) << "Value at " << i;
+            ASSERT_EQ(s.rank(i, c), count[c]) << "Rank at " << i;
+            ASSERT_EQ(s.select(count[c], c), i) << "Select of " << c;
+            count[c]++;
+        }
+        for (auto& e : count) ASSERT_EQ(s.rank(s.size(), e.first), e.second);
+    };
+    for (uint64_t t = 0; t < ops; t++) {
+        if (seen < sigma && rand() % 20 == 0) seen++;
+        uint64_t op = rand() % 10;
+        uint64_t i = rand() % (control.size() + 1);
+        if (op < 5 || control.empty()) {
+            uint64_t c = rand() % seen;
+            s.insert(i, c);
+            control.insert(control.begin() + i, c);
+        } else if (op < 8) {
+            s.remove(i % control.size());
+            control.erase(control.begin() + i % control.size());
+        } else if (op < 9) {
+            std::vector<uint64_t> r(1 + rand() % 20);
+            for (auto& c : r) c = rand() % seen;
+            s.insert_range(i, r.begin(), r.end());
+            control.insert(control.begin() + i, r.begin(), r.end());
+        } else {
+            uint64_t len = std::min<uint64_t>(rand() % 10, control.size() - i);
+            s.remove_range(i, len);
+            control.erase(control.begin() + i, control.begin() + i + len);
+        }
+        if (t % (ops / 10) == 0) check();
+    }
+    check();
+}
+
+template <class T>
+void large_alphabet_test(const uint64_t sigma) {
+    // gamma codes, every character new at first: the node pool grows with
+    // the alphabet, and must not be re-laid out at each new character
+    T s;
+    std::vector<uint64_t> control;
+    for (uint64_t i = 0; i < 2 * sigma; i++) {
+        uint64_t c = 7 * (i < sigma ? i : rand() % sigma);
+        uint64_t j = rand() % (control.size() + 1);
+        s.insert(j, c);
+        control.insert(control.begin() + j, c);
+    }
+    ASSERT_EQ(s.alphabet_size(), sigma);
+    std::map<uint64_t, uint64_t> count;
+    for (uint64_t i = 0; i < control.size(); i++) {
+        uint64_t c = control[i];
+        ASSERT_EQ(s.at(i), c) << "Value at " << i;
+        ASSERT_EQ(s.rank(i, c), count[c]) << "Rank at " << i;
+        ASSERT_EQ(s.select(count[c], c), i) << "Select of " << c;
+        count[c]++;
+    }
+}
+
+template<class T>
+void fm_serialize_test(const uint64_t size, const uint64_t sigma) {
+    // round trip: the loaded index gives the same answers
+    T a(sigma, 16);
+    for (uint64_t i = 0; i < size; i++) a.extend('a' + rand() % sigma);
+    std::stringstream s;
+    uint64_t bytes = a.serialize(s);
+    ASSERT_EQ(bytes, s.str().size());
+    T b;
+    b.load(s);
+    ASSERT_EQ(b.bwt_length(), a.bwt_length());
+    ASSERT_EQ(uint64_t(s.tellg()), bytes);
+    for (uint64_t i = 0; i < a.bwt_length(); i++) ASSERT_EQ(b.locate(i), a.locate(i)) << "locate at " << i;
+}
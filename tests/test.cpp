@@ -371,4 +371,190 @@ TEST(BBV0, Select0_10000) { select0_test<b_suc_bv0>(10000); }
 
 TEST(BBV0, Select0_100000) { select0_test<b_suc_bv0>(100000); }
 
-TEST(BBV0, Select0_1000000) { select0_test<b_suc_bv0>(1000000); }
\ No newline at end of file
+TEST(BBV0, Select0_1000000) { select0_test<b_suc_bv0>(1000000); }
+
+TEST(GAP, AppendRuns10) { append_runs_test<gap_bv>(10); }
+
+TEST(GAP, AppendRuns1000) { append_runs_test<gap_bv>(1000); }
+
+TEST(GAP, AppendRuns100000) { append_runs_test<gap_bv>(100000); }
+
+TEST(SPSI, PushManyEmpty) { push_many_test<packed_spsi>(0, 100000); }
+
+TEST(SPSI, PushManyShortTail) { push_many_test<packed_spsi>(0, 2 * 256 + 10); }
+
+TEST(SPSI, PushManyFewIntoLarge) { push_many_test<packed_spsi>(200000, 700); }
+
+TEST(RLE, AppendRuns) { rle_append_runs_test<rle_str>(10000, 3); }
+
+TEST(RLE, AppendRunsAcrossChunks) { rle_append_runs_test<rle_str>((1 << 20) + 5000, 4); }
+
+TEST(SV, UpdateIntervalsSequential) { update_intervals_test<sparse_vec>(100000, 20000, 100); }
+
+TEST(SV, UpdateIntervalsBatch) { update_intervals_test<sparse_vec>(100000, 20000, 2000); }
+
+TEST(SV, Iterator) { sparse_iterator_test<sparse_vec>(100000, 5000); }
+
+TEST(GAP, OnesIterator) { ones_iterator_test<gap_bv>(100000); }
+
+TEST(BBV8, NextPrev100000) { next_prev_test<b_suc_bv>(100000); }
+
+TEST(BBV0, NextPrev100000) { next_prev_test<b_suc_bv0>(100000); }
+
+TEST(SUC, NextPrev1000) { next_prev_test<suc_bv>(1000); }
+
+TEST(SUC, NextPrev1000000) { next_prev_test<suc_bv>(1000000); }
+
+TEST(GAP, NextPrev1000) { next_prev_test<gap_bv>(1000); }
+
+TEST(GAP, NextPrev100000) { next_prev_test<gap_bv>(100000); }
+
+TEST(SUC, SetOps) { set_ops_test<suc_bv, suc_bv>(100000, 100000); }
+
+TEST(SUC, SetOpsDifferentLengths) { set_ops_test<suc_bv, b_suc_bv>(30000, 100000); }
+
+TEST(BBV8, SetOps) { set_ops_test<b_suc_bv, b_suc_bv0>(100000, 70000); }
+
+
+TEST(WT, RangeQueries) { range_queries_test<wt_str>(10000, 100); }
+
+TEST(WT, RangeQueriesLargeAlphabet) { range_queries_test<wt_str>(10000, 3000); }
+
+TEST(WM, RangeQueries) { range_queries_test<wm_str>(10000, 100); }
+
+TEST(WM, RangeQueriesLargeAlphabet) { range_queries_test<wm_str>(10000, 3000); }
+
+
+TEST(WM, BulkConstruct1000) { bulk_construct_test<wm_str>(1000, 5); }
+
+TEST(WM, BulkConstruct300000) { bulk_construct_test<wm_str>(300000, 256); }
+
+
+TEST(WM, AlphabetGrowth) { alphabet_growth_test<wm_str>(20000); }
+
+
+TEST(WM, BatchQueriesSparse) { batch_queries_test<wm_str>(100000, 100, 1000); }
+
+TEST(WM, BatchQueriesDense) { batch_queries_test<wm_str>(20000, 1000, 50000); }
+
+
+TEST(WT, HuffmanSingleChar) { huffman_string_test<wt_str>(100, 1); }
+
+TEST(WT, HuffmanLengthLimited) { huffman_string_test<wt_str>(20000, 60); }
+
+
+TEST(WT, Reshape) { reshape_test<wt_str>(20000, 16); }
+
+TEST(WT, RandomUpdates) { wt_random_test<wt_str>(20000, 300); }
+
+TEST(WT, LargeAlphabet) { large_alphabet_test<wt_str>(50000); }
+
+
+TEST(WT, SubstringSmall) { substring_test<wt_str>(5000, 4, 10); }
+
+TEST(WT, SubstringLarge) { substring_test<wt_str>(200000, 200, 5000); }
+
+TEST(WM, SubstringSmall) { substring_test<wm_str>(5000, 4, 10); }
+
+TEST(WM, SubstringLarge) { substring_test<wm_str>(200000, 200, 5000); }
+
+TEST(PV, RemoveRange) { pv_remove_range_test<packed_vector>(3000); }
+
+TEST(SUC, InsertWords) { insert_words_test<suc_bv>(200000); }
+
+TEST(SPSI, InsertWord) { spsi_insert_word_test<packed_spsi>(20000); }
+
+
+TEST(WT16, Random) { multiary_string_test<wt16_str>(20000, 256); }
+
+TEST(WT16, LargeAlphabet) { multiary_string_test<wt16_str>(20000, 100000); }
+
+TEST(WT4, Random) { multiary_string_test<wt4_str>(20000, 256); }
+
+TEST(WT16, BWT) { bwt_equal_test<wt16_bwt, wt_bwt>(20000, 20); }
+
+
+TEST(RLE, Dense) { rle_dense_test<rle_str>(3000, 6); }
+
+TEST(RLE, DenseLargeAlphabet) { rle_dense_test<rle_str>(2000, 40); }
+
+TEST(AlphabetEncoder, Dense) { encoder_dense_test<alphabet_encoder>(20); }
+
+TEST(AlphabetEncoder, DenseSmall) { encoder_dense_test<alphabet_encoder>(3); }
+
+TEST(AlphabetEncoder, LongCodes) { encoder_long_codes_test<alphabet_encoder>(); }
+
+
+TEST(BWT, WT) { bwt_test<wt_bwt>(3000, 4); }
+
+TEST(BWT, RLE) { bwt_test<rle_bwt>(3000, 3); }
+
+TEST(BWT, WT16) { bwt_test<wt16_bwt>(3000, 20); }
+
+
+TEST(FMI, ExtendBatchWT) { fm_extend_test<wt_fmi>(20000, 4, 4); }
+
+TEST(FMI, ExtendBatchRLE) { fm_extend_test<rle_fmi>(20000, 3, 4); }
+
+TEST(FMI, ExtendBatchWT16) { fm_extend_test<wt16_fmi>(20000, 20, 16); }
+
+
+TEST(BWT, Merge) { merge_test<wt_bwt, false>(5000, 7000, 4); }
+
+TEST(BWT, MergeEmpty) { merge_test<rle_bwt, false>(0, 3000, 3); }
+
+TEST(FMI, MergeWT) { merge_test<wt_fmi, true>(3000, 4000, 4); }
+
+TEST(FMI, MergeRLE) { merge_test<rle_fmi, true>(3000, 2000, 3); }
+
+TEST(FMI, MergeWT16) { merge_test<wt16_fmi, true>(5000, 7000, 20); }
+
+
+TEST(FMI, QueryManyWT) { query_many_test<wt_fmi>(5000, 4, 1000); }
+
+TEST(FMI, QueryManyRLE) { query_many_test<rle_fmi>(3000, 3, 500); }
+
+
+TEST(FMI, ExtractWT) { extract_test<wt_extract_fmi>(3000, 5000, 4, 32); }
+
+TEST(FMI, ExtractRLE) { extract_test<rle_extract_fmi>(2000, 3000, 3, 64); }
+
+TEST(FMI, ExtractWT16) { extract_test<wt16_extract_fmi>(4000, 2000, 20, 16); }
+
+
+TEST(FMI, SerializeRLE) { fm_serialize_test<rle_fmi>(5000, 3); }
+
+TEST(FMI, SerializeExtractWT) { fm_serialize_test<wt_extract_fmi>(5000, 4); }
+
+TEST(FMI, CountOnly) { count_only_test<rle_count_fmi, rle_fmi>(20000, 3); }
+
+TEST(FMI, CountOnlyMerge) { merge_test<rle_count_fmi, false>(3000, 2000, 3); }
+
+TEST(FMI, AdaptiveSamplingWT) { adaptive_sampling_test<wt_extract_fmi>(6000, 4, 64, 200); }
+
+TEST(FMI, AdaptiveSamplingRLE) { adaptive_sampling_test<rle_extract_fmi>(4000, 3, 32, 100); }
+
+
+TEST(KmerTable, CountWT) { kmer_table_test<wt_bwt>(20000, 4, 8); }
+
+TEST(KmerTable, CountRLE) { kmer_table_test<rle_bwt>(10000, 2, 12); }
+
+TEST(KmerTable, CountFMI) { kmer_table_test<wt_fmi>(5000, 4, 3); }
+
+TEST(KmerTable, CountK1) { kmer_table_test<wt_bwt>(3000, 4, 1); }
+
+
+TEST(Approximate, HammingWT) { approximate_test<wt_fmi>(3000, 4, 12, 2, false); }
+
+TEST(Approximate, HammingRLE) { approximate_test<rle_fmi>(3000, 3, 10, 2, false); }
+
+TEST(Approximate, EditsWT) { approximate_test<wt_fmi>(2000, 4, 10, 2, true); }
+
+TEST(Approximate, EditsRLE) { approximate_test<rle_fmi>(2000, 2, 8, 2, true); }
+
+TEST(Approximate, HammingWT16) { approximate_test<wt16_fmi>(2000, 20, 6, 1, false); }
+
+
+TEST(RIndex, Locate) { r_index_test<rle_rindex, rle_fmi>(20000, 4); }
+
+TEST(RIndex, LocateSmallAlphabet) { r_index_test<rle_rindex, rle_fmi>(5000, 2); }
@@ -4,6 +4,25 @@
 
 using namespace std;
 
+double speed_construct(uint64_t num, uint64_t num_of_alphabet) {
+    vector<uint64_t> data(num);
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint64_t> alpha_distrib(0, num_of_alphabet-1);
+    for (int i = 0; i < num; ++i) {
+        data[i] = alpha_distrib(gen);
+    }
+
+    auto start = std::chrono::system_clock::now();
+    dyn::wm_str wm(num_of_alphabet, data);
+    auto end = std::chrono::system_clock::now();
+    if (wm.size() != num) {
+        cout << "dummy" << endl;
+    }
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
 double speed_access(uint64_t num, uint64_t num_of_alphabet) {
     vector<uint64_t> data(num);
     std::random_device rd;
@@ -404,6 +423,7 @@ bool test_serialize(uint64_t num, uint64_t num_of_alphabet) {
 }
 
 void speed_test(uint64_t num, uint64_t num_of_alphabet) {
+    cout << "construct:" << speed_construct(num, num_of_alphabet) << "ms" << endl;
     cout << "access:" << speed_access(num, num_of_alphabet) << "ms" << endl;
     cout << "rank:" << speed_rank(num, num_of_alphabet) << "ms" << endl;
     cout << "select:" << speed_select(num, num_of_alphabet) << "ms" << endl;
@@ -0,0 +1,143 @@
+#include <bits/stdc++.h>
+#include <random>
+#include "dynamic/dynamic.hpp"
+
+using namespace std;
+
+/*
+ * latency of wt_string (fixed-length codes) queries at random positions,
+ * same setting as wm_string.cpp for the wavelet matrix
+ */
+
+vector<uint64_t> random_data(uint64_t num, uint64_t num_of_alphabet, std::mt19937& gen) {
+    vector<uint64_t> data(num);
+    std::uniform_int_distribution<uint64_t> alpha_distrib(0, num_of_alphabet-1);
+    for (uint64_t i = 0; i < num; ++i) {
+        data[i] = alpha_distrib(gen);
+    }
+    return data;
+}
+
+double speed_access(uint64_t num, uint64_t num_of_alphabet) {
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    vector<uint64_t> data = random_data(num, num_of_alphabet, gen);
+
+    dyn::wt_str wt(num_of_alphabet, data);
+
+    std::uniform_int_distribution<uint64_t> pos_distrib(0, num-1);
+    uint64_t dummy = 0;
+    auto start = std::chrono::system_clock::now();
+    for (uint64_t i = 0; i < num; ++i) {
+        dummy += wt.at(pos_distrib(gen));
+    }
+    auto end = std::chrono::system_clock::now();
+    if (dummy == uint64_t(-1)) {
+        cout << "dummy" << endl;
+    }
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+double speed_rank(uint64_t num, uint64_t num_of_alphabet) {
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    vector<uint64_t> data = random_data(num, num_of_alphabet, gen);
+
+    dyn::wt_str wt(num_of_alphabet, data);
+
+    std::uniform_int_distribution<uint64_t> pos_distrib(0, num-1);
+    uint64_t dummy = 0;
+    auto start = std::chrono::system_clock::now();
+    for (uint64_t i = 0; i < num; ++i) {
+        dummy += wt.rank(pos_distrib(gen), data[pos_distrib(gen)]);
+    }
+    auto end = std::chrono::system_clock::now();
+    if (dummy == uint64_t(-1)) {
+        cout << "dummy" << endl;
+    }
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+double speed_select(uint64_t num, uint64_t num_of_alphabet) {
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    vector<uint64_t> data = random_data(num, num_of_alphabet, gen);
+    vector<uint64_t> count(num_of_alphabet, 0);
+    for (auto c : data) count[c]++;
+
+    dyn::wt_str wt(num_of_alphabet, data);
+
+    std::uniform_int_distribution<uint64_t> pos_distrib(0, num-1);
+    uint64_t dummy = 0;
+    auto start = std::chrono::system_clock::now();
+    for (uint64_t i = 0; i < num; ++i) {
+        uint64_t val = data[pos_distrib(gen)];
+        dummy += wt.select(gen() % count[val], val);
+    }
+    auto end = std::chrono::system_clock::now();
+    if (dummy == uint64_t(-1)) {
+        cout << "dummy" << endl;
+    }
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+double speed_insert(uint64_t num, uint64_t num_of_alphabet) {
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint64_t> alpha_distrib(0, num_of_alphabet-1);
+
+    dyn::wt_str wt(num_of_alphabet);
+
+    auto start = std::chrono::system_clock::now();
+    for (uint64_t i = 0; i < num; ++i) {
+        wt.insert(gen() % (wt.size() + 1), alpha_distrib(gen));
+    }
+    auto end = std::chrono::system_clock::now();
+    if (wt.at(0) == uint64_t(-1)) {
+        cout << "dummy" << endl;
+    }
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+// gamma codes, num distinct characters: every push_back creates a new path
+double speed_growth(uint64_t num) {
+    dyn::wt_str wt;
+
+    auto start = std::chrono::system_clock::now();
+    for (uint64_t i = 0; i < num; ++i) {
+        wt.push_back(i);
+    }
+    auto end = std::chrono::system_clock::now();
+    if (wt.at(0) == uint64_t(-1)) {
+        cout << "dummy" << endl;
+    }
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+void speed_test(uint64_t num, uint64_t num_of_alphabet) {
+    cout << "access:" << speed_access(num, num_of_alphabet) << "ms" << endl;
+    cout << "rank:" << speed_rank(num, num_of_alphabet) << "ms" << endl;
+    cout << "select:" << speed_select(num, num_of_alphabet) << "ms" << endl;
+    cout << "insert:" << speed_insert(num, num_of_alphabet) << "ms" << endl;
+}
+
+int main() {
+
+    uint64_t num = 1000000;
+
+    for (uint64_t num_of_alphabet : {4, 16, 256}) {
+        cout << "SPEED n=" << num << " alpha=" << num_of_alphabet << endl;
+        speed_test(num, num_of_alphabet);
+    }
+
+    for (uint64_t sigma : {5000, 20000, 40000, 200000}) {
+        cout << "GROWTH sigma=" << sigma << ":" << speed_growth(sigma) << "ms" << endl;
+    }
+
+    return 0;
+}